@@ -32,6 +32,10 @@
 
 #include <boost/optional.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
 namespace components
 {
     core::IntRect tile_group_bounding_box(const TileGroupDefinition& tile_group, const TileLibrary& tile_lib)
@@ -46,7 +50,7 @@ namespace components
                 core::Rect<double> sub_rect(0.0, 0.0, 
                     static_cast<double>(pat_rect.width), static_cast<double>(pat_rect.height));
 
-                core::Rect<double> transformed_rect = core::transform_rect(sub_rect, sub_tile.rotation);
+                core::Rect<double> transformed_rect = core::transform_rect(sub_rect, core::Rotation<double>(sub_tile.rotation));
 
                 core::IntRect int_rect(
                     static_cast<std::int32_t>(sub_tile.position.x - transformed_rect.width * 0.5),
@@ -64,4 +68,89 @@ namespace components
 
         return {};
     }
-}
\ No newline at end of file
+
+    FillLayout make_fill_layout(const TileGroupDefinition& tile_group, const TileLibrary& tile_library,
+        const FillProperties& properties)
+    {
+        auto box = tile_group_bounding_box(tile_group, tile_library);
+
+        FillLayout layout;
+        layout.area = properties.area;
+        layout.tile_size = { static_cast<double>(box.width), static_cast<double>(box.height) };
+        layout.max_offset = layout.tile_size * std::abs(properties.position_jitter);
+
+        double density_multiplier = 1.0 / std::max(properties.density, 0.1);
+        layout.increment.x = std::max(box.width * density_multiplier - 1.0, 1.0);
+        layout.increment.y = std::max(box.height * density_multiplier - 1.0, 1.0);
+
+        const auto& area = properties.area;
+        layout.grid_area = core::DoubleRect(area.left, area.top, area.width, area.height);
+        if (!properties.randomize_rotation)
+        {
+            auto rotation = core::Rotation<double>::degrees(properties.rotation);
+            layout.sin = std::sin(rotation.radians());
+            layout.cos = std::cos(rotation.radians());
+
+            layout.grid_area = core::transform_rect(layout.grid_area, -layout.sin, layout.cos);
+        }
+
+        const auto& grid_area = layout.grid_area;
+        layout.center = { grid_area.left + grid_area.width * 0.5, grid_area.top + grid_area.height * 0.5 };
+
+        if (grid_area.width > 0.0 && grid_area.height > 0.0)
+        {
+            layout.row_count = static_cast<std::size_t>(std::ceil(grid_area.height / layout.increment.y));
+            layout.column_count = static_cast<std::size_t>(std::ceil(grid_area.width / layout.increment.x));
+        }
+
+        return layout;
+    }
+
+    std::pair<std::size_t, std::size_t> fill_row_columns(const FillLayout& layout, std::size_t row)
+    {
+        const auto& center = layout.center;
+        const auto& area = layout.area;
+
+        // Relative to the center, a tile's position is base + u * direction for column offset u.
+        // Find the range of u for which it can land inside the area, give or take the jitter.
+        double v = layout.grid_area.top + row * layout.increment.y - center.y;
+
+        double u_min = -std::numeric_limits<double>::infinity();
+        double u_max = std::numeric_limits<double>::infinity();
+
+        auto constrain = [&](double base, double direction, double min, double max)
+        {
+            if (std::abs(direction) < 1e-9)
+            {
+                if (base < min || base > max) u_min = u_max + 1.0;
+                return;
+            }
+
+            double a = (min - base) / direction;
+            double b = (max - base) / direction;
+            if (a > b) std::swap(a, b);
+
+            u_min = std::max(u_min, a);
+            u_max = std::min(u_max, b);
+        };
+
+        // One extra pixel to account for rounding.
+        auto margin = layout.max_offset + core::Vector2<double>(1.0, 1.0);
+
+        constrain(center.x - v * layout.sin, layout.cos, area.left - margin.x, area.right() + margin.x);
+        constrain(center.y + v * layout.cos, layout.sin, area.top - margin.y, area.bottom() + margin.y);
+
+        if (u_min > u_max) return {};
+
+        double first = std::ceil((u_min + center.x - layout.grid_area.left) / layout.increment.x);
+        double last = std::floor((u_max + center.x - layout.grid_area.left) / layout.increment.x);
+
+        auto column_count = static_cast<double>(layout.column_count);
+        first = std::max(first, 0.0);
+        last = std::min(last + 1.0, column_count);
+
+        if (first >= last) return {};
+
+        return { static_cast<std::size_t>(first), static_cast<std::size_t>(last) };
+    }
+}
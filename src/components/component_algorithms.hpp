@@ -27,6 +27,7 @@
 #define COMPONENT_ALGORITHMS_HPP
 
 #include <cstdint>
+#include <utility>
 
 #include "core/rect.hpp"
 #include "core/rotation.hpp"
@@ -49,6 +50,34 @@ namespace components
         double density = 1.0;
     };
 
+    // The grid of candidate positions of a fill. Rows are independent of each other, so large fills
+    // can be generated in bands.
+    struct FillLayout
+    {
+        core::IntRect area;
+        core::DoubleRect grid_area;
+        core::Vector2<double> center;
+        core::Vector2<double> increment;
+        core::Vector2<double> tile_size;
+        core::Vector2<double> max_offset;
+
+        double sin = 0.0;
+        double cos = 1.0;
+
+        std::size_t row_count = 0;
+        std::size_t column_count = 0;
+    };
+
+    FillLayout make_fill_layout(const TileGroupDefinition& tile_group, const TileLibrary& tile_library,
+        const FillProperties& properties);
+
+    // Returns the range of columns in the given row whose tiles may end up inside the fill area.
+    std::pair<std::size_t, std::size_t> fill_row_columns(const FillLayout& layout, std::size_t row);
+
+    template <typename RNG, typename OutIt>
+    void fill_rows(const FillLayout& layout, const TileGroupDefinition& tile_group, const FillProperties& properties,
+        std::size_t row_begin, std::size_t row_end, RNG&& rng, OutIt out);
+
     template <typename RNG, typename OutIt>
     void fill_area(const TileGroupDefinition& tile_group, const TileLibrary& tile_library, 
         const FillProperties& properties, RNG&& rng, OutIt out);
@@ -36,46 +36,29 @@
 #include <iostream>
 
 template <typename RNG, typename OutIt>
-void components::fill_area(const TileGroupDefinition& tile_group, const TileLibrary& tile_library,
-    const FillProperties& properties, RNG&& rng, OutIt out)
+void components::fill_rows(const FillLayout& layout, const TileGroupDefinition& tile_group, 
+    const FillProperties& properties, std::size_t row_begin, std::size_t row_end, RNG&& rng, OutIt out)
 {
-    auto box = tile_group_bounding_box(tile_group, tile_library);
-
     std::uniform_real_distribution<double> offset_dist(-properties.position_jitter, properties.position_jitter);
     std::uniform_int_distribution<std::int32_t> rotation_dist(0, 359);
 
-    double density_multiplier = 1.0 / std::max(properties.density, 0.1);
-    const auto& area = properties.area;
-
-    double y_increment = std::max(box.height * density_multiplier - 1.0, 1.0);
-    double x_increment = std::max(box.width * density_multiplier - 1.0, 1.0);
+    const auto& grid_area = layout.grid_area;
+    const auto& center = layout.center;
 
-    double sin = 0.0;
-    double cos = 1.0;
-
-    core::DoubleRect transformed_area(area.left, area.top, area.width, area.height);  
-    if (!properties.randomize_rotation)
+    for (std::size_t row = row_begin; row < row_end; ++row)
     {
-        auto rotation = core::Rotation<double>::degrees(properties.rotation);
-        sin = std::sin(rotation.radians());
-        cos = std::cos(rotation.radians());
-
-        transformed_area = core::transform_rect(transformed_area, -sin, cos);
-    }
-
-    core::Vector2<double> center(transformed_area.left + transformed_area.width * 0.5,
-        transformed_area.top + transformed_area.height * 0.5);
+        double y = grid_area.top + row * layout.increment.y;
 
-    for (double y = transformed_area.top; y < transformed_area.right(); y += y_increment)
-    {
-        for (double x = transformed_area.left; x < transformed_area.right(); x += x_increment)
+        auto columns = fill_row_columns(layout, row);
+        for (std::size_t column = columns.first; column < columns.second; ++column)
         {
-            auto position = core::transform_point<double>({ x - center.x, y - center.y }, sin, cos);
+            double x = grid_area.left + column * layout.increment.x;
+            auto position = core::transform_point<double>({ x - center.x, y - center.y }, layout.sin, layout.cos);
 
             Tile tile;
             tile.id = tile_group.id();
 
-            core::Vector2<double> offset(offset_dist(rng) * box.width, offset_dist(rng) * box.height);
+            core::Vector2<double> offset(offset_dist(rng) * layout.tile_size.x, offset_dist(rng) * layout.tile_size.y);
             tile.position = core::vector2_round<std::int32_t>(position + center + offset);
 
             tile.rotation = core::Rotation<double>::degrees(static_cast<double>(properties.rotation));
@@ -84,14 +67,22 @@ void components::fill_area(const TileGroupDefinition& tile_group, const TileLibr
                 tile.rotation = core::Rotation<double>::degrees(static_cast<double>(rotation_dist(rng)));
             }
 
-            if (contains(area, tile.position))
+            if (contains(layout.area, tile.position))
             {
                 *out = tile; ++out;
             }
-        }       
+        }
     }
 }
 
+template <typename RNG, typename OutIt>
+void components::fill_area(const TileGroupDefinition& tile_group, const TileLibrary& tile_library,
+    const FillProperties& properties, RNG&& rng, OutIt out)
+{
+    auto layout = make_fill_layout(tile_group, tile_library, properties);
+    fill_rows(layout, tile_group, properties, 0, layout.row_count, rng, out);
+}
+
 template <typename OutIt>
 void components::generate_default_start_points(const ControlPoint& finish_line, std::int32_t direction,
                                                std::size_t num_points, OutIt out)
@@ -35,6 +35,11 @@ extern "C"
 
 #include <fstream>
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <cstdlib>
 
 namespace components
 {
@@ -130,6 +135,8 @@ namespace components
         void read_using_reader_struct(png_structp png_ptr, png_bytep outBytes, png_size_t byteCountToRead);
         void write_using_writer_struct(png_structp png_ptr, png_bytep out_bytes, png_size_t byte_count);
         void flush_output(png_structp png_ptr);
+
+        void write_parallel_image(png_structp png_ptr, const Pattern& pattern, const PatternSaveOptions& options);
     }
 
     PatternLoadError::PatternLoadError(std::string file_path)
@@ -197,83 +204,144 @@ namespace components
     }
 
     void Pattern::load_from_file(const std::string& file_name, core::IntRect rect)
+    {
+        *this = std::move(load_pattern_areas(file_name, { rect }).front());
+    }
+
+    std::vector<Pattern> load_pattern_areas(const std::string& file_name, std::vector<core::IntRect> areas,
+        TerrainPalette* palette)
     {
         std::basic_ifstream<unsigned char> stream(file_name, std::ifstream::in | std::ifstream::binary);
-        if (stream)
+        if (!stream) throw PatternLoadError(file_name);
+
+        auto file_contents = core::read_stream_contents(stream);
+        if (file_contents.size() < 8 || !png_check_sig(file_contents.data(), 8)) throw PatternLoadError(file_name);
+
+        png::ReadInfo png_info;
+        auto& read_ptr = png_info.png_ptr();
+        auto& info_ptr = png_info.info_ptr();
+
+        std::vector<Pattern> result;
+
+        // Nothing with a non-trivial destructor may be created between setjmp and the last libpng call.
+        std::vector<png_byte> row_buffer;
+        std::vector<png_byte> interlace_buffer;
+
+        if (!png_info || setjmp(png_jmpbuf(read_ptr)) != 0) throw PatternLoadError(file_name);
+
+        png::ReaderStruct reader;
+        reader.data_ = file_contents.data() + 8;
+        reader.end_ = file_contents.data() + file_contents.size();
+
+        png_set_read_fn(read_ptr, static_cast<void*>(&reader), png::read_using_reader_struct);
+        png_set_sig_bytes(read_ptr, 8);
+        png_read_info(read_ptr, info_ptr);
+
+        // Must be paletted image
+        if (png_get_color_type(read_ptr, info_ptr) != PNG_COLOR_TYPE_PALETTE) throw PatternLoadError(file_name);
+
+        if (palette)
         {
-            auto file_contents = core::read_stream_contents(stream);
-            if (file_contents.size() && png_check_sig(file_contents.data(), 8))
+            png_colorp colors = nullptr;
+            int color_count = 0;
+            png_get_PLTE(read_ptr, info_ptr, &colors, &color_count);
+
+            *palette = {};
+            for (int index = 0; index < color_count && index < 256; ++index)
             {
-                png::ReadInfo png_info;
-                auto& read_ptr = png_info.png_ptr();
-                auto& info_ptr = png_info.info_ptr();
+                auto& color = (*palette)[index];
+                color.red = colors[index].red;
+                color.green = colors[index].green;
+                color.blue = colors[index].blue;
+            }
+        }
 
-                if (png_info && setjmp(png_jmpbuf(read_ptr)) == 0)
-                {
-                    png::ReaderStruct reader;
-                    reader.data_ = file_contents.data() + 8;
-                    reader.end_ = file_contents.data() + file_contents.size();
+        std::int32_t image_width = png_get_image_width(read_ptr, info_ptr);
+        std::int32_t image_height = png_get_image_height(read_ptr, info_ptr);
 
-                    png_set_read_fn(read_ptr, static_cast<void*>(&reader), png::read_using_reader_struct);
-                    png_set_sig_bytes(read_ptr, 8);
-                    png_read_info(read_ptr, info_ptr);
+        std::int32_t first_row = image_height, last_row = 0;
+        for (auto& area : areas)
+        {
+            if (area.width == 0)
+            {
+                area.left = 0;
+                area.width = image_width;
+            }
 
-                    // Must be paletted image
-                    if (png_get_color_type(read_ptr, info_ptr) == PNG_COLOR_TYPE_PALETTE)
-                    {
-                        std::size_t image_width = png_get_image_width(read_ptr, info_ptr);
-                        std::size_t image_height = png_get_image_height(read_ptr, info_ptr);
-
-                        std::vector<png_byte> byte_array(image_width * image_height);
-                        std::vector<png_bytep> row_pointers(image_height);
-
-                        for (std::size_t row = 0; row != image_height; ++row)
-                        {
-                            row_pointers[row] = &byte_array[row * image_width];
-                        }
-
-                        if (rect.width == 0)
-                        {
-                            rect.left = 0;
-                            rect.width = image_width;
-                        }
-
-                        if (rect.height == 0)
-                        {
-                            rect.top = 0;
-                            rect.height = image_height;
-                        }
-
-                        png_read_image(read_ptr, row_pointers.data());
-                        png_read_end(read_ptr, info_ptr);
-
-                        if (image_width >= static_cast<std::size_t>(rect.right()) && image_height >= static_cast<std::size_t>(rect.bottom()))
-                        {
-                            // Resize
-                            resize(rect.width, rect.height);
-
-                            // And copy the bytes over
-                            auto* data_ptr = &bytes_[0];
-                            for (std::uint32_t y = rect.top, bottom = rect.bottom(); y != bottom; ++y)
-                            {
-                                auto source_ptr = &byte_array[y * image_width + rect.left];
-
-                                for (auto row_end = data_ptr + rect.width; data_ptr != row_end; ++data_ptr, ++source_ptr)
-                                {
-                                    *data_ptr = *source_ptr;
-                                }
-                            }
-
-                            // Only if we reach this point, we can avoid throwing an exception.
-                            // Pretty god-awful, so many levels of indentation.
-                            return;
-                        }
-                    }
+            if (area.height == 0)
+            {
+                area.top = 0;
+                area.height = image_height;
+            }
+
+            if (area.left < 0 || area.top < 0 || area.width < 0 || area.height < 0 ||
+                area.right() > image_width || area.bottom() > image_height)
+            {
+                throw PatternLoadError(file_name);
+            }
+
+            result.emplace_back(core::Vector2u(area.width, area.height));
+
+            if (area.height != 0)
+            {
+                first_row = std::min(first_row, area.top);
+                last_row = std::max(last_row, area.bottom());
+            }
+        }
+
+        // Interlaced images need every row kept around until the last pass, but only the rows
+        // that anything is copied from. The others can share a scratch row.
+        auto pass_count = png_set_interlace_handling(read_ptr);
+        row_buffer.resize(image_width);
+        if (pass_count > 1 && first_row < last_row)
+        {
+            interlace_buffer.resize(static_cast<std::size_t>(last_row - first_row) * image_width);
+        }
+
+        auto row_pointer = [&](std::int32_t y)
+        {
+            if (pass_count > 1 && y >= first_row && y < last_row)
+            {
+                return &interlace_buffer[static_cast<std::size_t>(y - first_row) * image_width];
+            }
+
+            return row_buffer.data();
+        };
+
+        auto copy_row = [&](std::int32_t y, const png_byte* row)
+        {
+            for (std::size_t index = 0; index != areas.size(); ++index)
+            {
+                const auto& area = areas[index];
+                if (y >= area.top && y < area.bottom())
+                {
+                    std::copy(row + area.left, row + area.right(), result[index].row_begin(y - area.top));
                 }
             }
+        };
+
+        // Rows past the last area are never decoded.
+        auto end_row = pass_count > 1 ? image_height : last_row;
+        for (decltype(pass_count) pass = 0; pass != pass_count; ++pass)
+        {
+            for (std::int32_t y = 0; y < end_row; ++y)
+            {
+                auto row = row_pointer(y);
+                png_read_row(read_ptr, row, nullptr);
+
+                if (pass_count == 1) copy_row(y, row);
+            }
         }
 
-        throw PatternLoadError(file_name);
+        if (pass_count > 1)
+        {
+            for (std::int32_t y = first_row; y < last_row; ++y)
+            {
+                copy_row(y, row_pointer(y));
+            }
+        }
+
+        return result;
     }
 
     Pattern::const_iterator Pattern::begin() const
@@ -348,12 +416,13 @@ namespace components
     std::array<png_color, 256> create_palette(const TerrainLibrary& terrain_library)
     {
         std::array<png_color, 256> palette;
+        const auto& terrain_palette = terrain_library.palette();
         for (std::uint32_t terrain_id = 0; terrain_id != 256; ++terrain_id)
         {
-            const auto& terrain = terrain_library.terrain_by_id(terrain_id);
-            palette[terrain_id].red = terrain.red;
-            palette[terrain_id].green = terrain.green;
-            palette[terrain_id].blue = terrain.blue;
+            const auto& color = terrain_palette[terrain_id];
+            palette[terrain_id].red = color.red;
+            palette[terrain_id].green = color.green;
+            palette[terrain_id].blue = color.blue;
         }
 
         return palette;
@@ -365,7 +434,241 @@ namespace components
 
     }
 
-    void save_pattern(const Pattern& pattern, const TerrainLibrary& terrain_library, const std::string& file_name)
+    PatternSaveOptions PatternSaveOptions::fast()
+    {
+        PatternSaveOptions options;
+        options.compression_level = 1;
+        options.filter = PngFilter::None;
+        return options;
+    }
+
+    namespace png
+    {
+        int filter_flags(PngFilter filter)
+        {
+            switch (filter)
+            {
+            case PngFilter::None: return PNG_FILTER_NONE;
+            case PngFilter::Sub: return PNG_FILTER_SUB;
+            case PngFilter::Up: return PNG_FILTER_UP;
+            case PngFilter::Average: return PNG_FILTER_AVG;
+            case PngFilter::Paeth: return PNG_FILTER_PAETH;
+            case PngFilter::Adaptive: return PNG_ALL_FILTERS;
+            default: return PNG_FILTER_NONE;
+            }
+        }
+
+        png_byte paeth_predictor(png_byte a, png_byte b, png_byte c)
+        {
+            int p = a + b - c;
+            int pa = std::abs(p - a);
+            int pb = std::abs(p - b);
+            int pc = std::abs(p - c);
+
+            if (pa <= pb && pa <= pc) return a;
+            if (pb <= pc) return b;
+            return c;
+        }
+
+        // Writes the filter type byte followed by the filtered row. prev_row is null for the first row.
+        void filter_row(const png_byte* row, const png_byte* prev_row, std::size_t width, int filter_type, png_byte* out)
+        {
+            *out++ = static_cast<png_byte>(filter_type);
+
+            for (std::size_t x = 0; x != width; ++x)
+            {
+                png_byte a = x != 0 ? row[x - 1] : 0;
+                png_byte b = prev_row ? prev_row[x] : 0;
+                png_byte c = x != 0 && prev_row ? prev_row[x - 1] : 0;
+
+                switch (filter_type)
+                {
+                case PNG_FILTER_VALUE_SUB: out[x] = row[x] - a; break;
+                case PNG_FILTER_VALUE_UP: out[x] = row[x] - b; break;
+                case PNG_FILTER_VALUE_AVG: out[x] = row[x] - static_cast<png_byte>((a + b) / 2); break;
+                case PNG_FILTER_VALUE_PAETH: out[x] = row[x] - paeth_predictor(a, b, c); break;
+                default: out[x] = row[x]; break;
+                }
+            }
+        }
+
+        // Picks the filter with the smallest sum of absolute differences, the way libpng does.
+        void filter_row_adaptive(const png_byte* row, const png_byte* prev_row, std::size_t width,
+            png_byte* out, std::vector<png_byte>& scratch)
+        {
+            scratch.resize(width + 1);
+
+            std::uint64_t best_sum = 0;
+            for (int filter_type = PNG_FILTER_VALUE_NONE; filter_type != PNG_FILTER_VALUE_LAST; ++filter_type)
+            {
+                filter_row(row, prev_row, width, filter_type, scratch.data());
+
+                std::uint64_t sum = 0;
+                for (std::size_t x = 1; x <= width; ++x)
+                {
+                    sum += scratch[x] < 128 ? scratch[x] : 256 - scratch[x];
+                }
+
+                if (filter_type == PNG_FILTER_VALUE_NONE || sum < best_sum)
+                {
+                    best_sum = sum;
+                    std::copy(scratch.begin(), scratch.end(), out);
+                }
+            }
+        }
+
+        // Deflates a band of the filtered image data into raw deflate blocks that end on a byte boundary,
+        // primed with the data that precedes it so that the bands compress nearly as well as a single stream.
+        std::vector<png_byte> deflate_band(const png_byte* data, std::size_t begin, std::size_t end, 
+            bool last_band, int level)
+        {
+            std::vector<png_byte> result;
+
+            z_stream stream{};
+            if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                throw std::runtime_error("could not initialize zlib");
+            }
+
+            std::size_t dictionary_size = std::min<std::size_t>(begin, 1 << MAX_WBITS);
+            if (dictionary_size != 0)
+            {
+                deflateSetDictionary(&stream, data + begin - dictionary_size, static_cast<uInt>(dictionary_size));
+            }
+
+            stream.next_in = const_cast<png_bytep>(data + begin);
+            stream.avail_in = static_cast<uInt>(end - begin);
+
+            result.resize(deflateBound(&stream, stream.avail_in) + 16);
+            int flush = last_band ? Z_FINISH : Z_SYNC_FLUSH;
+
+            for (;;)
+            {
+                std::size_t written = stream.total_out;
+                stream.next_out = result.data() + written;
+                stream.avail_out = static_cast<uInt>(result.size() - written);
+
+                int status = deflate(&stream, flush);
+                bool done = last_band ? status == Z_STREAM_END : 
+                    stream.avail_out != 0 && (status == Z_OK || status == Z_BUF_ERROR);
+
+                if (done) break;
+
+                if (status != Z_OK && status != Z_BUF_ERROR)
+                {
+                    deflateEnd(&stream);
+                    throw std::runtime_error("could not compress pattern");
+                }
+
+                result.resize(result.size() * 2);
+            }
+
+            result.resize(stream.total_out);
+            deflateEnd(&stream);
+            return result;
+        }
+
+        void write_parallel_image(png_structp png_ptr, const Pattern& pattern, const PatternSaveOptions& options)
+        {
+            auto pattern_size = pattern.size();
+            std::size_t row_size = pattern_size.x + 1;
+            std::size_t row_count = pattern_size.y;
+
+            const std::size_t band_target_size = 1 << 18;
+            std::size_t rows_per_band = std::max<std::size_t>(band_target_size / row_size, 1);
+            std::size_t band_count = (row_count + rows_per_band - 1) / rows_per_band;
+            std::size_t worker_count = std::min<std::size_t>(options.thread_count, band_count);
+
+            auto run_bands = [&](const std::function<void(std::size_t)>& band_function)
+            {
+                std::atomic<std::size_t> next_band(0);
+                auto worker = [&]()
+                {
+                    for (std::size_t band = next_band++; band < band_count; band = next_band++)
+                    {
+                        band_function(band);
+                    }
+                };
+
+                std::vector<std::future<void>> workers;
+                for (std::size_t i = 0; i != worker_count; ++i)
+                {
+                    workers.push_back(std::async(std::launch::async, worker));
+                }
+
+                for (auto& future : workers) future.get();
+            };
+
+            // Filtering first, because each band's compression wants the filtered data before it.
+            std::vector<png_byte> filtered(row_size * row_count);
+            run_bands([&](std::size_t band)
+            {
+                std::vector<png_byte> scratch;
+                for (std::size_t y = band * rows_per_band, end = std::min(y + rows_per_band, row_count); y != end; ++y)
+                {
+                    const png_byte* row = pattern.row_begin(y);
+                    const png_byte* prev_row = y != 0 ? pattern.row_begin(y - 1) : nullptr;
+                    auto out = filtered.data() + y * row_size;
+
+                    switch (options.filter)
+                    {
+                    case PngFilter::Sub: filter_row(row, prev_row, pattern_size.x, PNG_FILTER_VALUE_SUB, out); break;
+                    case PngFilter::Up: filter_row(row, prev_row, pattern_size.x, PNG_FILTER_VALUE_UP, out); break;
+                    case PngFilter::Average: filter_row(row, prev_row, pattern_size.x, PNG_FILTER_VALUE_AVG, out); break;
+                    case PngFilter::Paeth: filter_row(row, prev_row, pattern_size.x, PNG_FILTER_VALUE_PAETH, out); break;
+                    case PngFilter::Adaptive: filter_row_adaptive(row, prev_row, pattern_size.x, out, scratch); break;
+                    default: filter_row(row, prev_row, pattern_size.x, PNG_FILTER_VALUE_NONE, out); break;
+                    }
+                }
+            });
+
+            std::vector<std::vector<png_byte>> compressed(band_count);
+            std::vector<uLong> checksums(band_count);
+            run_bands([&](std::size_t band)
+            {
+                std::size_t begin = band * rows_per_band * row_size;
+                std::size_t end = std::min(begin + rows_per_band * row_size, filtered.size());
+
+                compressed[band] = deflate_band(filtered.data(), begin, end, band + 1 == band_count, options.compression_level);
+                checksums[band] = adler32(adler32(0, Z_NULL, 0), filtered.data() + begin, static_cast<uInt>(end - begin));
+            });
+
+            uLong checksum = adler32(0, Z_NULL, 0);
+            for (std::size_t band = 0; band != band_count; ++band)
+            {
+                std::size_t begin = band * rows_per_band * row_size;
+                std::size_t end = std::min(begin + rows_per_band * row_size, filtered.size());
+                checksum = adler32_combine(checksum, checksums[band], static_cast<z_off_t>(end - begin));
+            }
+
+            // The zlib header and trailer around the deflate data, as in RFC 1950.
+            std::int32_t level = options.compression_level < 0 ? 6 : options.compression_level;
+            png_byte level_flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+
+            png_byte header[2] = { 0x78, static_cast<png_byte>(level_flags << 6) };
+            header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+
+            png_byte trailer[4] = {
+                static_cast<png_byte>(checksum >> 24), static_cast<png_byte>(checksum >> 16),
+                static_cast<png_byte>(checksum >> 8), static_cast<png_byte>(checksum) 
+            };
+
+            compressed.front().insert(compressed.front().begin(), header, header + 2);
+            compressed.back().insert(compressed.back().end(), trailer, trailer + 4);
+
+            png_byte idat_name[5] = { 'I', 'D', 'A', 'T', '\0' };
+            for (auto& data : compressed)
+            {
+                png_write_chunk(png_ptr, idat_name, data.data(), data.size());
+            }
+
+            png_byte iend_name[5] = { 'I', 'E', 'N', 'D', '\0' };
+            png_write_chunk(png_ptr, iend_name, nullptr, 0);
+        }
+    }
+
+    void save_pattern(const Pattern& pattern, const TerrainLibrary& terrain_library, const std::string& file_name,
+        const PatternSaveOptions& options)
     {
         std::basic_ofstream<unsigned char> out(file_name, std::ios::binary | std::ios::out);
 
@@ -381,22 +684,41 @@ namespace components
 
         auto pattern_size = pattern.size();
 
-
-        std::vector<png_bytep> pattern_rows(pattern_size.y);
-        for (std::uint32_t y = 0; y != pattern_size.y; ++y)
-        {
-            // Oh my.
-            pattern_rows[y] = const_cast<png_byte*>(pattern.row_begin(y));
-        }
-
         png_set_IHDR(png_ptr, info_ptr, pattern_size.x, pattern_size.y, 8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
         auto palette = create_palette(terrain_library);
         png_set_PLTE(png_ptr, info_ptr, palette.data(), palette.size());
 
+        // These have to be set before writing the header, which is when libpng sets up zlib.
+        png_set_compression_level(png_ptr, options.compression_level);
+        if (options.filter != PngFilter::Default)
+        {
+            png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, png::filter_flags(options.filter));
+        }
+
         png_write_info(png_ptr, info_ptr);
-        png_write_image(png_ptr, pattern_rows.data());
-        png_write_end(png_ptr, info_ptr);
+
+        if (options.thread_count > 1 && pattern_size.y > 1)
+        {
+            png::write_parallel_image(png_ptr, pattern, options);
+        }
+
+        else
+        {
+            std::vector<png_bytep> pattern_rows(pattern_size.y);
+            for (std::uint32_t y = 0; y != pattern_size.y; ++y)
+            {
+                // Oh my.
+                pattern_rows[y] = const_cast<png_byte*>(pattern.row_begin(y));
+            }
+
+            png_write_image(png_ptr, pattern_rows.data());
+            png_write_end(png_ptr, info_ptr);
+        }
+
+        // The write callback can't report failures to libpng, so a short write only shows up here.
+        out.close();
+        if (!out) throw PatternSaveError(file_name);
     }
-}
\ No newline at end of file
+}
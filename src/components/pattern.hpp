@@ -27,6 +27,7 @@
 #define PATTERN_HPP
 
 #include "terrain_definition.hpp"
+#include "terrain_library.hpp"
 
 #include "core/vector2.hpp"
 #include "core/rect.hpp"
@@ -86,14 +87,45 @@ namespace components
         std::vector<TerrainId> bytes_;
     };
 
+    // Decodes the pattern file a row at a time, and copies out only the given areas. A zero width or 
+    // height stands for the image's full extent. Any number of areas is served from a single pass.
+    // The file's palette colors are stored in palette if given, entries it doesn't define are zeroed.
+    std::vector<Pattern> load_pattern_areas(const std::string& file_name, std::vector<core::IntRect> areas,
+        TerrainPalette* palette = nullptr);
+
     struct PatternSaveError
         : std::runtime_error
     {
         PatternSaveError(const std::string& file_name);
     };
 
+    enum class PngFilter
+    {
+        Default,
+        None,
+        Sub,
+        Up,
+        Average,
+        Paeth,
+        Adaptive
+    };
+
+    struct PatternSaveOptions
+    {
+        // zlib's compression level from 0 to 9, or -1 for zlib's default.
+        std::int32_t compression_level = -1;
+        PngFilter filter = PngFilter::Default;
+
+        // With more than one thread, bands of rows are compressed concurrently and joined into one stream.
+        std::uint32_t thread_count = 1;
+
+        // Unfiltered and barely compressed, for when speed matters more than size.
+        static PatternSaveOptions fast();
+    };
+
     class TerrainLibrary;
-    void save_pattern(const Pattern& pattern, const TerrainLibrary& terrain_library, const std::string& file_name);
+    void save_pattern(const Pattern& pattern, const TerrainLibrary& terrain_library, const std::string& file_name,
+        const PatternSaveOptions& options = {});
 }
 
 
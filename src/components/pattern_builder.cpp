@@ -29,6 +29,8 @@
 #include "tile_definition.hpp"
 
 #include "tile_group_expansion.hpp"
+#include "tile_occlusion.hpp"
+#include "pattern_sampling.hpp"
 
 #include "core/rect.hpp"
 #include "core/vector2.hpp"
@@ -39,8 +41,13 @@
 
 namespace components
 {
-    void apply_pattern(Pattern& dest, const Pattern& source, core::IntRect rect, core::Vector2i position, 
-        core::Rotation<double> rotation);
+    namespace
+    {
+        void apply_pattern_block(Pattern& dest, const PatternBlock& block, core::Vector2i position);
+
+        void apply_rotated_pattern(Pattern& dest, const PatternBlock& block, core::Vector2i area_size,
+            core::Vector2i position, core::Rotation<double> rotation);
+    }
 
     PatternBuilder::PatternBuilder(const Track& track, PatternStore pattern_store)
         : track_(track),
@@ -52,24 +59,80 @@ namespace components
     {
         Pattern pattern(track_.size());
 
-        std::vector<PlacedTile> tile_expansion;
-
         const auto& layers = track_.layers();
+        const auto& tile_library = track_.tile_library();
+
+        std::vector<PlacedTile> tile_expansion;
         for (const auto& layer : layers)
         {
-            expand_tile_groups(layer->tiles.begin(), layer->tiles.end(), track_.tile_library(),
+            expand_tile_groups(layer->tiles.begin(), layer->tiles.end(), tile_library,
                 std::back_inserter(tile_expansion));
         }
 
+        // Cut all the pattern areas out of their sheets in one go, rather than one sheet at a time.
+        std::vector<const TileDefinition*> tile_defs;
+        std::vector<bool> checked_tiles;
         for (const auto& placed_tile : tile_expansion)
         {
             const auto* tile_def = placed_tile.tile_def;
-            const auto& tile = placed_tile.tile;
+            if (tile_def->id >= checked_tiles.size()) checked_tiles.resize(tile_def->id + 1, false);
+
+            if (!checked_tiles[tile_def->id])
+            {
+                tile_defs.push_back(tile_def);
+                checked_tiles[tile_def->id] = true;
+            }
+        }
+
+        pattern_store_.load_tile_blocks(tile_defs);
+        if (step_operation) step_operation();
+
+        // Tiles whose pattern area is entirely overwritten by later tiles need not be applied at all.
+        std::vector<bool> opaque_tiles(checked_tiles.size(), false);
+        for (const auto* tile_def : tile_defs)
+        {
+            core::Vector2i area_size(tile_def->pattern_rect.width, tile_def->pattern_rect.height);
+            opaque_tiles[tile_def->id] = is_solid_pattern_block(pattern_store_.tile_block(*tile_def), area_size);
+        }
+
+        auto occlusion = compute_tile_occlusion(track_, opaque_tiles, OcclusionScope::Track);
+
+        for (const auto& layer : layers)
+        {
+            const auto& tiles = layer->tiles;
+            const auto& occluded = occlusion[layer.id()].occluded;
+
+            for (std::size_t tile_index = 0; tile_index != tiles.size(); ++tile_index)
+            {
+                tile_expansion.clear();
+                expand_tile_groups(&tiles[tile_index], &tiles[tile_index] + 1, tile_library,
+                    std::back_inserter(tile_expansion));
+
+                for (const auto& placed_tile : tile_expansion)
+                {
+                    if (!occluded[tile_index])
+                    {
+                        const auto* tile_def = placed_tile.tile_def;
+                        const auto& tile = placed_tile.tile;
+
+                        // Right angles map pixels onto pixels, so those have their footprint ready to be copied.
+                        auto degrees = tile.rotation.whole_degrees();
+                        if (degrees % 90 == 0)
+                        {
+                            apply_pattern_block(pattern, pattern_store_.tile_block(*tile_def, degrees / 90), tile.position);
+                        }
 
-            auto handle = pattern_store_.load_from_file(tile_def->pattern_file);
-            apply_pattern(pattern, *handle, tile_def->pattern_rect, tile.position, tile.rotation);
+                        else
+                        {
+                            core::Vector2i area_size(tile_def->pattern_rect.width, tile_def->pattern_rect.height);
+                            apply_rotated_pattern(pattern, pattern_store_.tile_block(*tile_def), area_size, 
+                                tile.position, tile.rotation);
+                        }
+                    }
 
-            if (step_operation) step_operation();
+                    if (step_operation) step_operation();
+                }
+            }
         }
 
         return pattern;
@@ -80,75 +143,56 @@ namespace components
         pattern_store_.load_from_file(path);
     }
 
-    void apply_pattern(Pattern& dest, const Pattern& source,
-        core::IntRect rect, core::Vector2i position, core::Rotation<double> rotation)
+    namespace
     {
-        double radians = rotation.radians();
-
-        double sin = -std::sin(radians);
-        double cos = std::cos(radians);        
-
-        core::Vector2i world_size(dest.size().x, dest.size().y);
-        core::Vector2i pattern_size(source.size().x, dest.size().y);
-        core::Vector2i source_size(rect.width, rect.height);
-
-        core::Vector2i dest_size;
+        void apply_pattern_block(Pattern& dest, const PatternBlock& block, core::Vector2i position)
         {
-            double x = source_size.x * 0.5f;
-            double y = source_size.y * 0.5f;
-
-            double cx = x * cos;
-            double cy = y * cos;
-            double sx = x * sin;
-            double sy = y * sin;
+            core::Vector2i world_size(dest.size().x, dest.size().y);
+            auto offset = position + block.offset;
 
-            double half_width = std::abs(cx) + std::abs(sy);
-            double half_height = std::abs(cy) + std::abs(sx);
-
-            dest_size.x = static_cast<std::int32_t>(std::ceil(half_width * 2.0));
-            dest_size.y = static_cast<std::int32_t>(std::ceil(half_height * 2.0));
-        }
+            std::int32_t start_x = std::max(-offset.x, 0);
+            std::int32_t start_y = std::max(-offset.y, 0);
+            std::int32_t end_x = std::min(block.size.x, world_size.x - offset.x);
+            std::int32_t end_y = std::min(block.size.y, world_size.y - offset.y);
 
-        auto source_center = core::vector2_cast<double>(source_size) * 0.5;
-
-        if (rect.right() > pattern_size.x) rect.width = pattern_size.x - rect.left;
-        if (rect.bottom() > pattern_size.y) rect.height = pattern_size.y - rect.top;
-
-        std::int32_t start_x = (source_size.x - dest_size.x) / 2 - 1;
-        std::int32_t start_y = (source_size.y - dest_size.y) / 2 - 1;
+            // Transparent runs aren't stored at all, and the others are filled in one go.
+            for (std::int32_t y = start_y; y < end_y; ++y)
+            {
+                auto row = dest.row_begin(y + offset.y);
+                auto spans_end = block.spans + block.row_offsets[y + 1];
 
-        std::int32_t end_x = start_x + dest_size.x + 2;
-        std::int32_t end_y = start_y + dest_size.y + 2;
+                for (auto span = block.spans + block.row_offsets[y]; span != spans_end; ++span)
+                {
+                    auto span_start = std::max(span->x, start_x);
+                    auto span_end = std::min(span->x + span->length, end_x);
 
-        std::int32_t offset_x = position.x - source_size.x / 2;
-        std::int32_t offset_y = position.y - source_size.y / 2;
+                    if (span_start < span_end)
+                    {
+                        std::fill(row + offset.x + span_start, row + offset.x + span_end, span->terrain);
+                    }
+                }
+            }
+        }
 
-        core::Vector2<double> dest_point;
-        for (std::int32_t y = start_y; y <= end_y; ++y)
+        void apply_rotated_pattern(Pattern& dest, const PatternBlock& block, core::Vector2i area_size,
+            core::Vector2i position, core::Rotation<double> rotation)
         {
-            dest_point.y = static_cast<double>(y) - source_center.y;
+            core::Vector2i world_size(dest.size().x, dest.size().y);
+
+            std::int32_t offset_x = position.x - area_size.x / 2;
+            std::int32_t offset_y = position.y - area_size.y / 2;
 
-            for (std::int32_t x = start_x; x <= end_x; ++x)
+            sample_rotated_pattern(block.data, block.size.x, area_size, block.size, rotation,
+                [&](std::int32_t x, std::int32_t y, TerrainId terrain)
             {
-                dest_point.x = static_cast<double>(x) - source_center.x;
-                
                 std::int32_t absolute_x = x + offset_x;
                 std::int32_t absolute_y = y + offset_y;
 
                 if (absolute_x >= 0 && absolute_y >= 0 && absolute_x < world_size.x && absolute_y < world_size.y)
                 {
-                    auto source_point = core::transform_point<double>(dest_point, sin, cos) + source_center;
-                    auto point = core::vector2_round<std::int32_t>(core::vector2_cast<float>(source_point));
-
-                    if (point.x >= 0 && point.y >= 0 && point.x < rect.width && point.y < rect.height)
-                    {
-                        if (auto terrain = source(point.x + rect.left, point.y + rect.top))
-                        {
-                            dest(absolute_x, absolute_y) = terrain;
-                        }
-                    }
+                    dest(absolute_x, absolute_y) = terrain;
                 }
-            }
+            });
         }
     }
-}
\ No newline at end of file
+}
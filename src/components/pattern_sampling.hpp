@@ -0,0 +1,103 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef PATTERN_SAMPLING_HPP
+#define PATTERN_SAMPLING_HPP
+
+#include "terrain_definition.hpp"
+
+#include "core/vector2.hpp"
+#include "core/rotation.hpp"
+#include "core/transform.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace components
+{
+    // Visits every pixel a tile's pattern area covers when it's turned around its center.
+    // area_size is the size of the area as the tile defines it, of which only the top left
+    // readable_size pixels can be read from data. The callback receives the pixel's position
+    // relative to the top left corner of the unrotated area, and its terrain if it's not zero.
+    template <typename Callback>
+    void sample_rotated_pattern(const TerrainId* data, std::size_t stride, core::Vector2i area_size,
+        core::Vector2i readable_size, core::Rotation<double> rotation, Callback callback)
+    {
+        double radians = rotation.radians();
+
+        double sin = -std::sin(radians);
+        double cos = std::cos(radians);
+
+        core::Vector2i dest_size;
+        {
+            double x = area_size.x * 0.5f;
+            double y = area_size.y * 0.5f;
+
+            double cx = x * cos;
+            double cy = y * cos;
+            double sx = x * sin;
+            double sy = y * sin;
+
+            double half_width = std::abs(cx) + std::abs(sy);
+            double half_height = std::abs(cy) + std::abs(sx);
+
+            dest_size.x = static_cast<std::int32_t>(std::ceil(half_width * 2.0));
+            dest_size.y = static_cast<std::int32_t>(std::ceil(half_height * 2.0));
+        }
+
+        auto source_center = core::vector2_cast<double>(area_size) * 0.5;
+
+        std::int32_t start_x = (area_size.x - dest_size.x) / 2 - 1;
+        std::int32_t start_y = (area_size.y - dest_size.y) / 2 - 1;
+
+        std::int32_t end_x = start_x + dest_size.x + 2;
+        std::int32_t end_y = start_y + dest_size.y + 2;
+
+        core::Vector2<double> dest_point;
+        for (std::int32_t y = start_y; y <= end_y; ++y)
+        {
+            dest_point.y = static_cast<double>(y) - source_center.y;
+
+            for (std::int32_t x = start_x; x <= end_x; ++x)
+            {
+                dest_point.x = static_cast<double>(x) - source_center.x;
+
+                auto source_point = core::transform_point<double>(dest_point, sin, cos) + source_center;
+                auto point = core::vector2_round<std::int32_t>(core::vector2_cast<float>(source_point));
+
+                if (point.x >= 0 && point.y >= 0 && point.x < readable_size.x && point.y < readable_size.y)
+                {
+                    if (auto terrain = data[point.y * stride + point.x])
+                    {
+                        callback(x, y, terrain);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef PATTERN_SPANS_HPP
+#define PATTERN_SPANS_HPP
+
+#include "terrain_definition.hpp"
+
+#include <cstdint>
+
+namespace components
+{
+    // A run of pixels with the same terrain. Runs of terrain 0 are left out.
+    struct TerrainSpan
+    {
+        std::int32_t x;
+        std::int32_t length;
+        TerrainId terrain;
+    };
+
+    inline bool operator==(const TerrainSpan& a, const TerrainSpan& b)
+    {
+        return a.x == b.x && a.length == b.length && a.terrain == b.terrain;
+    }
+
+    inline bool operator!=(const TerrainSpan& a, const TerrainSpan& b)
+    {
+        return !(a == b);
+    }
+
+    template <typename OutputIt>
+    OutputIt encode_terrain_spans(const TerrainId* row, std::int32_t width, OutputIt out)
+    {
+        for (std::int32_t x = 0; x < width; )
+        {
+            std::int32_t start = x;
+            TerrainId terrain = row[x];
+            while (++x < width && row[x] == terrain) {}
+
+            if (terrain != 0)
+            {
+                *out++ = TerrainSpan{ start, x - start, terrain };
+            }
+        }
+
+        return out;
+    }
+}
+
+#endif
@@ -25,12 +25,112 @@
 
 #include "pattern_store.hpp"
 #include "pattern.hpp"
+#include "pattern_sampling.hpp"
 
 #include "tile_library.hpp"
 #include "tile_definition.hpp"
 
+#include <mutex>
+#include <algorithm>
+#include <iterator>
+
 namespace components
 {
+    namespace
+    {
+        const std::size_t block_chunk_size = 1 << 20;
+
+        std::uint32_t block_key(TileId tile_id, std::int32_t quarter_turns)
+        {
+            return static_cast<std::uint32_t>(tile_id) * 4 + quarter_turns;
+        }
+
+        core::Vector2i area_size(const TileDefinition& tile_def)
+        {
+            return core::Vector2i(tile_def.pattern_rect.width, tile_def.pattern_rect.height);
+        }
+    }
+
+    struct PatternStore::BlockArena
+    {
+        template <typename T>
+        T* allocate(std::size_t count)
+        {
+            std::size_t size = count * sizeof(T);
+            std::size_t padding = (alignof(T) - reinterpret_cast<std::uintptr_t>(chunk_pointer) % alignof(T)) % alignof(T);
+
+            if (size + padding > chunk_left)
+            {
+                // Big blocks get a chunk of their own, so as not to waste the rest of the current one.
+                if (size >= block_chunk_size / 4)
+                {
+                    chunks.emplace_back(new std::uint64_t[(size + 7) / 8]());
+                    return reinterpret_cast<T*>(chunks.back().get());
+                }
+
+                chunks.emplace_back(new std::uint64_t[block_chunk_size / 8]());
+                chunk_pointer = reinterpret_cast<std::uint8_t*>(chunks.back().get());
+                chunk_left = block_chunk_size;
+                padding = 0;
+            }
+
+            auto result = reinterpret_cast<T*>(chunk_pointer + padding);
+            chunk_pointer += size + padding;
+            chunk_left -= size + padding;
+            return result;
+        }
+
+        PatternBlock store_block(core::Vector2i offset, core::Vector2i size)
+        {
+            PatternBlock block;
+            block.offset = offset;
+
+            if (size.x > 0 && size.y > 0)
+            {
+                block.size = size;
+                block.data = allocate<TerrainId>(static_cast<std::size_t>(size.x) * size.y);
+            }
+
+            return block;
+        }
+
+        // Must be called once the block's pixels are in place.
+        void encode_spans(PatternBlock& block)
+        {
+            span_buffer.clear();
+            offset_buffer.assign(1, 0);
+
+            for (std::int32_t y = 0; y < block.size.y; ++y)
+            {
+                encode_terrain_spans(block.data + y * block.size.x, block.size.x, std::back_inserter(span_buffer));
+                offset_buffer.push_back(static_cast<std::uint32_t>(span_buffer.size()));
+            }
+
+            auto spans = allocate<TerrainSpan>(span_buffer.size());
+            auto row_offsets = allocate<std::uint32_t>(offset_buffer.size());
+            std::copy(span_buffer.begin(), span_buffer.end(), spans);
+            std::copy(offset_buffer.begin(), offset_buffer.end(), row_offsets);
+
+            block.spans = spans;
+            block.row_offsets = row_offsets;
+        }
+
+        std::mutex mutex;
+        std::unordered_map<std::uint32_t, PatternBlock> blocks;
+
+        std::vector<std::unique_ptr<std::uint64_t[]>> chunks;
+        std::uint8_t* chunk_pointer = nullptr;
+        std::size_t chunk_left = 0;
+
+        std::vector<TerrainSpan> span_buffer;
+        std::vector<std::uint32_t> offset_buffer;
+    };
+
+    PatternStore::PatternStore()
+        : block_arena_(std::make_shared<BlockArena>())
+    {
+    }
+
     std::shared_ptr<Pattern> PatternStore::load_from_file(const std::string& file_name)
     {
         auto it = loaded_patterns_.find(file_name);
@@ -44,15 +144,173 @@ namespace components
         return pattern;
     }
 
+    void PatternStore::load_tile_blocks(const std::vector<const TileDefinition*>& tile_defs)
+    {
+        auto& arena = *block_arena_;
+        std::lock_guard<std::mutex> lock(arena.mutex);
+
+        std::unordered_map<std::string, std::vector<const TileDefinition*>> tiles_by_file;
+        for (const auto* tile_def : tile_defs)
+        {
+            auto& file_tiles = tiles_by_file[tile_def->pattern_file];
+            if (arena.blocks.count(block_key(tile_def->id, 0)) == 0 &&
+                std::find(file_tiles.begin(), file_tiles.end(), tile_def) == file_tiles.end())
+            {
+                file_tiles.push_back(tile_def);
+            }
+        }
+
+        for (const auto& file : tiles_by_file)
+        {
+            if (file.second.empty()) continue;
+
+            // Sheets that are around anyway are cut from directly, and so are the ones whose
+            // tiles don't fit in them, since loading the whole sheet is what clips the areas.
+            if (loaded_patterns_.count(file.first) == 0)
+            {
+                std::vector<core::IntRect> areas;
+                for (const auto* tile_def : file.second) areas.push_back(tile_def->pattern_rect);
+
+                std::vector<Pattern> patterns;
+                try
+                {
+                    patterns = load_pattern_areas(file.first, areas);
+                }
+
+                catch (const PatternLoadError&)
+                {
+                }
+
+                if (!patterns.empty())
+                {
+                    for (std::size_t index = 0; index != patterns.size(); ++index)
+                    {
+                        const auto& pattern = patterns[index];
+                        const auto* tile_def = file.second[index];
+
+                        auto size = area_size(*tile_def);
+                        auto block = arena.store_block(-size / 2, size);
+                        std::copy(pattern.begin(), pattern.begin() + size.x * size.y, const_cast<TerrainId*>(block.data));
+                        arena.encode_spans(block);
+
+                        arena.blocks.emplace(block_key(tile_def->id, 0), block);
+                    }
+
+                    continue;
+                }
+            }
+
+            for (const auto* tile_def : file.second)
+            {
+                arena.blocks.emplace(block_key(tile_def->id, 0), create_tile_block(*tile_def, 0));
+            }
+        }
+    }
+
+    PatternBlock PatternStore::tile_block(const TileDefinition& tile_def, std::int32_t quarter_turns)
+    {
+        quarter_turns = ((quarter_turns % 4) + 4) % 4;
+
+        auto& arena = *block_arena_;
+        std::lock_guard<std::mutex> lock(arena.mutex);
+
+        auto key = block_key(tile_def.id, quarter_turns);
+        auto it = arena.blocks.find(key);
+        if (it == arena.blocks.end())
+        {
+            it = arena.blocks.emplace(key, create_tile_block(tile_def, quarter_turns)).first;
+        }
+
+        return it->second;
+    }
+
+    PatternBlock PatternStore::create_tile_block(const TileDefinition& tile_def, std::int32_t quarter_turns)
+    {
+        auto& arena = *block_arena_;
+        auto size = area_size(tile_def);
+
+        if (quarter_turns == 0)
+        {
+            auto sheet = load_from_file(tile_def.pattern_file);
+            auto sheet_size = sheet->size();
+            auto rect = tile_def.pattern_rect;
+
+            // Only what lies within the sheet can be read.
+            core::Vector2i readable_size;
+            if (rect.left >= 0 && rect.top >= 0)
+            {
+                readable_size.x = std::max(std::min(rect.right(), static_cast<std::int32_t>(sheet_size.x)) - rect.left, 0);
+                readable_size.y = std::max(std::min(rect.bottom(), static_cast<std::int32_t>(sheet_size.y)) - rect.top, 0);
+            }
+
+            auto block = arena.store_block(-size / 2, readable_size);
+            for (std::int32_t y = 0; y < block.size.y; ++y)
+            {
+                auto row = sheet->row_begin(rect.top + y) + rect.left;
+                std::copy(row, row + block.size.x, const_cast<TerrainId*>(block.data) + y * block.size.x);
+            }
+
+            arena.encode_spans(block);
+
+            return block;
+        }
+
+        auto key = block_key(tile_def.id, 0);
+        auto base_it = arena.blocks.find(key);
+        if (base_it == arena.blocks.end())
+        {
+            base_it = arena.blocks.emplace(key, create_tile_block(tile_def, 0)).first;
+        }
+
+        const auto& base = base_it->second;
+        auto rotation = convert_rotation(quarter_turns * 90);
+
+        // The footprint is rendered the same way the pattern builder applies rotated tiles,
+        // so that applying the block gives exactly the same result. The first pass finds its bounds.
+        core::Vector2i min_point(0, 0), max_point(-1, -1);
+        bool empty = true;
+        sample_rotated_pattern(base.data, base.size.x, size, base.size, rotation,
+            [&](std::int32_t x, std::int32_t y, TerrainId)
+        {
+            if (empty)
+            {
+                min_point = max_point = core::Vector2i(x, y);
+                empty = false;
+            }
+
+            min_point.x = std::min(min_point.x, x);
+            min_point.y = std::min(min_point.y, y);
+            max_point.x = std::max(max_point.x, x);
+            max_point.y = std::max(max_point.y, y);
+        });
+
+        auto block = arena.store_block(min_point - size / 2, max_point - min_point + core::Vector2i(1, 1));
+        if (block.data)
+        {
+            auto data = const_cast<TerrainId*>(block.data);
+            sample_rotated_pattern(base.data, base.size.x, size, base.size, rotation,
+                [&](std::int32_t x, std::int32_t y, TerrainId terrain)
+            {
+                data[(y - min_point.y) * block.size.x + x - min_point.x] = terrain;
+            });
+        }
+
+        arena.encode_spans(block);
+
+        return block;
+    }
+
     PatternStore load_pattern_files(const TileLibrary& tile_library)
     {
         PatternStore result;
 
+        std::vector<const TileDefinition*> tile_defs;
         for (auto tile = tile_library.first_tile(); tile; tile = tile_library.next_tile(tile->id))
         {
-            result.load_from_file(tile->pattern_file);
+            tile_defs.push_back(tile);
         }
 
+        result.load_tile_blocks(tile_defs);
         return result;
     }
-}
\ No newline at end of file
+}
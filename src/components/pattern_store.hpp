@@ -26,21 +26,58 @@
 #ifndef PATTERN_LOADER_HPP
 #define PATTERN_LOADER_HPP
 
+#include "terrain_definition.hpp"
+#include "pattern_spans.hpp"
+
+#include "core/vector2.hpp"
+
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 
 namespace components
 {
     class Pattern;
+    struct TileDefinition;
+
+    // A tile's pattern footprint, cut out of its sheet. Pixels the tile leaves untouched are zero.
+    struct PatternBlock
+    {
+        // Position of the top left corner relative to the tile's position.
+        core::Vector2i offset;
+        core::Vector2i size;
+        const TerrainId* data = nullptr;
+
+        // The same pixels run-length encoded, with size.y + 1 offsets into the spans delimiting the rows.
+        const TerrainSpan* spans = nullptr;
+        const std::uint32_t* row_offsets = nullptr;
+    };
 
     class PatternStore
     {
     public:
+        PatternStore();
+
         std::shared_ptr<Pattern> load_from_file(const std::string& file_name);
 
+        // Cuts the pattern areas of the tiles out of their sheets, decoding each sheet that isn't
+        // loaded yet only once for all of its tiles.
+        void load_tile_blocks(const std::vector<const TileDefinition*>& tile_defs);
+
+        // The footprint of the tile turned by quarter_turns right angles, loaded on first use.
+        // For zero quarter turns, it is the unrotated pattern area itself.
+        PatternBlock tile_block(const TileDefinition& tile_def, std::int32_t quarter_turns = 0);
+
     private:
+        PatternBlock create_tile_block(const TileDefinition& tile_def, std::int32_t quarter_turns);
+
         std::unordered_map<std::string, std::shared_ptr<Pattern>> loaded_patterns_;
+
+        // The blocks are packed into a chunked arena, which copies of the store share.
+        struct BlockArena;
+        std::shared_ptr<BlockArena> block_arena_;
     };
 
     class TileLibrary;
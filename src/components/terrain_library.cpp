@@ -29,20 +29,35 @@
 
 #include <cstdint>
 #include <algorithm>
+#include <future>
+#include <thread>
 
 namespace components
 {
     static const std::uint32_t max_sub_terrains = 16;
 
+    static TerrainColor make_terrain_color(const TerrainDefinition& terrain)
+    {
+        TerrainColor color;
+        color.red = static_cast<std::uint8_t>(terrain.red);
+        color.green = static_cast<std::uint8_t>(terrain.green);
+        color.blue = static_cast<std::uint8_t>(terrain.blue);
+        color.alpha = 255;
+        return color;
+    }
+
     TerrainLibrary::TerrainLibrary()
         : terrains_(256),
-          sub_terrains_(terrains_.size() * max_sub_terrains)
+          sub_terrains_(terrains_.size() * max_sub_terrains),
+          hashes_dirty_(true)
     {
         for (std::uint32_t id = 0; id != 256; ++id)
         {
             terrains_[id].id = id;
-            terrains_[id].hash = calculate_terrain_hash(id);
+            palette_[id] = make_terrain_color(terrains_[id]);
         }
+
+        dirty_hashes_.fill(true);
     }
 
     void TerrainLibrary::define_terrain(TerrainDefinition terrain)
@@ -84,7 +99,8 @@ namespace components
             terrain.size += terrain.is_wall ? 1 : 0;
         }
 
-        static_cast<TerrainDefinition&>(terrains_[id]) = terrain;
+        terrains_[id] = terrain;
+        palette_[id] = make_terrain_color(terrain);
 
         {
             auto sub_terrains = &sub_terrains_[id * 16];
@@ -168,8 +184,7 @@ namespace components
             }
         }
 
-        TerrainId id = sub_terrain.terrain_id;
-        terrains_[id].hash = calculate_terrain_hash(id);
+        mark_hash_dirty(sub_terrain.terrain_id);
     }
 
     const TerrainDefinition& TerrainLibrary::sub_terrain(TerrainId terrain, std::uint32_t index) const
@@ -196,6 +211,16 @@ namespace components
 
     void TerrainLibrary::define_kill_terrain(TerrainId terrain_id)
     {
+        // Killing a terrain has never affected its hash, so a pending hash has to be computed beforehand.
+        {
+            std::lock_guard<std::mutex> lock(hash_mutex_);
+            if (dirty_hashes_[terrain_id])
+            {
+                terrain_hashes_[terrain_id] = calculate_terrain_hash(terrain_id);
+                dirty_hashes_[terrain_id] = false;
+            }
+        }
+
         terrains_[terrain_id].energyloss = 100000;
 
         auto* sub_terrain = &sub_terrains_[terrain_id * 16U];
@@ -209,7 +234,73 @@ namespace components
 
     const TerrainHash& TerrainLibrary::terrain_hash(TerrainId terrain_id) const
     {
-        return terrains_[terrain_id].hash;
+        if (hashes_dirty_.load(std::memory_order_acquire))
+        {
+            update_terrain_hashes();
+        }
+
+        return terrain_hashes_[terrain_id];
+    }
+
+    const TerrainHashTable& TerrainLibrary::terrain_hashes() const
+    {
+        if (hashes_dirty_.load(std::memory_order_acquire))
+        {
+            update_terrain_hashes();
+        }
+
+        return terrain_hashes_;
+    }
+
+    const TerrainPalette& TerrainLibrary::palette() const
+    {
+        return palette_;
+    }
+
+    void TerrainLibrary::mark_hash_dirty(TerrainId terrain_id)
+    {
+        std::lock_guard<std::mutex> lock(hash_mutex_);
+        dirty_hashes_[terrain_id] = true;
+        hashes_dirty_.store(true, std::memory_order_release);
+    }
+
+    void TerrainLibrary::update_terrain_hashes() const
+    {
+        std::lock_guard<std::mutex> lock(hash_mutex_);
+        if (!hashes_dirty_.load(std::memory_order_relaxed)) return;
+
+        std::vector<TerrainId> dirty_terrains;
+        for (std::uint32_t id = 0; id != 256; ++id)
+        {
+            if (dirty_hashes_[id]) dirty_terrains.push_back(static_cast<TerrainId>(id));
+        }
+
+        auto calculate_range = [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t index = begin; index != end; ++index)
+            {
+                auto id = dirty_terrains[index];
+                terrain_hashes_[id] = calculate_terrain_hash(id);
+            }
+        };
+
+        // Every terrain hashes independently, but it takes a good number of them to be worth the threads.
+        const std::size_t min_range_size = 32;
+        std::size_t worker_count = std::max(std::thread::hardware_concurrency(), 1U);
+        std::size_t range_size = std::max(min_range_size, (dirty_terrains.size() + worker_count - 1) / worker_count);
+
+        std::vector<std::future<void>> ranges;
+        for (std::size_t begin = range_size; begin < dirty_terrains.size(); begin += range_size)
+        {
+            ranges.push_back(std::async(std::launch::async, calculate_range, 
+                begin, std::min(begin + range_size, dirty_terrains.size())));
+        }
+
+        calculate_range(0, std::min(range_size, dirty_terrains.size()));
+        for (auto& future : ranges) future.get();
+
+        dirty_hashes_.fill(false);
+        hashes_dirty_.store(false, std::memory_order_release);
     }
 
     TerrainHash TerrainLibrary::calculate_terrain_hash(TerrainId terrain_id) const
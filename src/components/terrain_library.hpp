@@ -30,6 +30,8 @@
 
 #include <vector>
 #include <array>
+#include <atomic>
+#include <mutex>
 
 namespace components
 {
@@ -38,6 +40,18 @@ namespace components
 
     using TerrainHash = std::array<std::uint32_t, 4>;
 
+    struct TerrainColor
+    {
+        std::uint8_t red;
+        std::uint8_t green;
+        std::uint8_t blue;
+        std::uint8_t alpha;
+    };
+
+    // Dense copies of what the per-pixel paths need, indexed by terrain id.
+    using TerrainPalette = std::array<TerrainColor, 256>;
+    using TerrainHashTable = std::array<TerrainHash, 256>;
+
     class TerrainLibrary
     {
     public:
@@ -55,15 +69,15 @@ namespace components
 
         const TerrainHash& terrain_hash(TerrainId id) const;
 
+        const TerrainPalette& palette() const;
+        const TerrainHashTable& terrain_hashes() const;
+
     private:
         TerrainHash calculate_terrain_hash(TerrainId id) const;
         bool has_custom_sub_terrains(TerrainId terrain_id) const;
 
-        struct InternalTerrainDefinition
-            : TerrainDefinition
-        {
-            std::array<std::uint32_t, 4> hash;
-        };
+        void mark_hash_dirty(TerrainId id);
+        void update_terrain_hashes() const;
 
         struct SubTerrainDefinition
             : TerrainDefinition
@@ -72,8 +86,15 @@ namespace components
             double roof_level = 0.0;
         };
 
-        std::vector<InternalTerrainDefinition> terrains_;
+        std::vector<TerrainDefinition> terrains_;
         std::vector<SubTerrainDefinition> sub_terrains_;
+        TerrainPalette palette_;
+
+        // The hashes are only computed when they are asked for, all dirty ones at once.
+        mutable TerrainHashTable terrain_hashes_;
+        mutable std::array<bool, 256> dirty_hashes_;
+        mutable std::atomic<bool> hashes_dirty_;
+        mutable std::mutex hash_mutex_;
     };
 }
 
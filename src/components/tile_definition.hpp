@@ -33,6 +33,7 @@
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <cmath>
 
 namespace components
 {
@@ -42,11 +43,62 @@ namespace components
 
     using TileId = std::uint16_t;
 
+    inline core::Rotation<double> convert_rotation(std::int32_t degrees)
+    {
+        auto result = core::Rotation<float>::degrees(static_cast<float>(degrees));
+        return core::Rotation<double>::radians(result.radians());
+    }
+
+    // Tile rotations are kept in whole degrees, which is all the track format can store anyway.
+    // Along with the member order of Tile, this brings a tile down from 24 to 12 bytes.
+    class TileRotation
+    {
+    public:
+        TileRotation() = default;
+
+        TileRotation(core::Rotation<double> rotation)
+        {
+            auto degrees = static_cast<std::int32_t>(std::round(rotation.degrees())) % 360;
+            if (degrees < 0) degrees += 360;
+
+            degrees_ = static_cast<std::int16_t>(degrees);
+        }
+
+        operator core::Rotation<double>() const
+        {
+            return convert_rotation(degrees_);
+        }
+
+        // In the range [0, 360).
+        std::int32_t whole_degrees() const
+        {
+            return degrees_;
+        }
+
+        double degrees() const
+        {
+            return static_cast<double>(degrees_);
+        }
+
+        double radians() const
+        {
+            return convert_rotation(degrees_).radians();
+        }
+
+        core::Rotation<double> operator-() const
+        {
+            return -convert_rotation(degrees_);
+        }
+
+    private:
+        std::int16_t degrees_ = 0;
+    };
+
     struct Tile
     {
         TileId id = 0;
+        TileRotation rotation;
         core::Vector2i position;
-        core::Rotation<double> rotation;
     };
 
     struct LevelTile
@@ -118,12 +170,6 @@ namespace components
         const TileDefinition* tile_def = nullptr;
         LevelTile tile;
     };
-
-    inline core::Rotation<double> convert_rotation(std::int32_t degrees)
-    {
-        auto result = core::Rotation<float>::degrees(static_cast<float>(degrees));
-        return core::Rotation<double>::radians(result.radians());
-    }
 }
 
 #endif
\ No newline at end of file
@@ -60,9 +60,8 @@ namespace components
                 placed_tile.tile.level = sub_tile.level;
                 placed_tile.tile.position = tile_it->position + core::vector2_round<std::int32_t>(sub_tile_offset);
 
-                std::int32_t degrees = static_cast<std::int32_t>(std::round(tile_rotation.degrees())) +
-                    static_cast<std::int32_t>(std::round(sub_tile.rotation.degrees()));
-                placed_tile.tile.rotation = components::convert_rotation(degrees);
+                placed_tile.tile.rotation = components::convert_rotation(tile_it->rotation.whole_degrees() +
+                    sub_tile.rotation.whole_degrees());
 
                 *out = placed_tile;
                 ++out;
@@ -0,0 +1,263 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "tile_occlusion.hpp"
+#include "track.hpp"
+#include "pattern_store.hpp"
+#include "tile_definition.hpp"
+#include "tile_group_expansion.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <cmath>
+
+namespace components
+{
+    namespace
+    {
+        const std::int32_t coverage_cell_size = 8;
+
+        // The area a placed tile covers, a rotated rectangle.
+        struct TileFootprint
+        {
+            explicit TileFootprint(const PlacedTile& placed_tile)
+                : center(core::vector2_cast<double>(placed_tile.tile.position)),
+                  half_width(placed_tile.tile_def->pattern_rect.width * 0.5),
+                  half_height(placed_tile.tile_def->pattern_rect.height * 0.5),
+                  sin(std::sin(placed_tile.tile.rotation.radians())),
+                  cos(std::cos(placed_tile.tile.rotation.radians()))
+            {
+            }
+
+            core::DoubleRect bounds(double margin) const
+            {
+                double extent_x = half_width * std::abs(cos) + half_height * std::abs(sin) + margin;
+                double extent_y = half_width * std::abs(sin) + half_height * std::abs(cos) + margin;
+
+                return core::DoubleRect(center.x - extent_x, center.y - extent_y, extent_x * 2.0, extent_y * 2.0);
+            }
+
+            bool contains(core::Vector2<double> point, double inset) const
+            {
+                auto offset = point - center;
+                double x = offset.x * cos + offset.y * sin;
+                double y = offset.y * cos - offset.x * sin;
+
+                return std::abs(x) <= half_width - inset && std::abs(y) <= half_height - inset;
+            }
+
+            core::Vector2<double> center;
+            double half_width;
+            double half_height;
+            double sin;
+            double cos;
+        };
+
+        // Coarse grid over the track, a cell is covered once it's entirely inside an opaque tile.
+        class CoverageGrid
+        {
+        public:
+            explicit CoverageGrid(core::Vector2u track_size)
+                : columns_((static_cast<std::int32_t>(track_size.x) + coverage_cell_size - 1) / coverage_cell_size),
+                  rows_((static_cast<std::int32_t>(track_size.y) + coverage_cell_size - 1) / coverage_cell_size),
+                  cells_(columns_ * rows_, false)
+            {
+            }
+
+            bool is_covered(const TileFootprint& footprint) const
+            {
+                // Vertices extend a pixel beyond the pattern rect, leave some room for that.
+                auto cells = cell_range(footprint.bounds(2.0));
+                if (cells.left < 0 || cells.top < 0 || cells.right() > columns_ || cells.bottom() > rows_) return false;
+
+                for (std::int32_t y = cells.top; y != cells.bottom(); ++y)
+                {
+                    auto row = cells_.begin() + y * columns_;
+                    if (std::find(row + cells.left, row + cells.right(), false) != row + cells.right()) return false;
+                }
+
+                return true;
+            }
+
+            void cover(const TileFootprint& footprint)
+            {
+                auto cells = cell_range(footprint.bounds(0.0));
+
+                auto left = std::max(cells.left, 0), right = std::min(cells.right(), columns_);
+                auto top = std::max(cells.top, 0), bottom = std::min(cells.bottom(), rows_);
+
+                const double inset = 1.5;
+                const double size = coverage_cell_size;
+
+                for (std::int32_t y = top; y < bottom; ++y)
+                {
+                    for (std::int32_t x = left; x < right; ++x)
+                    {
+                        core::Vector2<double> corner(x * size, y * size);
+
+                        // The footprint is convex, so the cell is inside it if its corners are.
+                        if (footprint.contains(corner, inset) &&
+                            footprint.contains({ corner.x + size, corner.y }, inset) &&
+                            footprint.contains({ corner.x, corner.y + size }, inset) &&
+                            footprint.contains({ corner.x + size, corner.y + size }, inset))
+                        {
+                            cells_[y * columns_ + x] = true;
+                        }
+                    }
+                }
+            }
+
+        private:
+            static core::IntRect cell_range(core::DoubleRect bounds)
+            {
+                auto left = static_cast<std::int32_t>(std::floor(bounds.left / coverage_cell_size));
+                auto top = static_cast<std::int32_t>(std::floor(bounds.top / coverage_cell_size));
+                auto right = static_cast<std::int32_t>(std::floor(bounds.right() / coverage_cell_size)) + 1;
+                auto bottom = static_cast<std::int32_t>(std::floor(bounds.bottom() / coverage_cell_size)) + 1;
+
+                return core::IntRect(left, top, right - left, bottom - top);
+            }
+
+            std::int32_t columns_;
+            std::int32_t rows_;
+            std::vector<bool> cells_;
+        };
+    }
+
+    namespace
+    {
+        struct LayerView
+        {
+            std::size_t id;
+            std::size_t level;
+            bool visible;
+            const std::vector<Tile>* tiles;
+        };
+
+        OcclusionMap compute_layer_occlusion(const std::vector<LayerView>& layers, core::Vector2u track_size,
+            const TileLibrary& tile_library, const std::vector<bool>& opaque_tiles, OcclusionScope scope, 
+            bool include_hidden)
+        {
+            OcclusionMap result;
+
+            std::map<std::size_t, std::vector<const LayerView*>> layers_by_level;
+            for (const auto& layer : layers)
+            {
+                auto& occlusion = result[layer.id];
+                occlusion.occluded.assign(layer.tiles->size(), false);
+
+                if (include_hidden || layer.visible)
+                {
+                    auto level = scope == OcclusionScope::Level ? layer.level : 0;
+                    layers_by_level[level].push_back(&layer);
+                }
+            }
+
+            std::vector<PlacedTile> expansion;
+
+            auto is_opaque = [&](const PlacedTile& placed_tile)
+            {
+                auto id = placed_tile.tile_def->id;
+                return id < opaque_tiles.size() && opaque_tiles[id];
+            };
+
+            for (const auto& level : layers_by_level)
+            {
+                CoverageGrid coverage(track_size);
+
+                // Go from front to back, so that the coverage only contains tiles that come later.
+                for (auto layer_it = level.second.rbegin(); layer_it != level.second.rend(); ++layer_it)
+                {
+                    const auto& layer = **layer_it;
+                    const auto& tiles = *layer.tiles;
+                    auto& occlusion = result[layer.id];
+
+                    for (std::size_t tile_index = tiles.size(); tile_index-- != 0; )
+                    {
+                        const auto& tile = tiles[tile_index];
+
+                        expansion.clear();
+                        expand_tile_groups(&tile, &tile + 1, tile_library, std::back_inserter(expansion));
+                        if (expansion.empty()) continue;
+
+                        bool occluded = std::all_of(expansion.begin(), expansion.end(),
+                            [&](const PlacedTile& placed_tile)
+                        {
+                            return coverage.is_covered(TileFootprint(placed_tile));
+                        });
+
+                        if (occluded)
+                        {
+                            occlusion.occluded[tile_index] = true;
+                            ++occlusion.occluded_count;
+                            continue;
+                        }
+
+                        for (const auto& placed_tile : expansion)
+                        {
+                            if (is_opaque(placed_tile)) coverage.cover(TileFootprint(placed_tile));
+                        }
+                    }
+                }
+            }
+
+            return result;
+        }
+    }
+
+    OcclusionMap compute_tile_occlusion(const Track& track, const std::vector<bool>& opaque_tiles,
+        OcclusionScope scope, bool include_hidden)
+    {
+        std::vector<LayerView> layers;
+        for (const auto& layer : track.layers())
+        {
+            layers.push_back({ layer.id(), layer->level, layer->visible, &layer->tiles });
+        }
+
+        return compute_layer_occlusion(layers, track.size(), track.tile_library(), opaque_tiles, scope, include_hidden);
+    }
+
+    OcclusionMap compute_tile_occlusion(const std::vector<OcclusionLayer>& layers, core::Vector2u track_size,
+        const TileLibrary& tile_library, const std::vector<bool>& opaque_tiles, OcclusionScope scope, 
+        bool include_hidden)
+    {
+        std::vector<LayerView> layer_views;
+        for (const auto& layer : layers)
+        {
+            layer_views.push_back({ layer.id, layer.level, layer.visible, &layer.tiles });
+        }
+
+        return compute_layer_occlusion(layer_views, track_size, tile_library, opaque_tiles, scope, include_hidden);
+    }
+
+    bool is_solid_pattern_block(const PatternBlock& block, core::Vector2i area_size)
+    {
+        if (area_size.x <= 0 || area_size.y <= 0 || block.size != area_size || !block.data) return false;
+
+        auto end = block.data + block.size.x * block.size.y;
+        return std::find(block.data, end, 0) == end;
+    }
+}
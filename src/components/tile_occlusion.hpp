@@ -0,0 +1,85 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef TILE_OCCLUSION_HPP
+#define TILE_OCCLUSION_HPP
+
+#include "tile_definition.hpp"
+
+#include "core/rect.hpp"
+#include "core/vector2.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+namespace components
+{
+    class Track;
+    class TileLibrary;
+    struct PatternBlock;
+
+    struct LayerOcclusion
+    {
+        std::vector<bool> occluded;
+        std::size_t occluded_count = 0;
+    };
+
+    using OcclusionMap = std::unordered_map<std::size_t, LayerOcclusion>;
+
+    enum class OcclusionScope
+    {
+        // Tiles are drawn level by level, only tiles on the same level can cover each other.
+        Level,
+
+        // Tiles are applied in layer order regardless of level, as the pattern is built.
+        Track
+    };
+
+    // Finds the tiles that are completely covered by tiles that come after them.
+    // Only tile definitions that are marked in opaque_tiles, indexed by tile id, can cover others.
+    // Hidden layers are ignored unless include_hidden is set.
+    OcclusionMap compute_tile_occlusion(const Track& track, const std::vector<bool>& opaque_tiles,
+        OcclusionScope scope = OcclusionScope::Level, bool include_hidden = true);
+
+    // A copy of a layer's tiles, so that the occlusion can be computed while the track itself is being edited.
+    struct OcclusionLayer
+    {
+        std::size_t id;
+        std::size_t level;
+        bool visible;
+        std::vector<Tile> tiles;
+    };
+
+    // Same as above, for layers in drawing order. The tile library must stay unchanged while this runs.
+    OcclusionMap compute_tile_occlusion(const std::vector<OcclusionLayer>& layers, core::Vector2u track_size,
+        const TileLibrary& tile_library, const std::vector<bool>& opaque_tiles, 
+        OcclusionScope scope = OcclusionScope::Level, bool include_hidden = true);
+
+    // Whether every pixel of the tile's pattern area has a terrain, so that applying it overwrites everything below.
+    bool is_solid_pattern_block(const PatternBlock& block, core::Vector2i area_size);
+}
+
+#endif
@@ -32,60 +32,77 @@
 
 #include "core/md5.hpp"
 
+#include <algorithm>
+
 namespace components
 {
-    TrackHash calculate_track_hash(const Track& track, const Pattern& pattern)
+    namespace
     {
-        MD5 md5;
-
-        const auto& terrain_library = track.terrain_library();       
-
-        const auto& control_points = track.control_points();
-        for (ControlPoint point : control_points)
+        void hash_track_properties(MD5& md5, const Track& track)
         {
-            std::int32_t x = point.start.x;
-            std::int32_t y = point.start.y;
-            std::int32_t length = point.length;
-            std::uint8_t direction = (point.direction == ControlPoint::Vertical ? 0 : 1);
+            const auto& control_points = track.control_points();
+            for (ControlPoint point : control_points)
+            {
+                std::int32_t x = point.start.x;
+                std::int32_t y = point.start.y;
+                std::int32_t length = point.length;
+                std::uint8_t direction = (point.direction == ControlPoint::Vertical ? 0 : 1);
+
+                md5 << x << y << length << direction;
+            }
 
-            md5 << x << y << length << direction;
-        }
+            const auto& start_points = track.start_points();
+            for (StartPoint point : start_points)
+            {
+                std::int32_t x = point.position.x;
+                std::int32_t y = point.position.y;
+                std::int32_t rotation = point.rotation;
+                std::uint8_t level = point.level;
 
-        const auto& start_points = track.start_points();
-        for (StartPoint point : start_points)
-        {
-            std::int32_t x = point.position.x;
-            std::int32_t y = point.position.y;
-            std::int32_t rotation = point.rotation;
-            std::uint8_t level = point.level;
+                md5 << x << y << rotation << level;
+            }
 
-            md5 << x << y << rotation << level;
-        }
+            auto track_size = core::vector2_cast<std::int32_t>(track.size());
+            md5 << track_size.y << track_size.x;
 
-        auto track_size = core::vector2_cast<std::int32_t>(track.size());
-        md5 << track_size.y << track_size.x;
+            std::int32_t num_levels = track.num_levels();
+            if (num_levels != 1)
+            {
+                md5 << num_levels;
+            }
 
-        std::int32_t num_levels = track.num_levels();
-        if (num_levels != 1)
-        {
-            md5 << num_levels;
+            if (track.is_start_direction_overridden())
+            {
+                std::int32_t start_direction = track.start_direction();
+                md5 << start_direction;
+            }
         }
 
-        if (track.is_start_direction_overridden())
+        void hash_empty_pattern(MD5& md5)
         {
-            std::int32_t start_direction = track.start_direction();
-            md5 << start_direction;
+            md5 << std::uint32_t(0x70) << std::uint32_t(0x6F);
         }
+    }
+
+    TrackHash calculate_track_hash(const Track& track, const Pattern& pattern)
+    {
+        MD5 md5;
 
+        const auto& terrain_library = track.terrain_library();       
+
+        hash_track_properties(md5, track);
+
+        auto track_size = core::vector2_cast<std::int32_t>(track.size());
         if (track_size.y != 0)
         {
             std::uint32_t hash_index = 0;
+            const auto& terrain_hashes = terrain_library.terrain_hashes();
 
             for (std::int32_t y = 0; y != track_size.y; ++y)
             {                
                 for (std::int32_t x = 0; x != track_size.x; ++x)
                 {                   
-                    const auto& hash = terrain_library.terrain_hash(pattern(x, y));
+                    const auto& hash = terrain_hashes[pattern(x, y)];
                     md5 << hash[hash_index];
 
                     if (++hash_index >= 4)
@@ -98,11 +115,120 @@ namespace components
 
         else
         {
-            md5 << std::uint32_t(0x70) << std::uint32_t(0x6F);
+            hash_empty_pattern(md5);
+        }
+
+
+        md5.finalize();
+        return md5.digest();
+    }
+
+    TrackHash calculate_track_hash(const Track& track, const Pattern& pattern, PatternHashCache& hash_cache)
+    {
+        auto track_size = track.size();
+        auto pattern_size = pattern.size();
+        if (track_size.x != pattern_size.x || track_size.y != pattern_size.y)
+        {
+            return calculate_track_hash(track, pattern);
+        }
+
+        hash_cache.update(pattern, track.terrain_library());
+
+        MD5 md5;
+        hash_track_properties(md5, track);
+
+        if (track_size.y != 0)
+        {
+            for (std::uint32_t y = 0; y != track_size.y; ++y)
+            {
+                md5.update(hash_cache.row_data(y), static_cast<MD5::size_type>(hash_cache.row_data_size()));
+            }
         }
 
+        else
+        {
+            hash_empty_pattern(md5);
+        }
 
         md5.finalize();
         return md5.digest();
     }
+
+    void PatternHashCache::update(const Pattern& pattern, const TerrainLibrary& terrain_library)
+    {
+        auto pattern_size = pattern.size();
+
+        bool full_update = pattern_size.x != size_.x || pattern_size.y != size_.y;
+
+        const auto& terrain_hashes = terrain_library.terrain_hashes();
+        if (terrain_hashes != terrain_hashes_)
+        {
+            terrain_hashes_ = terrain_hashes;
+            full_update = true;
+        }
+
+        if (full_update)
+        {
+            size_ = pattern_size;
+            terrain_rows_.assign(pattern.row_begin(0), pattern.row_begin(0) + size_.x * size_.y);
+            hash_rows_.resize(terrain_rows_.size() * 4);
+
+            for (std::uint32_t y = 0; y != size_.y; ++y)
+            {
+                update_row(pattern, y);
+            }
+
+            return;
+        }
+
+        for (std::uint32_t y = 0; y != size_.y; ++y)
+        {
+            auto cached_row = terrain_rows_.begin() + y * size_.x;
+            if (!std::equal(pattern.row_begin(y), pattern.row_end(y), cached_row))
+            {
+                std::copy(pattern.row_begin(y), pattern.row_end(y), cached_row);
+                update_row(pattern, y);
+            }
+        }
+    }
+
+    void PatternHashCache::update_row(const Pattern& pattern, std::uint32_t row)
+    {
+        // The hash word index carries on from one row to the next.
+        std::uint32_t hash_index = static_cast<std::uint32_t>((static_cast<std::uint64_t>(row) * size_.x) % 4);
+
+        auto out = hash_rows_.data() + static_cast<std::size_t>(row) * size_.x * 4;
+        for (auto it = pattern.row_begin(row), end = pattern.row_end(row); it != end; ++it, out += 4)
+        {
+            auto word = terrain_hashes_[*it][hash_index];
+            out[0] = static_cast<std::uint8_t>(word >> 24);
+            out[1] = static_cast<std::uint8_t>(word >> 16);
+            out[2] = static_cast<std::uint8_t>(word >> 8);
+            out[3] = static_cast<std::uint8_t>(word);
+
+            hash_index = (hash_index + 1) & 3;
+        }
+    }
+
+    void PatternHashCache::clear()
+    {
+        size_ = {};
+        terrain_rows_.clear();
+        hash_rows_.clear();
+    }
+
+    core::Vector2u PatternHashCache::size() const
+    {
+        return size_;
+    }
+
+    const std::uint8_t* PatternHashCache::row_data(std::uint32_t row) const
+    {
+        return hash_rows_.data() + static_cast<std::size_t>(row) * row_data_size();
+    }
+
+    std::size_t PatternHashCache::row_data_size() const
+    {
+        return static_cast<std::size_t>(size_.x) * 4;
+    }
 }
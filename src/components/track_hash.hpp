@@ -26,7 +26,12 @@
 #ifndef TRACK_HASH_HPP
 #define TRACK_HASH_HPP
 
+#include "terrain_library.hpp"
+
+#include "core/vector2.hpp"
+
 #include <array>
+#include <vector>
 #include <cstdint>
 
 namespace components
@@ -36,8 +41,32 @@ namespace components
 
     using TrackHash = std::array<std::uint32_t, 4>;
 
+    // Keeps, for every row of a pattern, the bytes that the track hash feeds to MD5 for it.
+    // Updating it only looks up the terrain hashes of rows that changed since the last update.
+    class PatternHashCache
+    {
+    public:
+        void update(const Pattern& pattern, const TerrainLibrary& terrain_library);
+        void clear();
+
+        core::Vector2u size() const;
+        const std::uint8_t* row_data(std::uint32_t row) const;
+        std::size_t row_data_size() const;
+
+    private:
+        void update_row(const Pattern& pattern, std::uint32_t row);
+
+        core::Vector2u size_;
+        TerrainHashTable terrain_hashes_ = {};
+        std::vector<TerrainId> terrain_rows_;
+        std::vector<std::uint8_t> hash_rows_;
+    };
+
     TrackHash calculate_track_hash(const Track& track);
     TrackHash calculate_track_hash(const Track& track, const Pattern& pattern);
+
+    // Gives the same result as the above, but reads the pixels' words from the cache after updating it.
+    TrackHash calculate_track_hash(const Track& track, const Pattern& pattern, PatternHashCache& hash_cache);
 }
 
 #endif
\ No newline at end of file
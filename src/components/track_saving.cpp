@@ -36,6 +36,8 @@
 
 #include "track_hash.hpp"
 
+#include "core/md5.hpp"
+
 #include <boost/filesystem.hpp>
 
 #include <fstream>
@@ -47,9 +49,132 @@ namespace components
     {
     }
 
-    void save_track(const Track& track, const PatternStore& pattern_store)
+    namespace
     {
-        save_track(track, pattern_store, track.path());
+        // The palette goes in as well, since recoloring a terrain changes the file too.
+        PatternDigest pattern_digest(const Pattern& pattern, const TerrainPalette& palette)
+        {
+            MD5 md5;
+
+            auto pattern_size = pattern.size();
+            md5 << pattern_size.x << pattern_size.y;
+
+            for (const auto& color : palette)
+            {
+                md5 << color.red << color.green << color.blue;
+            }
+
+            for (std::uint32_t y = 0; y != pattern_size.y; ++y)
+            {
+                md5.update(pattern.row_begin(y), pattern_size.x);
+            }
+
+            md5.finalize();
+            return md5.digest();
+        }
+
+        bool file_digest(const boost::filesystem::path& path, PatternDigest& digest)
+        {
+            std::ifstream stream(path.string(), std::ifstream::in | std::ifstream::binary);
+            if (!stream) return false;
+
+            MD5 md5;
+            char buffer[4096];
+            while (stream.read(buffer, sizeof(buffer)) || stream.gcount() != 0)
+            {
+                md5.update(buffer, static_cast<MD5::size_type>(stream.gcount()));
+            }
+
+            if (stream.bad()) return false;
+
+            md5.finalize();
+            digest = md5.digest();
+            return true;
+        }
+
+        std::string pattern_file_name(const Track& track)
+        {
+            auto pattern_file = track.pattern();
+            if (pattern_file.empty())
+            {
+                pattern_file = track.name() + "-pat.png";
+            }
+
+            return pattern_file;
+        }
+
+        bool is_pattern_written(const WrittenPattern& written, const boost::filesystem::path& path, 
+            const PatternDigest& digest)
+        {
+            if (written.path != boost::filesystem::absolute(path).string() || written.pattern_digest != digest)
+            {
+                return false;
+            }
+
+            // Someone else may have replaced the file in the meantime.
+            PatternDigest current_file_digest;
+            return file_digest(path, current_file_digest) && current_file_digest == written.file_digest;
+        }
+
+        void remember_written_pattern(WrittenPattern& written, const boost::filesystem::path& path,
+            const PatternDigest& digest)
+        {
+            written = {};
+            if (!file_digest(path, written.file_digest)) return;
+
+            written.path = boost::filesystem::absolute(path).string();
+            written.pattern_digest = digest;
+        }
+
+        // Writes to a temporary file first, which then replaces the target, so that a failed save
+        // can't leave a half-written file behind.
+        template <typename WriteFunction>
+        void write_file_atomically(const boost::filesystem::path& path, WriteFunction write_function)
+        {
+            namespace bfs = boost::filesystem;
+
+            auto temp_path = path;
+            temp_path += ".tmp";
+
+            try
+            {
+                write_function(temp_path);
+                bfs::rename(temp_path, path);
+            }
+
+            catch (...)
+            {
+                boost::system::error_code error;
+                bfs::remove(temp_path, error);
+                throw;
+            }
+        }
+    }
+
+    WrittenPattern read_written_pattern(const Track& track)
+    {
+        WrittenPattern written;
+        auto path = boost::filesystem::path(track.path()).parent_path() / pattern_file_name(track);
+
+        try
+        {
+            TerrainPalette palette;
+            auto pattern = std::move(load_pattern_areas(path.string(), { core::IntRect() }, &palette).front());
+            remember_written_pattern(written, path, pattern_digest(pattern, palette));
+        }
+
+        catch (const std::exception&)
+        {
+            written = {};
+        }
+
+        return written;
+    }
+
+    void save_track(const Track& track, const PatternStore& pattern_store, const PatternSaveOptions& pattern_options,
+        PatternHashCache* hash_cache, WrittenPattern* written_pattern)
+    {
+        save_track(track, pattern_store, track.path(), pattern_options, hash_cache, written_pattern);
     }
 
     void save_tile_definitions(std::ostream& stream, std::vector<TileDefinition> tile_definitions)
@@ -100,8 +225,7 @@ namespace components
             {
                 core::Vector2i pos = sub_tile.position;
 
-                double degrees = sub_tile.rotation.normalize().degrees(core::rotation::absolute);
-                std::int32_t rotation = static_cast<std::int32_t>(std::round(degrees));
+                std::int32_t rotation = sub_tile.rotation.whole_degrees();
                 
                 if (sub_tile.level == 0)
                 {
@@ -215,23 +339,9 @@ namespace components
         }
     }
 
-    void save_track(const Track& track, const PatternStore& pattern_store, const std::string& file_name)
+    void save_track_file(std::ostream& out, const Track& track, const Pattern& pattern, const std::string& pattern_file,
+        PatternHashCache* hash_cache)
     {
-        namespace bfs = boost::filesystem;
-        bfs::path path = bfs::path(file_name).parent_path();
-        bfs::create_directories(path);
-
-        std::ofstream out(file_name);
-
-        if (!out)
-        {
-            throw SaveError(file_name);
-        }
-
-
-        PatternBuilder pattern_builder(track, pattern_store);
-        auto pattern = pattern_builder();
-
         out << "# This is a Turbo Sliders track file\n";
         out << "# Do not change the order of the following lines!\n";
         out << "# This track was saved with IziEditor.\n";
@@ -239,18 +349,14 @@ namespace components
         auto track_size = track.size();
         out << "Size td " << track.num_levels() << " " << track_size.x << " " << track_size.y << "\n";
 
-        auto track_hash = calculate_track_hash(track, pattern);
+        auto track_hash = hash_cache ? calculate_track_hash(track, pattern, *hash_cache) : 
+            calculate_track_hash(track, pattern);
         out << "Hash " << std::hex << track_hash[0] << " " << track_hash[1] << " " << 
             track_hash[2] << " " << track_hash[3] << std::dec << "\n";
 
         out << "Maker " << (track.author().empty() ? "Anonymous" : track.author()) << "\n";
         out << "FormatVersion 2\n";
 
-        auto pattern_file = track.pattern();
-        if (pattern_file.empty())
-        {
-            pattern_file = track.name() + "-pat.png";
-        }
         out << "Pattern " << pattern_file << "\n";
 
         auto track_type = track.track_type();
@@ -315,8 +421,7 @@ namespace components
                 std::int32_t x = tile.position.x;
                 std::int32_t y = tile.position.y;
 
-                double degrees = tile.rotation.normalize().degrees(core::rotation::absolute);
-                std::int32_t rotation = static_cast<std::int32_t>(std::round(degrees));
+                std::int32_t rotation = tile.rotation.whole_degrees();
 
                 if (layer->level == 0)
                 {
@@ -331,8 +436,50 @@ namespace components
         }
 
         out << "End\n";
-        
+    }
+
+    void save_track(const Track& track, const PatternStore& pattern_store, const std::string& file_name,
+        const PatternSaveOptions& pattern_options, PatternHashCache* hash_cache, WrittenPattern* written_pattern)
+    {
+        namespace bfs = boost::filesystem;
+        bfs::path path = bfs::path(file_name).parent_path();
+        bfs::create_directories(path);
+
+        PatternBuilder pattern_builder(track, pattern_store);
+        auto pattern = pattern_builder();
+
+        auto pattern_file = pattern_file_name(track);
+
+        // The pattern goes first, so that the track file never refers to a pattern that failed to save.
+        // It is only written when it would come out differently than what the file holds.
         bfs::path pattern_path = path / pattern_file;
-        save_pattern(pattern, track.terrain_library(), pattern_path.string());
+        auto digest = pattern_digest(pattern, track.terrain_library().palette());
+        if (!written_pattern || !is_pattern_written(*written_pattern, pattern_path, digest))
+        {
+            write_file_atomically(pattern_path, [&](const bfs::path& temp_path)
+            {
+                save_pattern(pattern, track.terrain_library(), temp_path.string(), pattern_options);
+            });
+
+            if (written_pattern) remember_written_pattern(*written_pattern, pattern_path, digest);
+        }
+
+        write_file_atomically(file_name, [&](const bfs::path& temp_path)
+        {
+            std::ofstream out(temp_path.string());
+
+            if (!out)
+            {
+                throw SaveError(file_name);
+            }
+
+            save_track_file(out, track, pattern, pattern_file, hash_cache);
+
+            out.close();
+            if (!out)
+            {
+                throw SaveError(file_name);
+            }
+        });
     }
-}
\ No newline at end of file
+}
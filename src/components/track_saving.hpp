@@ -26,13 +26,18 @@
 #ifndef TRACK_SAVING_HPP
 #define TRACK_SAVING_HPP
 
+#include "pattern.hpp"
+
 #include <string>
 #include <exception>
+#include <array>
+#include <cstdint>
 
 namespace components
 {
     class Track;
     class PatternStore;
+    class PatternHashCache;
 
     struct SaveError
         : std::runtime_error
@@ -40,8 +45,30 @@ namespace components
         SaveError(const std::string& file_name);
     };
 
-    void save_track(const Track& track, const PatternStore& pattern_store);
-    void save_track(const Track& track, const PatternStore& pattern_store, const std::string& file_name);
+    using PatternDigest = std::array<std::uint32_t, 4>;
+
+    // What a track's pattern file was last known to hold: the digest of the pattern and its palette,
+    // and the digest of the file's bytes, so that a file replaced by someone else is noticed.
+    struct WrittenPattern
+    {
+        std::string path;
+        PatternDigest pattern_digest = {};
+        PatternDigest file_digest = {};
+    };
+
+    // Describes the track's current pattern file, or gives an empty record if it can't be loaded.
+    WrittenPattern read_written_pattern(const Track& track);
+
+    // The hash cache, if given, lets the track hash skip the terrain lookups for unchanged rows.
+    // The written pattern, if given, lets an unchanged pattern go without being encoded again,
+    // and is updated to what the pattern file holds afterwards.
+    void save_track(const Track& track, const PatternStore& pattern_store, 
+        const PatternSaveOptions& pattern_options = {}, PatternHashCache* hash_cache = nullptr,
+        WrittenPattern* written_pattern = nullptr);
+
+    void save_track(const Track& track, const PatternStore& pattern_store, const std::string& file_name,
+        const PatternSaveOptions& pattern_options = {}, PatternHashCache* hash_cache = nullptr,
+        WrittenPattern* written_pattern = nullptr);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef CANCELLATION_HPP
+#define CANCELLATION_HPP
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace core
+{
+    struct OperationCancelled
+        : std::runtime_error
+    {
+        OperationCancelled()
+            : std::runtime_error("operation cancelled")
+        {
+        }
+    };
+
+    // Shared between whoever runs a job and whoever may want to stop it. Copies refer to the same state.
+    class CancellationToken
+    {
+    public:
+        CancellationToken()
+            : cancelled_(std::make_shared<std::atomic<bool>>(false))
+        {
+        }
+
+        void cancel()
+        {
+            cancelled_->store(true, std::memory_order_relaxed);
+        }
+
+        bool is_cancelled() const
+        {
+            return cancelled_->load(std::memory_order_relaxed);
+        }
+
+        void throw_if_cancelled() const
+        {
+            if (is_cancelled()) throw OperationCancelled();
+        }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+    };
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef INDEX_SET_HPP
+#define INDEX_SET_HPP
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
+
+namespace core
+{
+    // A set of indices, stored as sorted and disjoint half-open ranges. Large contiguous
+    // selections take up a single range.
+    class IndexSet
+    {
+    public:
+        struct Range
+        {
+            std::size_t begin;
+            std::size_t end;
+        };
+
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::size_t*;
+            using reference = std::size_t;
+
+            const_iterator() = default;
+
+            std::size_t operator*() const { return index_; }
+
+            const_iterator& operator++()
+            {
+                if (++index_ == (*ranges_)[range_index_].end && ++range_index_ != ranges_->size())
+                {
+                    index_ = (*ranges_)[range_index_].begin;
+                }
+
+                return *this;
+            }
+
+            const_iterator& operator--()
+            {
+                if (range_index_ == ranges_->size() || index_ == (*ranges_)[range_index_].begin)
+                {
+                    index_ = (*ranges_)[--range_index_].end;
+                }
+
+                --index_;
+                return *this;
+            }
+
+            const_iterator operator++(int) { auto result = *this; ++*this; return result; }
+            const_iterator operator--(int) { auto result = *this; --*this; return result; }
+
+            bool operator==(const const_iterator& other) const
+            {
+                return range_index_ == other.range_index_ && (range_index_ == ranges_->size() || index_ == other.index_);
+            }
+
+            bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+        private:
+            friend IndexSet;
+
+            const_iterator(const std::vector<Range>* ranges, std::size_t range_index)
+                : ranges_(ranges), range_index_(range_index),
+                  index_(range_index < ranges->size() ? (*ranges)[range_index].begin : 0)
+            {
+            }
+
+            const std::vector<Range>* ranges_ = nullptr;
+            std::size_t range_index_ = 0;
+            std::size_t index_ = 0;
+        };
+
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        IndexSet() = default;
+
+        IndexSet(std::size_t begin, std::size_t end)
+        {
+            insert_range(begin, end);
+        }
+
+        bool empty() const { return ranges_.empty(); }
+        std::size_t size() const { return size_; }
+        const std::vector<Range>& ranges() const { return ranges_; }
+
+        std::size_t front() const { return ranges_.front().begin; }
+        std::size_t back() const { return ranges_.back().end - 1; }
+
+        const_iterator begin() const { return const_iterator(&ranges_, 0); }
+        const_iterator end() const { return const_iterator(&ranges_, ranges_.size()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        bool contains(std::size_t index) const
+        {
+            auto it = find_range(index);
+            return it != ranges_.end() && it->begin <= index;
+        }
+
+        void clear()
+        {
+            ranges_.clear();
+            size_ = 0;
+        }
+
+        void insert(std::size_t index)
+        {
+            insert_range(index, index + 1);
+        }
+
+        void insert_range(std::size_t begin, std::size_t end)
+        {
+            if (begin >= end) return;
+
+            // Every range that overlaps or touches [begin, end) is merged into one.
+            auto first = std::lower_bound(ranges_.begin(), ranges_.end(), begin,
+                [](const Range& range, std::size_t index) { return range.end < index; });
+
+            auto last = std::upper_bound(first, ranges_.end(), end,
+                [](std::size_t index, const Range& range) { return index < range.begin; });
+
+            Range merged = { begin, end };
+            if (first != last)
+            {
+                merged.begin = std::min(begin, first->begin);
+                merged.end = std::max(end, std::prev(last)->end);
+
+                for (auto it = first; it != last; ++it) size_ -= it->end - it->begin;
+                first = ranges_.erase(first, last);
+            }
+
+            ranges_.insert(first, merged);
+            size_ += merged.end - merged.begin;
+        }
+
+        void erase(std::size_t index)
+        {
+            auto it = find_range(index);
+            if (it == ranges_.end() || it->begin > index) return;
+
+            --size_;
+            if (it->begin == index) ++it->begin;
+            else if (it->end == index + 1) --it->end;
+
+            else
+            {
+                Range tail = { index + 1, it->end };
+                it->end = index;
+                ranges_.insert(it + 1, tail);
+                return;
+            }
+
+            if (it->begin == it->end) ranges_.erase(it);
+        }
+
+        // Faster insertion for indices that are added in ascending order.
+        void push_back(std::size_t index)
+        {
+            if (!ranges_.empty() && ranges_.back().end >= index)
+            {
+                if (ranges_.back().end == index)
+                {
+                    ++ranges_.back().end;
+                    ++size_;
+                }
+
+                else insert(index);
+            }
+
+            else
+            {
+                ranges_.push_back({ index, index + 1 });
+                ++size_;
+            }
+        }
+
+        bool operator==(const IndexSet& other) const
+        {
+            return size_ == other.size_ && std::equal(ranges_.begin(), ranges_.end(), other.ranges_.begin(), other.ranges_.end(),
+                [](const Range& a, const Range& b) { return a.begin == b.begin && a.end == b.end; });
+        }
+
+        bool operator!=(const IndexSet& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        // The first range that doesn't end before index.
+        std::vector<Range>::iterator find_range(std::size_t index)
+        {
+            return std::upper_bound(ranges_.begin(), ranges_.end(), index,
+                [](std::size_t index, const Range& range) { return index < range.end; });
+        }
+
+        std::vector<Range>::const_iterator find_range(std::size_t index) const
+        {
+            return std::upper_bound(ranges_.begin(), ranges_.end(), index,
+                [](std::size_t index, const Range& range) { return index < range.end; });
+        }
+
+        std::vector<Range> ranges_;
+        std::size_t size_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef LATEST_JOB_HPP
+#define LATEST_JOB_HPP
+
+#include "cancellation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <vector>
+
+namespace core
+{
+    // Runs one background job at a time, where only the latest one started matters. Starting a job
+    // cancels the one before it, which is left to wind down on its own and whose result is dropped.
+    template <typename T>
+    class LatestJob
+    {
+    public:
+        LatestJob() = default;
+
+        LatestJob(const LatestJob&) = delete;
+        LatestJob& operator=(const LatestJob&) = delete;
+
+        ~LatestJob()
+        {
+            cancel();
+        }
+
+        // The function is called with the job's cancellation token, and should check it regularly.
+        template <typename Function>
+        void start(Function function)
+        {
+            cancel();
+
+            CancellationToken token;
+            token_ = token;
+            future_ = std::async(std::launch::async, [function, token]()
+            {
+                return function(token);
+            });
+        }
+
+        void cancel()
+        {
+            if (future_.valid())
+            {
+                token_.cancel();
+                cancelled_jobs_.push_back(std::move(future_));
+            }
+
+            discard_finished_jobs();
+        }
+
+        // Like cancel(), but also waits for every cancelled job to wind down. Needed before anything
+        // the jobs refer to can be destroyed.
+        void cancel_and_wait()
+        {
+            cancel();
+
+            for (auto& future : cancelled_jobs_) future.wait();
+            cancelled_jobs_.clear();
+        }
+
+        bool is_running() const
+        {
+            return future_.valid();
+        }
+
+        bool is_ready() const
+        {
+            return future_.valid() && future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        T get()
+        {
+            discard_finished_jobs();
+            return future_.get();
+        }
+
+    private:
+        void discard_finished_jobs()
+        {
+            auto is_finished = [](const std::future<T>& future)
+            {
+                return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            };
+
+            cancelled_jobs_.erase(std::remove_if(cancelled_jobs_.begin(), cancelled_jobs_.end(), is_finished),
+                cancelled_jobs_.end());
+        }
+
+        CancellationToken token_;
+        std::future<T> future_;
+
+        // Futures from std::async wait for their job when destroyed, so the cancelled ones are kept here until done.
+        std::vector<std::future<T>> cancelled_jobs_;
+    };
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef POLYGON_HPP
+#define POLYGON_HPP
+
+#include "vector2.hpp"
+#include "rect.hpp"
+
+#include <vector>
+#include <algorithm>
+
+namespace core
+{
+    template <typename T>
+    Rect<T> polygon_bounds(const std::vector<Vector2<T>>& polygon)
+    {
+        if (polygon.empty()) return Rect<T>();
+
+        auto min_x = polygon.front().x, max_x = min_x;
+        auto min_y = polygon.front().y, max_y = min_y;
+
+        for (const auto& point : polygon)
+        {
+            min_x = std::min(min_x, point.x);
+            min_y = std::min(min_y, point.y);
+            max_x = std::max(max_x, point.x);
+            max_y = std::max(max_y, point.y);
+        }
+
+        return Rect<T>(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+    }
+
+    // Even-odd rule, the polygon is implicitly closed.
+    template <typename T, typename U>
+    bool polygon_contains(const std::vector<Vector2<T>>& polygon, Vector2<U> point)
+    {
+        bool inside = false;
+        if (polygon.size() < 3) return inside;
+
+        for (std::size_t i = 0, j = polygon.size() - 1; i != polygon.size(); j = i++)
+        {
+            const auto& a = polygon[i];
+            const auto& b = polygon[j];
+
+            if ((a.y > point.y) != (b.y > point.y))
+            {
+                double x = a.x + static_cast<double>(point.y - a.y) * (b.x - a.x) / (b.y - a.y);
+                if (point.x < x) inside = !inside;
+            }
+        }
+
+        return inside;
+    }
+}
+
+#endif
@@ -34,18 +34,63 @@ namespace interface
     {
     }
 
+    Action::Action(std::string description, CommandTarget* target, CommandType type, std::vector<std::uint8_t> record)
+        : description_(std::move(description)),
+        target_(target),
+        type_(type),
+        record_(std::move(record))
+    {
+    }
+
     const std::string& Action::description() const
     {
         return description_;
     }
 
+    CommandTarget* Action::target() const
+    {
+        return target_;
+    }
+
+    CommandType Action::type() const
+    {
+        return type_;
+    }
+
+    const std::vector<std::uint8_t>& Action::record() const
+    {
+        return record_;
+    }
+
+    const std::function<void()>& Action::action() const
+    {
+        return action_;
+    }
+
+    const std::function<void()>& Action::undo_action() const
+    {
+        return undo_action_;
+    }
+
     void Action::execute() const
     {
-        action_();
+        if (type_ == CommandType::Closure) action_();
+
+        else
+        {
+            CommandReader reader(record_.data(), record_.size());
+            target_->execute_command(type_, reader);
+        }
     }
 
     void Action::undo() const
     {
-        undo_action_();
+        if (type_ == CommandType::Closure) undo_action_();
+
+        else
+        {
+            CommandReader reader(record_.data(), record_.size());
+            target_->undo_command(type_, reader);
+        }
     }
 };
\ No newline at end of file
@@ -23,7 +23,12 @@
 * SOFTWARE.
 */
 
+#include "command.hpp"
+
 #include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
 
 namespace interface
 {
@@ -32,16 +37,28 @@ namespace interface
     public:
         Action() = default;
         Action(std::string description, std::function<void()> action, std::function<void()> undo_action);
+        Action(std::string description, CommandTarget* target, CommandType type, std::vector<std::uint8_t> record);
 
         void execute() const;
         void undo() const;
 
         const std::string& description() const;
 
+        CommandTarget* target() const;
+        CommandType type() const;
+        const std::vector<std::uint8_t>& record() const;
+
+        const std::function<void()>& action() const;
+        const std::function<void()>& undo_action() const;
+
     private:
         std::string description_;
 
+        CommandTarget* target_ = nullptr;
+        CommandType type_ = CommandType::Closure;
+        std::vector<std::uint8_t> record_;
+
         std::function<void()> action_;
         std::function<void()> undo_action_;
     };
-}
\ No newline at end of file
+}
@@ -24,8 +24,10 @@
 */
 
 #include "action_history_list.hpp"
+#include "action_journal.hpp"
 
 #include <memory>
+#include <algorithm>
 
 namespace interface
 {
@@ -34,19 +36,103 @@ namespace interface
     {
     }
 
-    void ActionHistoryList::set_max_stack_size(std::size_t max_size)
+    namespace
     {
-        max_stack_size_ = max_size;
+        // Rough heap cost of a pair of std::function objects and whatever they captured.
+        const std::size_t closure_memory_estimate = 256;
+    }
+
+    std::size_t ActionHistoryList::memory_budget() const
+    {
+        return memory_budget_;
+    }
+
+    std::size_t ActionHistoryList::memory_usage() const
+    {
+        return memory_usage_;
+    }
+
+    std::size_t ActionHistoryList::entry_cost(const Entry& entry) const
+    {
+        std::size_t cost = sizeof(Entry) + entry.record_size;
+        if (entry.closures) cost += closure_memory_estimate;
+
+        return cost;
+    }
+
+    void ActionHistoryList::execute_entry(const Entry& entry)
+    {
+        if (entry.closures) entry.closures->first();
+
+        else
+        {
+            CommandReader reader(arena_.data() + entry.record_offset, entry.record_size);
+            entry.target->execute_command(entry.type, reader);
+        }
+    }
+
+    void ActionHistoryList::undo_entry(const Entry& entry)
+    {
+        if (entry.closures) entry.closures->second();
+
+        else
+        {
+            CommandReader reader(arena_.data() + entry.record_offset, entry.record_size);
+            entry.target->undo_command(entry.type, reader);
+        }
+    }
+
+    void ActionHistoryList::release_entry(const Entry& entry)
+    {
+        if (entry.closures) return;
 
-        while (actions_.size() > max_size)
+        CommandReader reader(arena_.data() + entry.record_offset, entry.record_size);
+        entry.target->release_command(entry.type, reader);
+    }
+
+    void ActionHistoryList::truncate_entries(std::size_t entry_count)
+    {
+        while (entries_.size() > entry_count)
         {
-            actions_.pop_front();
+            const auto& entry = entries_.back();
+            release_entry(entry);
+
+            memory_usage_ -= entry_cost(entry);
+            arena_.resize(entry.record_offset);
+
+            entries_.pop_back();
         }
     }
 
-    std::size_t ActionHistoryList::max_stack_size() const
+    void ActionHistoryList::enforce_memory_budget()
     {
-        return max_stack_size_;
+        // Actions that haven't been performed can't be dropped, the ones after them depend on them.
+        std::size_t removed_count = 0;
+        while (removed_count < current_index_ && entries_.size() > 1 && memory_usage_ > memory_budget_)
+        {
+            release_entry(entries_.front());
+
+            memory_usage_ -= entry_cost(entries_.front());
+            entries_.pop_front();
+            ++removed_count;
+        }
+
+        if (removed_count == 0) return;
+
+        model()->removeRows(0, static_cast<int>(removed_count));
+        current_index_ -= removed_count;
+
+        arena_start_ = entries_.front().record_offset;
+        if (arena_start_ > arena_.size() / 2)
+        {
+            arena_.erase(arena_.begin(), arena_.begin() + arena_start_);
+            for (auto& entry : entries_)
+            {
+                entry.record_offset -= arena_start_;
+            }
+
+            arena_start_ = 0;
+        }
     }
 
     void ActionHistoryList::selectionChanged(const QItemSelection& selected, const QItemSelection& deselected)
@@ -56,22 +142,28 @@ namespace interface
 
         auto selection = selectedIndexes();
         int row_count = model()->rowCount();
+        auto old_index = current_index_;
 
         if (selection.size() == 1)
         {
             QModelIndex model_index = selection.front();
             std::size_t index = model_index.row() + 1;
 
+            bool batched = std::max(index, current_index_) - std::min(index, current_index_) > 1;
+            if (batched) history_jump_started();
+
             while (current_index_ < index)
             {
-                actions_[current_index_++].execute();
+                execute_entry(entries_[current_index_++]);
             }
 
             while (current_index_ > index)
             {
-                actions_[--current_index_].undo();
+                undo_entry(entries_[--current_index_]);
             }
 
+            if (batched) history_jump_finished();
+
             if (auto item = itemFromIndex(model_index))
             {
                 scrollToItem(item);
@@ -80,13 +172,31 @@ namespace interface
 
         else if (selection.size() == 0)
         {
+            bool batched = current_index_ > 1;
+            if (batched) history_jump_started();
+
             while (current_index_ != 0)
             {
-                actions_[--current_index_].undo();
+                undo_entry(entries_[--current_index_]);
             }
+
+            if (batched) history_jump_finished();
         }
 
-        if (current_index_ == actions_.size()) disable_redo();
+        if (journal_)
+        {
+            journal_->append_history_move(static_cast<std::int64_t>(current_index_) - 
+                static_cast<std::int64_t>(old_index));
+        }
+
+        update_history_state();
+
+        QListWidget::selectionChanged(selected, deselected);
+    }
+
+    void ActionHistoryList::update_history_state()
+    {
+        if (current_index_ == entries_.size()) disable_redo();
         else enable_redo();
 
         if (current_index_ == 0) disable_undo();
@@ -107,8 +217,6 @@ namespace interface
                 item->setTextColor(QColor(0, 0, 0, 100));
             }
         }
-
-        QListWidget::selectionChanged(selected, deselected);
     }
 
     void ActionHistoryList::push_action(const Action& action)
@@ -122,19 +230,17 @@ namespace interface
 
             std::unique_ptr<bool, decltype(update_guard_deleter)> update_guard(&is_updating_);
 
-            model()->removeRows(current_index_, actions_.size() - current_index_);
+            model()->removeRows(current_index_, entries_.size() - current_index_);
             addItem(QString::fromStdString(action.description()));
 
-            actions_.resize(current_index_);
-            actions_.push_back(action);
+            truncate_entries(current_index_);
+            append_entry(action);
 
-            if (actions_.size() > max_stack_size_)
-            {
-                model()->removeRows(0, 1);
-                actions_.pop_front();
-            }
+            if (journal_) journal_->append_action(action);
+
+            enforce_memory_budget();
 
-            current_index_ = actions_.size();
+            current_index_ = entries_.size();
         }
 
         selectionModel()->select(model()->index(current_index_ - 1, 0), QItemSelectionModel::ClearAndSelect);
@@ -149,6 +255,87 @@ namespace interface
         // If selection index == size() - 1 -> undo nothing
     }
 
+    void ActionHistoryList::append_entry(const Action& action)
+    {
+        Entry entry;
+        entry.target = action.target();
+        entry.type = action.type();
+        entry.record_offset = arena_.size();
+        entry.record_size = action.record().size();
+
+        if (action.type() == CommandType::Closure)
+        {
+            entry.closures = std::make_unique<std::pair<std::function<void()>, std::function<void()>>>(
+                action.action(), action.undo_action());
+        }
+
+        arena_.insert(arena_.end(), action.record().begin(), action.record().end());
+
+        memory_usage_ += entry_cost(entry);
+        entries_.push_back(std::move(entry));
+    }
+
+    void ActionHistoryList::restore(const std::vector<Action>& actions, std::size_t history_index)
+    {
+        clear();
+
+        history_index = std::min(history_index, actions.size());
+
+        {
+            is_updating_ = true;
+            auto update_guard_deleter = [](bool* is_updating)
+            {
+                *is_updating = false;
+            };
+
+            std::unique_ptr<bool, decltype(update_guard_deleter)> update_guard(&is_updating_);
+
+            // Add everything in one go, selecting items one by one is quadratic.
+            QStringList descriptions;
+            for (const auto& action : actions)
+            {
+                descriptions.append(QString::fromStdString(action.description()));
+                append_entry(action);
+            }
+
+            addItems(descriptions);
+
+            current_index_ = history_index;
+            enforce_memory_budget();
+        }
+
+        if (current_index_ != 0)
+        {
+            selectionModel()->select(model()->index(current_index_ - 1, 0), QItemSelectionModel::ClearAndSelect);
+        }
+
+        else
+        {
+            update_history_state();
+        }
+    }
+
+    void ActionHistoryList::set_journal(ActionJournal* journal)
+    {
+        journal_ = journal;
+    }
+
+    void ActionHistoryList::write_to_journal() const
+    {
+        if (!journal_) return;
+
+        for (std::size_t index = 0; index != entries_.size(); ++index)
+        {
+            const auto& entry = entries_[index];
+            auto description = item(static_cast<int>(index))->text().toStdString();
+
+            journal_->append_action(description, entry.type, arena_.data() + entry.record_offset, entry.record_size);
+        }
+
+        journal_->append_history_move(static_cast<std::int64_t>(current_index_) - 
+            static_cast<std::int64_t>(entries_.size()));
+    }
+
     void ActionHistoryList::undo(std::size_t num_actions)
     {
         if (current_index_ > num_actions)
@@ -167,7 +354,7 @@ namespace interface
     void ActionHistoryList::redo(std::size_t num_actions)
     {
         num_actions = std::max<std::size_t>(num_actions, 1);
-        std::size_t row_index = std::min(current_index_ + num_actions, actions_.size()) - 1;
+        std::size_t row_index = std::min(current_index_ + num_actions, entries_.size()) - 1;
 
         auto model_index = model()->index(row_index, 0);
         selectionModel()->select(model_index, QItemSelectionModel::ClearAndSelect);
@@ -177,7 +364,16 @@ namespace interface
     {
         model()->removeRows(0, model()->rowCount());
 
-        actions_.clear();
+        for (const auto& entry : entries_)
+        {
+            release_entry(entry);
+        }
+
+        entries_.clear();
+        arena_.clear();
+        arena_start_ = 0;
+        memory_usage_ = 0;
+        current_index_ = 0;
     }
 
     bool ActionHistoryList::has_performed_any_actions() const
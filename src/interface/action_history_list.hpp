@@ -32,9 +32,14 @@
 
 #include <functional>
 #include <deque>
+#include <vector>
+#include <memory>
+#include <cstdint>
 
 namespace interface
 {
+    class ActionJournal;
+
     class ActionHistoryList
         : public QListWidget
     {
@@ -43,11 +48,23 @@ namespace interface
     public:
         ActionHistoryList(QWidget* parent);
 
-        void set_max_stack_size(std::size_t max_size);
-        std::size_t max_stack_size() const;
+        // The history is limited by the memory its records use rather than by a number of steps.
+        // Only performed actions are dropped to stay within it, the most recent one is always kept.
+        std::size_t memory_budget() const;
+        std::size_t memory_usage() const;
 
         bool has_performed_any_actions() const;
 
+        // Every change to the history is mirrored to the journal, if one is set.
+        void set_journal(ActionJournal* journal);
+
+        // Writes the whole history and the current position in it to the journal.
+        void write_to_journal() const;
+
+        // Replaces the history with actions of which the first history_index have been performed.
+        // This is not journaled, the actions are expected to come from the journal.
+        void restore(const std::vector<Action>& actions, std::size_t history_index);
+
     public slots:
         void undo(std::size_t num_actions = 1);
         void redo(std::size_t num_actions = 1);
@@ -61,14 +78,46 @@ namespace interface
 
         void enable_redo();
         void disable_redo();
-        
+
+        // Emitted around jumps of more than one step, so that the scene can batch its updates.
+        void history_jump_started();
+        void history_jump_finished();
 
     private:
         virtual void selectionChanged(const QItemSelection&, const QItemSelection&) override;
 
+        struct Entry
+        {
+            CommandTarget* target = nullptr;
+            CommandType type = CommandType::Closure;
+            std::size_t record_offset = 0;
+            std::size_t record_size = 0;
+
+            std::unique_ptr<std::pair<std::function<void()>, std::function<void()>>> closures;
+        };
+
+        void append_entry(const Action& action);
+        void update_history_state();
+
+        void execute_entry(const Entry& entry);
+        void undo_entry(const Entry& entry);
+        void release_entry(const Entry& entry);
+
+        std::size_t entry_cost(const Entry& entry) const;
+        void enforce_memory_budget();
+        void truncate_entries(std::size_t entry_count);
+
         std::size_t current_index_ = 0;
-        std::size_t max_stack_size_ = 50;
-        std::deque<Action> actions_;
+        std::size_t memory_budget_ = 4 * 1024 * 1024;
+        std::size_t memory_usage_ = 0;
+
+        // All records live in one arena, in the same order as the entries. Entries that
+        // fall off the front of the history leave a gap that's reclaimed periodically.
+        std::deque<Entry> entries_;
+        std::vector<std::uint8_t> arena_;
+        std::size_t arena_start_ = 0;
+
+        ActionJournal* journal_ = nullptr;
 
         bool is_updating_ = false;
     };
@@ -0,0 +1,523 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "action_journal.hpp"
+#include "action.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace interface
+{
+    namespace
+    {
+        const std::uint32_t journal_magic = 0x334A5A49; // "IZJ3"
+
+        enum class RecordKind
+            : std::uint8_t
+        {
+            Action,
+            HistoryMove,
+            SavePoint
+        };
+
+        bool sync_file(std::FILE* file)
+        {
+            if (std::fflush(file) != 0) return false;
+
+#ifdef _WIN32
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+
+        bool truncate_file(std::FILE* file, std::uint64_t size)
+        {
+            std::fflush(file);
+
+#ifdef _WIN32
+            return _chsize_s(_fileno(file), static_cast<__int64>(size)) == 0;
+#else
+            return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+        }
+
+        std::vector<std::uint8_t> journal_header(const std::string& track_path)
+        {
+            std::vector<std::uint8_t> header;
+            CommandWriter writer(header);
+            writer.write(journal_magic);
+            writer.write(track_path);
+            return header;
+        }
+
+        void write_record(std::vector<std::uint8_t>& buffer, const std::vector<std::uint8_t>& payload)
+        {
+            CommandWriter writer(buffer);
+            writer.write(static_cast<std::uint32_t>(payload.size()));
+            buffer.insert(buffer.end(), payload.begin(), payload.end());
+        }
+
+        std::vector<std::uint8_t> action_payload(const std::string& description, CommandType type,
+            const std::uint8_t* record, std::size_t record_size)
+        {
+            std::vector<std::uint8_t> payload;
+            payload.reserve(record_size + description.size() + 8);
+
+            CommandWriter writer(payload);
+            writer.write(RecordKind::Action);
+            writer.write(type);
+            writer.write(description);
+            payload.insert(payload.end(), record, record + record_size);
+            return payload;
+        }
+
+        std::vector<std::uint8_t> history_move_payload(std::int64_t offset)
+        {
+            std::vector<std::uint8_t> payload;
+            CommandWriter writer(payload);
+            writer.write(RecordKind::HistoryMove);
+            writer.write(offset);
+            return payload;
+        }
+
+        std::vector<std::uint8_t> save_point_payload()
+        {
+            std::vector<std::uint8_t> payload;
+            CommandWriter(payload).write(RecordKind::SavePoint);
+            return payload;
+        }
+
+        // A journal that reads back as the given contents. The actions that were undone past
+        // the save point come after the ones before it, followed by the save point itself and
+        // a move back, which is how they came about in the first place.
+        std::vector<std::uint8_t> journal_image(const JournalContents& contents)
+        {
+            auto image = journal_header(contents.track_path);
+            auto write_entry = [&image](const JournalEntry& entry)
+            {
+                write_record(image, action_payload(entry.description, entry.type, entry.record.data(), entry.record.size()));
+            };
+
+            const auto& entries = contents.entries;
+            auto saved_index = std::min(contents.saved_index, entries.size());
+
+            std::for_each(entries.begin(), entries.begin() + saved_index, write_entry);
+            std::for_each(contents.unwind_entries.begin(), contents.unwind_entries.end(), write_entry);
+            write_record(image, save_point_payload());
+
+            std::size_t index = saved_index;
+            if (!contents.unwind_entries.empty())
+            {
+                write_record(image, history_move_payload(-static_cast<std::int64_t>(contents.unwind_entries.size())));
+            }
+
+            if (saved_index != entries.size())
+            {
+                std::for_each(entries.begin() + saved_index, entries.end(), write_entry);
+                index = entries.size();
+            }
+
+            auto offset = static_cast<std::int64_t>(contents.history_index) - static_cast<std::int64_t>(index);
+            if (offset != 0) write_record(image, history_move_payload(offset));
+
+            return image;
+        }
+    }
+
+    JournalContents read_action_journal(const std::string& file_path)
+    {
+        JournalContents contents;
+
+        std::ifstream stream(file_path, std::ios::in | std::ios::binary);
+        if (!stream) return contents;
+
+        std::vector<std::uint8_t> data(std::istreambuf_iterator<char>(stream), {});
+        CommandReader reader(data.data(), data.size());
+
+        try
+        {
+            if (reader.read<std::uint32_t>() != journal_magic) return contents;
+
+            contents.track_path = reader.read_string();
+            contents.intact_size = reader.position();
+        }
+
+        catch (const CommandFormatError&)
+        {
+            return JournalContents();
+        }
+
+        auto& entries = contents.entries;
+        auto& unwind_entries = contents.unwind_entries;
+        auto& index = contents.history_index;
+        auto& saved_index = contents.saved_index;
+
+        try
+        {
+            while (!reader.at_end())
+            {
+                auto record_size = reader.read<std::uint32_t>();
+                auto record_start = reader.position();
+
+                // A crash may have cut the last record short.
+                if (data.size() - record_start < record_size) break;
+
+                reader.seek(record_start + record_size);
+
+                CommandReader record_reader(data.data() + record_start, record_size);
+                auto kind = static_cast<RecordKind>(record_reader.read<std::uint8_t>());
+
+                if (kind == RecordKind::Action)
+                {
+                    JournalEntry entry;
+                    entry.type = static_cast<CommandType>(record_reader.read<std::uint8_t>());
+                    entry.description = record_reader.read_string();
+
+                    auto command_start = data.begin() + record_start + record_reader.position();
+                    entry.record.assign(command_start, data.begin() + record_start + record_size);
+
+                    // Discarding actions that are part of the saved track means they have to be 
+                    // undone before anything else can be replayed.
+                    if (index < saved_index)
+                    {
+                        unwind_entries.insert(unwind_entries.begin(), 
+                            std::make_move_iterator(entries.begin() + index), 
+                            std::make_move_iterator(entries.begin() + saved_index));
+
+                        saved_index = index;
+                    }
+
+                    entries.resize(index);
+                    entries.push_back(std::move(entry));
+                    index = entries.size();
+                }
+
+                else if (kind == RecordKind::HistoryMove)
+                {
+                    auto offset = record_reader.read<std::int64_t>();
+                    auto new_index = static_cast<std::int64_t>(index) + offset;
+
+                    index = static_cast<std::size_t>(std::max<std::int64_t>(new_index, 0));
+                    index = std::min(index, entries.size());
+                }
+
+                else if (kind == RecordKind::SavePoint)
+                {
+                    saved_index = index;
+                    unwind_entries.clear();
+                }
+
+                else break;
+
+                contents.intact_size = reader.position();
+            }
+        }
+
+        catch (const CommandFormatError&)
+        {
+        }
+
+        auto is_closure = [](const JournalEntry& entry) { return entry.type == CommandType::Closure; };
+
+        // There's no getting from the saved track to any state in the history if one of the
+        // actions that needs undoing can't be replayed.
+        if (std::any_of(unwind_entries.begin(), unwind_entries.end(), is_closure))
+        {
+            contents.entries.clear();
+            contents.unwind_entries.clear();
+            contents.history_index = 0;
+            contents.saved_index = 0;
+            return contents;
+        }
+
+        auto low_index = std::min(index, saved_index);
+        auto first = entries.begin(), low = first + low_index;
+
+        // Everything up to the last unreplayable action before the common part of the history is
+        // dropped, it can be neither undone nor redone.
+        auto last_closure = std::find_if(std::make_reverse_iterator(low), std::make_reverse_iterator(first), is_closure);
+        if (last_closure.base() != first)
+        {
+            std::size_t dropped_count = last_closure.base() - first;
+            entries.erase(first, last_closure.base());
+
+            index -= dropped_count;
+            saved_index -= dropped_count;
+        }
+
+        contents.journal_index = index;
+        
+        // Get as close to the final state as possible without passing an unreplayable action.
+        if (index > saved_index)
+        {
+            auto closure = std::find_if(entries.begin() + saved_index, entries.begin() + index, is_closure);
+            index = closure - entries.begin();
+        }
+
+        else
+        {
+            auto closure = std::find_if(std::make_reverse_iterator(entries.begin() + saved_index),
+                std::make_reverse_iterator(entries.begin() + index), is_closure);
+
+            index = closure.base() - entries.begin();
+        }
+
+        auto tail = std::find_if(entries.begin() + std::min(index, saved_index), entries.end(), is_closure);
+        entries.erase(tail, entries.end());
+
+        return contents;
+    }
+
+    ActionJournal::ActionJournal(std::string file_path)
+        : file_path_(std::move(file_path))
+    {
+        writer_ = std::thread([this]() { write_loop(); });
+    }
+
+    ActionJournal::~ActionJournal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+
+        condition_.notify_one();
+        writer_.join();
+    }
+
+    void ActionJournal::reset(const std::string& track_path)
+    {
+        auto header = journal_header(track_path);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ = std::move(header);
+            file_request_ = FileRequest::Truncate;
+        }
+
+        is_active_ = true;
+        condition_.notify_one();
+    }
+
+    void ActionJournal::resume(const JournalContents& contents)
+    {
+        std::vector<std::uint8_t> records;
+        auto offset = static_cast<std::int64_t>(contents.history_index) - static_cast<std::int64_t>(contents.journal_index);
+        if (offset != 0) write_record(records, history_move_payload(offset));
+
+        auto image = journal_image(contents);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.clear();
+            file_request_ = FileRequest::Resume;
+            resume_size_ = contents.intact_size;
+            resume_records_ = std::move(records);
+            resume_image_ = std::move(image);
+        }
+
+        is_active_ = true;
+        condition_.notify_one();
+    }
+
+    void ActionJournal::discard()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.clear();
+            file_request_ = FileRequest::Remove;
+        }
+
+        is_active_ = false;
+        condition_.notify_one();
+    }
+
+    bool ActionJournal::is_active() const
+    {
+        return is_active_;
+    }
+
+    bool ActionJournal::has_failed() const
+    {
+        return failed_;
+    }
+
+    void ActionJournal::append_action(const Action& action)
+    {
+        append_action(action.description(), action.type(), action.record().data(), action.record().size());
+    }
+
+    void ActionJournal::append_action(const std::string& description, CommandType type,
+        const std::uint8_t* record, std::size_t record_size)
+    {
+        if (!is_active_) return;
+
+        append_record(action_payload(description, type, record, record_size));
+    }
+
+    void ActionJournal::append_history_move(std::int64_t offset)
+    {
+        if (!is_active_ || offset == 0) return;
+
+        append_record(history_move_payload(offset));
+    }
+
+    void ActionJournal::mark_saved()
+    {
+        if (!is_active_) return;
+
+        append_record(save_point_payload());
+    }
+
+    void ActionJournal::append_record(const std::vector<std::uint8_t>& payload)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            write_record(pending_, payload);
+        }
+
+        condition_.notify_one();
+    }
+
+    void ActionJournal::write_loop()
+    {
+        using clock = std::chrono::steady_clock;
+
+        std::vector<std::uint8_t> buffer;
+        std::vector<std::uint8_t> resume_records;
+        std::vector<std::uint8_t> resume_image;
+        auto last_sync = clock::now();
+        bool unsynced = false;
+
+        auto fail = [&]()
+        {
+            if (file_) std::fclose(file_);
+            file_ = nullptr;
+            unsynced = false;
+            failed_ = true;
+        };
+
+        auto write_bytes = [&](const std::vector<std::uint8_t>& bytes)
+        {
+            if (!file_ || bytes.empty()) return;
+
+            if (std::fwrite(bytes.data(), 1, bytes.size(), file_) != bytes.size()) fail();
+            else unsynced = true;
+        };
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            condition_.wait_for(lock, sync_interval_, [this]()
+            {
+                return stop_ || file_request_ != FileRequest::None || !pending_.empty();
+            });
+
+            auto request = file_request_;
+            auto resume_size = resume_size_;
+            file_request_ = FileRequest::None;
+            buffer.swap(pending_);
+            resume_records.swap(resume_records_);
+            resume_image.swap(resume_image_);
+            bool stop = stop_;
+
+            lock.unlock();
+
+            if (request != FileRequest::None && file_)
+            {
+                std::fclose(file_);
+                file_ = nullptr;
+                unsynced = false;
+            }
+
+            if (request != FileRequest::None) failed_ = false;
+
+            if (request == FileRequest::Remove)
+            {
+                std::remove(file_path_.c_str());
+            }
+
+            else if (request == FileRequest::Truncate)
+            {
+                file_ = std::fopen(file_path_.c_str(), "wb");
+                if (!file_) fail();
+            }
+
+            else if (request == FileRequest::Resume)
+            {
+                // Cut the damaged tail off in place, so that the intact records are on disk at all times.
+                file_ = std::fopen(file_path_.c_str(), "r+b");
+                if (file_ && truncate_file(file_, resume_size) && std::fseek(file_, 0, SEEK_END) == 0)
+                {
+                    unsynced = true;
+                    write_bytes(resume_records);
+                }
+
+                // The file is gone or can't be cut, so it's started over with the recovered history.
+                else
+                {
+                    if (file_) std::fclose(file_);
+
+                    file_ = std::fopen(file_path_.c_str(), "wb");
+                    if (file_) write_bytes(resume_image);
+                    else fail();
+                }
+            }
+
+            resume_records.clear();
+            resume_image.clear();
+
+            write_bytes(buffer);
+            buffer.clear();
+
+            auto now = clock::now();
+            if (file_ && unsynced && (stop || now - last_sync >= sync_interval_))
+            {
+                if (sync_file(file_)) unsynced = false;
+                else fail();
+
+                last_sync = now;
+            }
+
+            lock.lock();
+            if (stop && pending_.empty() && file_request_ == FileRequest::None) break;
+        }
+
+        if (file_)
+        {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+}
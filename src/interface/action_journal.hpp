@@ -0,0 +1,143 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef ACTION_JOURNAL_HPP
+#define ACTION_JOURNAL_HPP
+
+#include "command.hpp"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+namespace interface
+{
+    class Action;
+
+    struct JournalEntry
+    {
+        std::string description;
+        CommandType type = CommandType::Closure;
+        std::vector<std::uint8_t> record;
+    };
+
+    struct JournalContents
+    {
+        std::string track_path;
+
+        // The history as it was, the saved track corresponds to saved_index. Actions that were discarded
+        // from the history after saving, but whose effects are in the saved track, are in unwind_entries.
+        std::vector<JournalEntry> entries;
+        std::vector<JournalEntry> unwind_entries;
+        std::size_t saved_index = 0;
+        std::size_t history_index = 0;
+
+        // The journal's own idea of the history index, which differs from history_index if the
+        // history had to be cut short. Also the size of the part of the file that is intact.
+        std::size_t journal_index = 0;
+        std::size_t intact_size = 0;
+    };
+
+    // Reads back a journal left behind by a previous session. Actions that could not be journaled are
+    // cut out of the history, along with everything that depends on them.
+    JournalContents read_action_journal(const std::string& file_path);
+
+    // Append-only log of the editor's history since the track was last saved. Records are handed to
+    // a background thread that writes them out and syncs the file periodically, so that the UI thread
+    // never waits for the disk.
+    class ActionJournal
+    {
+    public:
+        explicit ActionJournal(std::string file_path);
+        ~ActionJournal();
+
+        ActionJournal(const ActionJournal&) = delete;
+        ActionJournal& operator=(const ActionJournal&) = delete;
+
+        // Starts a new journal for the track at the given path, throwing away the previous one.
+        void reset(const std::string& track_path);
+
+        // Continues the journal the contents were read from, dropping whatever follows its intact part,
+        // and moves to the recovered history index. If the file can't be continued, the recovered
+        // history is written to a new journal instead.
+        void resume(const JournalContents& contents);
+
+        // Removes the journal file. Nothing is recorded until the next reset.
+        void discard();
+
+        bool is_active() const;
+
+        // Whether the journal file could not be opened or written to. Nothing more is recorded
+        // until the next reset.
+        bool has_failed() const;
+
+        void append_action(const Action& action);
+        void append_action(const std::string& description, CommandType type,
+            const std::uint8_t* record, std::size_t record_size);
+
+        void append_history_move(std::int64_t offset);
+
+        // The track was saved at the current history index.
+        void mark_saved();
+
+    private:
+        void append_record(const std::vector<std::uint8_t>& payload);
+        void write_loop();
+
+        enum class FileRequest
+        {
+            None,
+            Truncate,
+            Resume,
+            Remove
+        };
+
+        std::string file_path_;
+        bool is_active_ = false;
+
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        std::vector<std::uint8_t> pending_;
+        FileRequest file_request_ = FileRequest::None;
+        std::size_t resume_size_ = 0;
+        std::vector<std::uint8_t> resume_records_;
+        std::vector<std::uint8_t> resume_image_;
+        bool stop_ = false;
+
+        std::FILE* file_ = nullptr;
+        std::atomic<bool> failed_{ false };
+        std::chrono::milliseconds sync_interval_ = std::chrono::milliseconds(1000);
+
+        std::thread writer_;
+    };
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "command.hpp"
+
+namespace interface
+{
+    CommandFormatError::CommandFormatError()
+        : std::runtime_error("malformed command record")
+    {
+    }
+
+    CommandWriter::CommandWriter(std::vector<std::uint8_t>& buffer)
+        : buffer_(buffer)
+    {
+    }
+
+    std::size_t CommandWriter::size() const
+    {
+        return buffer_.size();
+    }
+
+    void CommandWriter::write(const std::string& string)
+    {
+        write(static_cast<std::uint32_t>(string.size()));
+        buffer_.insert(buffer_.end(), string.begin(), string.end());
+    }
+
+    void CommandWriter::write(const components::Tile& tile)
+    {
+        write(tile.id);
+        write(tile.position.x);
+        write(tile.position.y);
+        write(static_cast<std::int16_t>(tile.rotation.whole_degrees()));
+    }
+
+    void CommandWriter::write(const components::ControlPoint& point)
+    {
+        write(point.id);
+        write(point.start.x);
+        write(point.start.y);
+        write(point.length);
+        write(static_cast<std::uint8_t>(point.direction));
+    }
+
+    void CommandWriter::write(const components::StartPoint& point)
+    {
+        write(point.position.x);
+        write(point.position.y);
+        write(point.rotation);
+        write(point.level);
+    }
+
+    CommandReader::CommandReader(const std::uint8_t* data, std::size_t size)
+        : data_(data),
+          size_(size)
+    {
+    }
+
+    std::string CommandReader::read_string()
+    {
+        auto length = read<std::uint32_t>();
+        if (size_ - position_ < length) throw CommandFormatError();
+
+        std::string result(reinterpret_cast<const char*>(data_ + position_), length);
+        position_ += length;
+        return result;
+    }
+
+    components::Tile CommandReader::read_tile()
+    {
+        components::Tile tile;
+        tile.id = read<components::TileId>();
+        tile.position.x = read<std::int32_t>();
+        tile.position.y = read<std::int32_t>();
+        tile.rotation = components::convert_rotation(read<std::int16_t>());
+        return tile;
+    }
+
+    components::ControlPoint CommandReader::read_control_point()
+    {
+        components::ControlPoint point;
+        point.id = read<std::uint32_t>();
+        point.start.x = read<std::int32_t>();
+        point.start.y = read<std::int32_t>();
+        point.length = read<std::int32_t>();
+        point.direction = static_cast<components::ControlPoint::Direction>(read<std::uint8_t>());
+        return point;
+    }
+
+    components::StartPoint CommandReader::read_start_point()
+    {
+        components::StartPoint point;
+        point.position.x = read<std::int32_t>();
+        point.position.y = read<std::int32_t>();
+        point.rotation = read<std::int32_t>();
+        point.level = read<std::uint32_t>();
+        return point;
+    }
+
+    std::size_t CommandReader::position() const
+    {
+        return position_;
+    }
+
+    void CommandReader::seek(std::size_t position)
+    {
+        if (position > size_) throw CommandFormatError();
+
+        position_ = position;
+    }
+
+    bool CommandReader::at_end() const
+    {
+        return position_ == size_;
+    }
+}
@@ -0,0 +1,121 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef COMMAND_HPP
+#define COMMAND_HPP
+
+#include "components/tile_definition.hpp"
+#include "components/control_point.hpp"
+#include "components/start_point.hpp"
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+namespace interface
+{
+    // Undo steps are stored as compact records rather than as closures. The record's type
+    // tells its target how to interpret the bytes.
+    enum class CommandType
+        : std::uint8_t
+    {
+        Closure,
+        TileEdit,
+        ControlPointEdit,
+        LayerEdit,
+        StartPointEdit,
+        PitEdit,
+        AreaSelection,
+        TrackEdit
+    };
+
+    struct CommandFormatError
+        : public std::runtime_error
+    {
+        CommandFormatError();
+    };
+
+    class CommandWriter
+    {
+    public:
+        explicit CommandWriter(std::vector<std::uint8_t>& buffer);
+
+        template <typename T>
+        void write(T value);
+
+        void write(const std::string& string);
+        void write(const components::Tile& tile);
+        void write(const components::ControlPoint& point);
+        void write(const components::StartPoint& point);
+
+        std::size_t size() const;
+
+    private:
+        std::vector<std::uint8_t>& buffer_;
+    };
+
+    class CommandReader
+    {
+    public:
+        CommandReader(const std::uint8_t* data, std::size_t size);
+
+        template <typename T>
+        T read();
+
+        std::string read_string();
+        components::Tile read_tile();
+        components::ControlPoint read_control_point();
+        components::StartPoint read_start_point();
+
+        std::size_t position() const;
+        void seek(std::size_t position);
+
+        bool at_end() const;
+
+    private:
+        const std::uint8_t* data_;
+        std::size_t size_;
+        std::size_t position_ = 0;
+    };
+
+    class CommandTarget
+    {
+    public:
+        virtual void execute_command(CommandType type, CommandReader& reader) = 0;
+        virtual void undo_command(CommandType type, CommandReader& reader) = 0;
+
+        // Called when a record is dropped from the history and won't be executed again.
+        virtual void release_command(CommandType type, CommandReader& reader) {}
+
+    protected:
+        ~CommandTarget() = default;
+    };
+}
+
+#include "command.inl"
+
+#endif
@@ -0,0 +1,59 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef COMMAND_INL
+#define COMMAND_INL
+
+#include "command.hpp"
+
+#include <type_traits>
+#include <cstring>
+
+namespace interface
+{
+    template <typename T>
+    void CommandWriter::write(T value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "record fields must be trivially copyable");
+
+        auto bytes = reinterpret_cast<const std::uint8_t*>(&value);
+        buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    T CommandReader::read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "record fields must be trivially copyable");
+
+        if (size_ - position_ < sizeof(T)) throw CommandFormatError();
+
+        T result;
+        std::memcpy(&result, data_ + position_, sizeof(T));
+        position_ += sizeof(T);
+        return result;
+    }
+}
+
+#endif
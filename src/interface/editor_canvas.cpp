@@ -25,6 +25,7 @@
 
 #include "editor_canvas.hpp"
 #include "action.hpp"
+#include "action_journal.hpp"
 #include "track_properties.hpp"
 
 #include "editor_modes/mode_base.hpp"
@@ -42,6 +43,9 @@
 #include "components/track.hpp"
 #include "components/tile_definition.hpp"
 
+#include "core/polygon.hpp"
+
+#include <qapplication.h>
 #include <qevent.h>
 #include <qimage.h>
 #include <qbitmap.h>
@@ -50,11 +54,44 @@
 
 namespace interface
 {
+    // Texture coordinates are in atlas pixels, so they need to be scaled down
+    // when the reduced-resolution pages are bound.
+    static const std::string reduced_detail_vertex_shader_code =
+        "#version 110\n"
+
+        "uniform float texture_scale;\n"
+
+        "void main() {\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+        "    gl_TexCoord[0].xy *= texture_scale;\n"
+        "    gl_FrontColor = gl_Color;\n"
+        "}";
+
+    static const std::string reduced_detail_fragment_shader_code =
+        "#version 110\n"
+
+        "uniform sampler2D texture;\n"
+
+        "void main() {\n"
+        "    gl_FragColor = texture2D(texture, gl_TexCoord[0].xy) * gl_Color;\n"
+        "}";
+
+    // At this zoom level and below, a screen pixel covers at least two atlas pixels,
+    // which is where the reduced pages start to be used.
+    static const double reduced_detail_zoom_threshold = 0.5;
+
     struct AreaSelectionTool
     {
         core::Vector2i selection_origin_;
         core::IntRect selection_rect_;
         core::IntRect temp_selection_;
+
+        // With shift held down when the selection starts, the area is a free-form lasso
+        // instead of a rectangle. The rects above are then the bounds of the polygon.
+        bool lasso_ = false;
+        std::vector<core::Vector2i> selection_polygon_;
+        std::vector<core::Vector2i> temp_polygon_;
     };
 
     struct CursorStore
@@ -164,7 +201,31 @@ namespace interface
         return create_cursor_from_image(canvas, QImage(file_path));
     }
 
+    // A CommandType::LayerEdit record starts with the operation and the layer id,
+    // followed by the operation's own fields.
+    enum class LayerOp
+        : std::uint8_t
+    {
+        Hide,
+        Show,
+        Move,
+        Rename,
+        SetLevel,
+        Create,
+        Delete,
+        Merge
+    };
+
+    // A CommandType::TrackEdit record starts with the operation, followed by the old and the new state.
+    enum class TrackOp
+        : std::uint8_t
+    {
+        Properties,
+        Resize
+    };
+
     struct EditorCanvas::Impl
+        : public CommandTarget
     {
         explicit Impl(EditorCanvas* self)
             : self_(self),
@@ -184,6 +245,12 @@ namespace interface
         core::Vector2<double> camera_position_;
         double zoom_level_ = 1.5;
 
+        scene::DetailLevel detail_level_ = scene::DetailLevel::Full;
+        sf::Shader reduced_detail_shader_;
+        bool reduced_detail_available_ = false;
+
+        scene::InstancedRenderer instanced_renderer_;
+
         core::Vector2i absolute_mouse_position_;
         core::Vector2i mouse_position_;
         core::Vector2<double> scroll_amount_;
@@ -209,7 +276,7 @@ namespace interface
 
         void expand_area_selection(core::Vector2i position);
         void commit_area_selection();
-        void select_area(core::IntRect rect);
+        void select_area(core::IntRect rect, const std::vector<core::Vector2i>& polygon = {});
 
         void select_layer(std::size_t layer_id);
         void select_layer(components::ConstLayerHandle layer);
@@ -229,8 +296,92 @@ namespace interface
         void change_track_properties(const TrackProperties& track_properties);
 
         ModeBase* mode_object(EditorMode mode);
+
+        CommandTarget* command_target(CommandType type);
+
+        virtual void execute_command(CommandType type, CommandReader& reader) override;
+        virtual void undo_command(CommandType type, CommandReader& reader) override;
+        void apply_layer_edit(CommandReader& reader, bool undo);
+        void perform_layer_edit(const std::string& description, std::vector<std::uint8_t> record, bool execute = true);
+
+        void apply_area_selection(CommandReader& reader, bool undo);
+        void apply_track_edit(CommandReader& reader, bool undo);
+        void perform_command(const std::string& description, CommandType type, std::vector<std::uint8_t> record);
     };
 
+    namespace
+    {
+        template <typename... Fields>
+        std::vector<std::uint8_t> make_layer_record(LayerOp op, std::size_t layer_id, const Fields&... fields)
+        {
+            std::vector<std::uint8_t> record;
+            CommandWriter writer(record);
+            writer.write(op);
+            writer.write(static_cast<std::uint32_t>(layer_id));
+
+            using expand = int[];
+            (void)expand { 0, (writer.write(fields), 0)... };
+            return record;
+        }
+
+        std::uint32_t layer_field(std::size_t value)
+        {
+            return static_cast<std::uint32_t>(value);
+        }
+
+        // A CommandType::AreaSelection record holds whether executing it activates the area selection
+        // tool, then the selection before and after, each a rectangle and an optional polygon.
+        std::vector<std::uint8_t> make_area_selection_record(bool activate_tool,
+            core::IntRect old_area, const std::vector<core::Vector2i>& old_polygon,
+            core::IntRect new_area, const std::vector<core::Vector2i>& new_polygon)
+        {
+            std::vector<std::uint8_t> record;
+            CommandWriter writer(record);
+            writer.write(static_cast<std::uint8_t>(activate_tool));
+
+            auto write_selection = [&writer](core::IntRect area, const std::vector<core::Vector2i>& polygon)
+            {
+                writer.write(area.left);
+                writer.write(area.top);
+                writer.write(area.width);
+                writer.write(area.height);
+
+                writer.write(static_cast<std::uint32_t>(polygon.size()));
+                for (auto point : polygon)
+                {
+                    writer.write(point.x);
+                    writer.write(point.y);
+                }
+            };
+
+            write_selection(old_area, old_polygon);
+            write_selection(new_area, new_polygon);
+            return record;
+        }
+
+        void write_track_properties(CommandWriter& writer, const TrackProperties& properties)
+        {
+            writer.write(properties.author);
+            writer.write(properties.height_levels);
+            writer.write(static_cast<std::uint8_t>(properties.override_start_direction));
+            writer.write(properties.start_direction);
+            writer.write(properties.gravity_strength);
+            writer.write(properties.gravity_direction);
+        }
+
+        TrackProperties read_track_properties(CommandReader& reader)
+        {
+            TrackProperties properties = {};
+            properties.author = reader.read_string();
+            properties.height_levels = reader.read<std::int32_t>();
+            properties.override_start_direction = reader.read<std::uint8_t>() != 0;
+            properties.start_direction = reader.read<std::int32_t>();
+            properties.gravity_strength = reader.read<std::int32_t>();
+            properties.gravity_direction = reader.read<std::int32_t>();
+            return properties;
+        }
+    }
+
 
     EditorCanvas::EditorCanvas(QWidget* parent)
         : QtSFMLCanvas(parent),
@@ -264,7 +415,29 @@ namespace interface
             shape.setSize(sf::Vector2f(track_size.x, track_size.y));
             draw(shape, render_states);
             
-            scene::draw(*impl_->scene_, *this, render_states);
+            // Recomputing while dragging would only be thrown away on the next mouse move.
+            // The computation itself runs in the background, the result shows up a few frames later.
+            if (QApplication::mouseButtons() == Qt::NoButton)
+            {
+                impl_->scene_->update_occlusion();
+            }
+
+            if (impl_->scene_->instanced_rendering())
+            {
+                impl_->scene_->draw(impl_->instanced_renderer_, *this, render_states, impl_->detail_level_);
+            }
+
+            else if (impl_->detail_level_ == scene::DetailLevel::Reduced)
+            {
+                auto scene_states = render_states;
+                scene_states.shader = &impl_->reduced_detail_shader_;
+                scene::draw(*impl_->scene_, *this, scene_states, scene::DetailLevel::Reduced);
+            }
+
+            else
+            {
+                scene::draw(*impl_->scene_, *this, render_states);
+            }
 
             auto mode = active_mode();
             if (auto mode_object = impl_->mode_object(mode))
@@ -297,13 +470,29 @@ namespace interface
                 impl_->pattern_mode_.render(*this, render_states);
             }
 
-            auto rect = impl_->area_selection_.selection_rect_;
+            const auto& area_selection = impl_->area_selection_;
+            auto rect = area_selection.selection_rect_;
+            const auto* polygon = &area_selection.selection_polygon_;
             if (rect.width == 0 || rect.height == 0)
             {
-                rect = impl_->area_selection_.temp_selection_;
+                rect = area_selection.temp_selection_;
+                polygon = &area_selection.temp_polygon_;
+            }
+
+            if (!polygon->empty())
+            {
+                sf::VertexArray outline(sf::LinesStrip);
+                for (auto point : *polygon)
+                {
+                    outline.append(sf::Vertex(sf::Vector2f(point.x + 0.5f, point.y + 0.5f), sf::Color(255, 255, 255, 160)));
+                }
+
+                sf::Vertex first_vertex = outline[0];
+                outline.append(first_vertex);
+                draw(outline);
             }
 
-            if (rect.width != 0 && rect.height != 0)
+            else if (rect.width != 0 && rect.height != 0)
             {
                 sf::RectangleShape rect_display(sf::Vector2f(rect.width, rect.height));
                 rect_display.setOutlineColor(sf::Color(255, 255, 255, 100));
@@ -328,11 +517,28 @@ namespace interface
     {
         impl_->cursor_store_.emplace(this);
         impl_->font_bitmap_.emplace(graphics::default_font_data, graphics::default_font_data_size);
+
+        if (sf::Shader::isAvailable() && impl_->reduced_detail_shader_.loadFromMemory(reduced_detail_vertex_shader_code,
+            reduced_detail_fragment_shader_code))
+        {
+            impl_->reduced_detail_shader_.setParameter("texture", sf::Shader::CurrentTexture);
+            impl_->reduced_detail_shader_.setParameter("texture_scale", scene::reduced_texture_scale);
+            impl_->reduced_detail_available_ = true;
+        }
+
+        // Falls back to the regular vertex path if OpenGL 3.3 is not available.
+        impl_->instanced_renderer_.initialize();
     }
 
     void EditorCanvas::adopt_scene(std::unique_ptr<scene::Scene>& scene_ptr_)
     {
+        // The modes may still have work going on that refers to the previous scene,
+        // so it is kept around until they have all been given the new one.
+        auto previous_scene = std::move(impl_->scene_);
+
         impl_->scene_ = std::move(scene_ptr_);
+        impl_->scene_->enable_instanced_rendering(impl_->instanced_renderer_.available());
+        impl_->scene_->enable_occlusion_culling(true);
 
         setMouseTracking(true);
 
@@ -439,6 +645,13 @@ namespace interface
             auto fitting_zoom = compute_fitting_zoom_level();
             if (zoom_level_ < fitting_zoom) self_->set_zoom_level(fitting_zoom);
 
+            detail_level_ = scene::DetailLevel::Full;
+            bool reduced_detail_available = reduced_detail_available_ || scene_->instanced_rendering();
+            if (reduced_detail_available && zoom_level_ <= reduced_detail_zoom_threshold)
+            {
+                detail_level_ = scene::DetailLevel::Reduced;
+            }
+
             core::Vector2u track_size = scene_->track().size();
             auto track_width = static_cast<float>(track_size.x);
             auto track_height = static_cast<float>(track_size.y);
@@ -552,6 +765,14 @@ namespace interface
             area_selection.selection_origin_ = mouse_position();
             area_selection.temp_selection_ = core::IntRect(area_selection.selection_origin_, core::Vector2i(0, 0));
             area_selection.selection_rect_ = {};
+            area_selection.selection_polygon_.clear();
+            area_selection.temp_polygon_.clear();
+
+            area_selection.lasso_ = (event->modifiers() & Qt::ShiftModifier) != 0;
+            if (area_selection.lasso_)
+            {
+                area_selection.temp_polygon_.push_back(area_selection.selection_origin_);
+            }
 
             selection_area_changed(area_selection.temp_selection_);
         }
@@ -585,7 +806,12 @@ namespace interface
             if (in_area || (temp_selection.width != 0 && temp_selection.height != 0))
             {
                 impl_->commit_area_selection();
-            }            
+            }
+
+            else if (active_mode() == EditorMode::Tiles)
+            {
+                impl_->tiles_mode_.discard_area_selection_preview();
+            }
         }
 
         if (event->button() == Qt::RightButton)
@@ -728,6 +954,12 @@ namespace interface
         perform_action(Action(text, std::move(command), std::move(undo_command)));
     }
 
+    void EditorCanvas::perform_action(const std::string& text, CommandTarget* target, CommandType type,
+        std::vector<std::uint8_t> record)
+    {
+        perform_action(Action(text, target, type, std::move(record)));
+    }
+
 
     const scene::Scene* EditorCanvas::scene() const
     {
@@ -771,6 +1003,16 @@ namespace interface
         return impl_->scene_->pattern_store();
     }
 
+    components::PatternHashCache& EditorCanvas::pattern_hash_cache()
+    {
+        return impl_->scene_->pattern_hash_cache();
+    }
+
+    components::WrittenPattern& EditorCanvas::written_pattern()
+    {
+        return impl_->scene_->written_pattern();
+    }
+
     const components::ConstLayerHandle& EditorCanvas::selected_layer() const
     {
         return impl_->selected_layer_;
@@ -886,21 +1128,76 @@ namespace interface
         if (impl_->area_selection_.selection_rect_.width != 0 &&
             impl_->area_selection_.selection_rect_.height != 0)
         {
-            auto old_selection = impl_->area_selection_.selection_rect_;
+            const auto& area_selection = impl_->area_selection_;
+            impl_->perform_command("Deselect area", CommandType::AreaSelection, make_area_selection_record(false,
+                area_selection.selection_rect_, area_selection.selection_polygon_, {}, {}));
+        }
+    }
+
+    std::vector<Action> EditorCanvas::replay_journal(const JournalContents& contents)
+    {
+        std::vector<Action> actions;
+        if (!impl_->scene_) return actions;
+
+        auto replay_entry = [this](const JournalEntry& entry, bool undo)
+        {
+            auto target = impl_->command_target(entry.type);
+            if (!target) throw CommandFormatError();
+
+            CommandReader reader(entry.record.data(), entry.record.size());
+            if (undo) target->undo_command(entry.type, reader);
+            else target->execute_command(entry.type, reader);
+        };
+
+        const auto& entries = contents.entries;
+        auto saved_index = contents.saved_index;
+        auto history_index = contents.history_index;
+
+        impl_->scene_->begin_transaction();
+
+        try
+        {
+            for (auto it = contents.unwind_entries.rbegin(); it != contents.unwind_entries.rend(); ++it)
+            {
+                replay_entry(*it, true);
+            }
 
-            auto command = [=]()
+            for (auto index = saved_index; index < history_index; ++index)
             {
-                impl_->select_area({});
-            };
+                replay_entry(entries[index], false);
+            }
 
-            auto undo_command = [=]()
+            for (auto index = saved_index; index > history_index; )
             {
-                impl_->select_area(old_selection);
-            };
+                replay_entry(entries[--index], true);
+            }
+        }
 
-            command();
-            perform_action("Deselect area", command, undo_command);
+        catch (...)
+        {
+            impl_->scene_->end_transaction();
+            throw;
         }
+
+        impl_->scene_->end_transaction();
+
+        actions.reserve(entries.size());
+        for (const auto& entry : entries)
+        {
+            actions.emplace_back(entry.description, impl_->command_target(entry.type), entry.type, entry.record);
+        }
+
+        return actions;
+    }
+
+    void EditorCanvas::begin_scene_transaction()
+    {
+        if (impl_->scene_) impl_->scene_->begin_transaction();
+    }
+
+    void EditorCanvas::end_scene_transaction()
+    {
+        if (impl_->scene_) impl_->scene_->end_transaction();
     }
 
     void EditorCanvas::delete_selection()
@@ -957,20 +1254,42 @@ namespace interface
     void EditorCanvas::Impl::expand_area_selection(core::Vector2i position)
     {
         auto origin = area_selection_.selection_origin_;
-        area_selection_.temp_selection_ = core::IntRect(origin, position, core::rect::from_points);
+        auto& polygon = area_selection_.temp_polygon_;
+
+        if (area_selection_.lasso_)
+        {
+            if (polygon.empty() || polygon.back() != position)
+            {
+                polygon.push_back(position);
+            }
+
+            area_selection_.temp_selection_ = core::polygon_bounds(polygon);
+        }
+
+        else
+        {
+            area_selection_.temp_selection_ = core::IntRect(origin, position, core::rect::from_points);
+        }
+
+        if (active_mode_ == EditorMode::Tiles)
+        {
+            tiles_mode_.preview_tiles_in_area(area_selection_.temp_selection_, polygon);
+        }
 
         self_->selection_area_changed(area_selection_.temp_selection_);
     }
 
-    void EditorCanvas::Impl::select_area(core::IntRect area)
+    void EditorCanvas::Impl::select_area(core::IntRect area, const std::vector<core::Vector2i>& polygon)
     {
         area_selection_.selection_rect_ = area;
+        area_selection_.selection_polygon_ = polygon;
         area_selection_.temp_selection_ = {};
+        area_selection_.temp_polygon_.clear();
         area_selection_.selection_origin_ = {};
 
         if (active_mode_ == EditorMode::Tiles)
         {
-            tiles_mode_.select_tiles_in_area(area);
+            tiles_mode_.select_tiles_in_area(area, polygon);
         }
 
         self_->area_selected(area);
@@ -981,24 +1300,17 @@ namespace interface
         auto old_selection = area_selection_.selection_rect_;
         auto new_selection = area_selection_.temp_selection_;
 
-        if (new_selection != old_selection)
-        {
-            auto command = [=]()
-            {
-                self_->set_active_tool(EditorTool::AreaSelection);
-                select_area(new_selection);
-            };
-
-            auto undo_command = [=]()
-            {
-                select_area(old_selection);
-            };
+        auto old_polygon = area_selection_.selection_polygon_;
+        auto new_polygon = area_selection_.temp_polygon_;
+        if (new_polygon.size() < 3) new_polygon.clear();
 
-            command();
+        if (new_selection != old_selection || new_polygon != old_polygon)
+        {
             const char* text = "Select area";
             if (new_selection.width == 0 || new_selection.height == 0) text = "Deselect area";
 
-            self_->perform_action(text, command, undo_command);
+            perform_command(text, CommandType::AreaSelection, 
+                make_area_selection_record(true, old_selection, old_polygon, new_selection, new_polygon));
         }
     }
 
@@ -1170,24 +1482,7 @@ namespace interface
         {
             std::size_t selected_layer = impl_->selected_layer_.id();
 
-            auto command = [=]()
-            {
-                impl_->hide_layer(layer_id);
-
-                if (impl_->selected_layer_.id() == layer_id)
-                {
-                    impl_->select_layer(components::ConstLayerHandle());
-                }
-            };
-
-            auto undo_command = [=]()
-            {
-                impl_->show_layer(layer_id);
-                impl_->select_layer(selected_layer);
-            };
-
-            command();
-            perform_action("Hide layer", command, undo_command);
+            impl_->perform_layer_edit("Hide layer", make_layer_record(LayerOp::Hide, layer_id, layer_field(selected_layer)));
         }
     }
 
@@ -1197,20 +1492,7 @@ namespace interface
         {
             std::size_t selected_layer = impl_->selected_layer_.id();
 
-            auto command = [=]()
-            {
-                impl_->scene_->show_layer(layer_id);
-                impl_->select_layer(layer_id);
-            };
-
-            auto undo_command = [=]()
-            {
-                impl_->scene_->hide_layer(layer_id);
-                impl_->select_layer(selected_layer);
-            };
-
-            command();
-            perform_action("Show layer", command, undo_command);            
+            impl_->perform_layer_edit("Show layer", make_layer_record(LayerOp::Show, layer_id, layer_field(selected_layer)));
         }
     }
 
@@ -1220,19 +1502,8 @@ namespace interface
         {
             std::size_t old_index = impl_->scene_->find_layer_index(layer_id);
 
-            auto command = [=]()
-            {
-                impl_->move_layer(layer_id, new_index);
-            };
-
-            auto undo_command = [=]()
-            {
-                impl_->move_layer(layer_id, old_index);
-            };
-
-
-            command();
-            perform_action("Move layer", command, undo_command);
+            impl_->perform_layer_edit("Move layer", 
+                make_layer_record(LayerOp::Move, layer_id, layer_field(old_index), layer_field(new_index)));
         }
     }
 
@@ -1242,20 +1513,8 @@ namespace interface
         {
             if (auto layer = impl_->scene_->track().layer_by_id(layer_id))
             {
-                const auto& old_name = layer->name;
-
-                auto command = [=]()
-                {
-                    impl_->rename_layer(layer_id, new_name);
-                };
-
-                auto undo_command = [=]()
-                {
-                    impl_->rename_layer(layer_id, old_name);
-                };
-
-                command();
-                perform_action("Rename layer", command, undo_command);
+                impl_->perform_layer_edit("Rename layer", 
+                    make_layer_record(LayerOp::Rename, layer_id, layer->name, new_name));
             }            
         }
     }
@@ -1267,21 +1526,9 @@ namespace interface
             if (auto layer = impl_->scene_->track().layer_by_id(layer_id))
             {
                 std::size_t old_index = impl_->scene_->find_layer_index(layer_id);
-                std::size_t old_level = layer->level;
-
-                auto command = [=]()
-                {
-                    impl_->set_layer_level(layer_id, new_level);
-                };
-
-                auto undo_command = [=]()
-                {
-                    impl_->set_layer_level(layer_id, old_level);
-                    impl_->move_layer(layer_id, old_index);
-                };
 
-                command();
-                perform_action("Change level", command, undo_command);
+                impl_->perform_layer_edit("Change level", make_layer_record(LayerOp::SetLevel, layer_id, 
+                    layer_field(old_index), layer_field(layer->level), layer_field(new_level)));
             }
         }
     }
@@ -1303,18 +1550,7 @@ namespace interface
         layer_created(layer_id, index);
         impl_->select_layer(layer);
 
-        auto command = [=]()
-        {
-            impl_->restore_layer(layer_id, index);
-            impl_->select_layer(layer);
-        };
-
-        auto undo_command = [=]()
-        {
-            impl_->delete_layer(layer_id);
-        };
-
-        perform_action("Create layer", command, undo_command);
+        impl_->perform_layer_edit("Create layer", make_layer_record(LayerOp::Create, layer_id, layer_field(index)), false);
         return layer_id;
     }
 
@@ -1325,19 +1561,8 @@ namespace interface
             std::size_t selected_layer = impl_->selected_layer_.id();
             std::size_t index = impl_->scene_->find_layer_index(layer_id);
 
-            auto command = [=]()
-            {
-                impl_->delete_layer(layer_id);
-            };
-
-            auto undo_command = [=]()
-            {
-                impl_->restore_layer(layer_id, index);
-                impl_->select_layer(selected_layer);
-            };
-
-            command();
-            perform_action("Delete layer", command, undo_command);
+            impl_->perform_layer_edit("Delete layer", 
+                make_layer_record(LayerOp::Delete, layer_id, layer_field(index), layer_field(selected_layer)));
         }
     }
 
@@ -1362,29 +1587,214 @@ namespace interface
             if (index != 0 && layers[index - 1]->level == layer->level)
             {
                 const auto& previous = layers[index - 1];
-                std::size_t previous_id = previous.id();
-                std::size_t tile_count = layer->tiles.size();
 
-                auto command = [=]()
-                {
-                    for (const auto& tile : layer->tiles)
-                    {
-                        impl_->scene_->append_tile(previous_id, tile);
-                    }
+                // The merged layer keeps its tiles while it's deleted, so the record doesn't need them.
+                impl_->perform_layer_edit("Merge layers", make_layer_record(LayerOp::Merge, layer_id, 
+                    layer_field(index), layer_field(previous.id()), layer_field(layer->tiles.size())));
+            }
+        }
+    }
+
+    CommandTarget* EditorCanvas::Impl::command_target(CommandType type)
+    {
+        switch (type)
+        {
+        case CommandType::TileEdit: return &tiles_mode_;
+        case CommandType::ControlPointEdit: return &control_points_mode_;
+        case CommandType::LayerEdit: return this;
+        case CommandType::StartPointEdit: return &start_points_mode_;
+        case CommandType::PitEdit: return &pit_mode_;
+        case CommandType::AreaSelection: return this;
+        case CommandType::TrackEdit: return this;
+        default: return nullptr;
+        }
+    }
+
+    void EditorCanvas::Impl::execute_command(CommandType type, CommandReader& reader)
+    {
+        if (type == CommandType::LayerEdit) apply_layer_edit(reader, false);
+        else if (type == CommandType::AreaSelection) apply_area_selection(reader, false);
+        else if (type == CommandType::TrackEdit) apply_track_edit(reader, false);
+    }
+
+    void EditorCanvas::Impl::undo_command(CommandType type, CommandReader& reader)
+    {
+        if (type == CommandType::LayerEdit) apply_layer_edit(reader, true);
+        else if (type == CommandType::AreaSelection) apply_area_selection(reader, true);
+        else if (type == CommandType::TrackEdit) apply_track_edit(reader, true);
+    }
+
+    void EditorCanvas::Impl::perform_command(const std::string& description, CommandType type, 
+        std::vector<std::uint8_t> record)
+    {
+        CommandReader reader(record.data(), record.size());
+        execute_command(type, reader);
+
+        self_->perform_action(description, this, type, std::move(record));
+    }
+
+    void EditorCanvas::Impl::apply_area_selection(CommandReader& reader, bool undo)
+    {
+        bool activate_tool = reader.read<std::uint8_t>() != 0;
+
+        core::IntRect area;
+        std::vector<core::Vector2i> polygon;
+        for (bool apply : { undo, !undo })
+        {
+            area.left = reader.read<std::int32_t>();
+            area.top = reader.read<std::int32_t>();
+            area.width = reader.read<std::int32_t>();
+            area.height = reader.read<std::int32_t>();
+
+            polygon.resize(reader.read<std::uint32_t>());
+            for (auto& point : polygon)
+            {
+                point.x = reader.read<std::int32_t>();
+                point.y = reader.read<std::int32_t>();
+            }
+
+            if (!apply) continue;
+
+            if (activate_tool && !undo) self_->set_active_tool(EditorTool::AreaSelection);
+            select_area(area, polygon);
+        }
+    }
+
+    void EditorCanvas::Impl::apply_track_edit(CommandReader& reader, bool undo)
+    {
+        auto op = reader.read<TrackOp>();
+        if (op == TrackOp::Properties)
+        {
+            auto old_properties = read_track_properties(reader);
+            auto new_properties = read_track_properties(reader);
+            change_track_properties(undo ? old_properties : new_properties);
+        }
+
+        else if (op == TrackOp::Resize)
+        {
+            core::Vector2u old_size, new_size;
+            old_size.x = reader.read<std::uint32_t>();
+            old_size.y = reader.read<std::uint32_t>();
+            new_size.x = reader.read<std::uint32_t>();
+            new_size.y = reader.read<std::uint32_t>();
+
+            core::Vector2<double> tile_offset;
+            tile_offset.x = reader.read<double>();
+            tile_offset.y = reader.read<double>();
+
+            scene_->resize_track(undo ? old_size : new_size);
+            scene_->move_all_tiles(undo ? -tile_offset : tile_offset);
+        }
+    }
+
+    void EditorCanvas::Impl::perform_layer_edit(const std::string& description, std::vector<std::uint8_t> record,
+        bool execute)
+    {
+        if (execute)
+        {
+            CommandReader reader(record.data(), record.size());
+            apply_layer_edit(reader, false);
+        }
+
+        self_->perform_action(description, this, CommandType::LayerEdit, std::move(record));
+    }
+
+    void EditorCanvas::Impl::apply_layer_edit(CommandReader& reader, bool undo)
+    {
+        auto op = reader.read<LayerOp>();
+        std::size_t layer_id = reader.read<std::uint32_t>();
 
-                    impl_->delete_layer(layer_id);
-                    select_layer(previous_id);
-                };
+        if (op == LayerOp::Hide || op == LayerOp::Show)
+        {
+            std::size_t selected_layer = reader.read<std::uint32_t>();
+            if (op == LayerOp::Hide && !undo)
+            {
+                hide_layer(layer_id);
+                if (selected_layer_.id() == layer_id) select_layer(components::ConstLayerHandle());
+            }
+
+            else if (op == LayerOp::Hide)
+            {
+                show_layer(layer_id);
+                select_layer(selected_layer);
+            }
+
+            else if (!undo)
+            {
+                scene_->show_layer(layer_id);
+                select_layer(layer_id);
+            }
 
-                auto undo_command = [=]()
+            else
+            {
+                scene_->hide_layer(layer_id);
+                select_layer(selected_layer);
+            }
+        }
+
+        else if (op == LayerOp::Move)
+        {
+            std::size_t old_index = reader.read<std::uint32_t>();
+            std::size_t new_index = reader.read<std::uint32_t>();
+            move_layer(layer_id, undo ? old_index : new_index);
+        }
+
+        else if (op == LayerOp::Rename)
+        {
+            auto old_name = reader.read_string();
+            auto new_name = reader.read_string();
+            rename_layer(layer_id, undo ? old_name : new_name);
+        }
+
+        else if (op == LayerOp::SetLevel)
+        {
+            std::size_t old_index = reader.read<std::uint32_t>();
+            std::size_t old_level = reader.read<std::uint32_t>();
+            std::size_t new_level = reader.read<std::uint32_t>();
+
+            set_layer_level(layer_id, undo ? old_level : new_level);
+            if (undo) move_layer(layer_id, old_index);
+        }
+
+        else if (op == LayerOp::Create || op == LayerOp::Delete)
+        {
+            std::size_t index = reader.read<std::uint32_t>();
+            if ((op == LayerOp::Create) != undo)
+            {
+                restore_layer(layer_id, index);
+
+                if (op == LayerOp::Create) select_layer(layer_id);
+                else select_layer(reader.read<std::uint32_t>());
+            }
+
+            else
+            {
+                delete_layer(layer_id);
+            }
+        }
+
+        else if (op == LayerOp::Merge)
+        {
+            std::size_t index = reader.read<std::uint32_t>();
+            std::size_t previous_id = reader.read<std::uint32_t>();
+            std::size_t tile_count = reader.read<std::uint32_t>();
+
+            if (!undo)
+            {
+                if (auto layer = scene_->track().layer_by_id(layer_id))
                 {
-                    impl_->scene_->delete_last_tiles(previous_id, tile_count);
-                    impl_->restore_layer(layer_id, index);
-                    select_layer(layer_id);
-                };
+                    scene_->append_tiles(previous_id, layer->tiles.begin(), layer->tiles.end());
+                }
 
-                command();
-                perform_action("Merge layers", command, undo_command);
+                delete_layer(layer_id);
+                select_layer(previous_id);
+            }
+
+            else
+            {
+                scene_->delete_last_tiles(previous_id, tile_count);
+                restore_layer(layer_id, index);
+                select_layer(layer_id);
             }
         }
     }
@@ -1423,18 +1833,13 @@ namespace interface
             old_properties.gravity_strength = track.gravity_strength();
             old_properties.gravity_direction = track.gravity_direction();
 
-            auto command = [=]()
-            {
-                impl_->change_track_properties(track_properties);
-            };
+            std::vector<std::uint8_t> record;
+            CommandWriter writer(record);
+            writer.write(TrackOp::Properties);
+            write_track_properties(writer, old_properties);
+            write_track_properties(writer, track_properties);
 
-            auto undo_command = [=]()
-            {
-                impl_->change_track_properties(old_properties);
-            };
-
-            command();
-            perform_action("Edit Properties", command, undo_command);            
+            impl_->perform_command("Edit Properties", CommandType::TrackEdit, std::move(record));
         }
     }
 
@@ -1458,20 +1863,17 @@ namespace interface
             if (vertical_anchor == VerticalAnchor::Bottom) tile_offset.y = growth.y;
             else if (vertical_anchor == VerticalAnchor::Center) tile_offset.y = growth.y / 2;
 
-            auto command = [=]()
-            {
-                impl_->scene_->resize_track(new_size);
-                impl_->scene_->move_all_tiles(tile_offset);
-            };
-
-            auto undo_command = [=]()
-            {
-                impl_->scene_->resize_track(old_size);
-                impl_->scene_->move_all_tiles(-tile_offset);
-            };
-
-            command();
-            perform_action("Resize track", command, undo_command);            
+            std::vector<std::uint8_t> record;
+            CommandWriter writer(record);
+            writer.write(TrackOp::Resize);
+            writer.write(old_size.x);
+            writer.write(old_size.y);
+            writer.write(new_size.x);
+            writer.write(new_size.y);
+            writer.write(tile_offset.x);
+            writer.write(tile_offset.y);
+
+            impl_->perform_command("Resize track", CommandType::TrackEdit, std::move(record));
         }
     }
 
@@ -29,6 +29,7 @@
 #include "qt_sfml_canvas.hpp"
 #include "resize_anchor.hpp"
 #include "editor_modes.hpp"
+#include "command.hpp"
 
 #include "core/vector2.hpp"
 
@@ -47,6 +48,8 @@ namespace components
 {
     class Track;
     class PatternStore;
+    class PatternHashCache;
+    struct WrittenPattern;
 }
 
 namespace interface
@@ -55,6 +58,7 @@ namespace interface
     struct TrackProperties;
 
     class Action;
+    struct JournalContents;
 
     class EditorCanvas
         : public QtSFMLCanvas
@@ -83,6 +87,8 @@ namespace interface
         const scene::Scene* scene() const;
         const components::Track& track() const;
         const components::PatternStore& pattern_store() const;
+        components::PatternHashCache& pattern_hash_cache();
+        components::WrittenPattern& written_pattern();
 
         std::size_t num_levels() const;
         core::Vector2i track_size() const;
@@ -102,6 +108,12 @@ namespace interface
         void set_active_cursor(EditorCursor cursor);
 
         void perform_action(const std::string& text, std::function<void()>, std::function<void()>);
+        void perform_action(const std::string& text, CommandTarget* target, CommandType type,
+            std::vector<std::uint8_t> record);
+
+        // Brings the scene from the saved state to the state the journal left off at, in one scene 
+        // transaction, and returns the journaled history as actions.
+        std::vector<Action> replay_journal(const JournalContents& contents);
 
     public slots:
     void adopt_scene(std::unique_ptr<scene::Scene>& scene_ptr);
@@ -133,6 +145,9 @@ namespace interface
         void delete_last();
         void delete_selection();
 
+        void begin_scene_transaction();
+        void end_scene_transaction();
+
         void cut_selection();
         void copy_selection();
         void paste_clipboard();
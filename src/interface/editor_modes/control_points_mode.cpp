@@ -36,6 +36,34 @@
 
 NAMESPACE_INTERFACE_MODES
 
+// A CommandType::ControlPointEdit record is a single operation: its kind,
+// the control point index and the affected control point(s).
+enum class ControlPointOp
+    : std::uint8_t
+{
+    Append,
+    Insert,
+    Update,
+    Erase,
+    EraseLast,
+    Rotate
+};
+
+static std::vector<std::uint8_t> make_control_point_record(ControlPointOp op, std::size_t index,
+    const components::ControlPoint& point = components::ControlPoint(), 
+    const components::ControlPoint& new_point = components::ControlPoint())
+{
+    std::vector<std::uint8_t> record;
+    CommandWriter writer(record);
+    writer.write(op);
+    writer.write(static_cast<std::uint32_t>(index));
+
+    if (op != ControlPointOp::Rotate) writer.write(point);
+    if (op == ControlPointOp::Update) writer.write(new_point);
+
+    return record;
+}
+
 ControlPointsMode::ControlPointsMode(EditorCanvas* canvas)
   : ModeBase(canvas)
 {
@@ -155,16 +183,9 @@ void ControlPointsMode::mouse_press_event(QMouseEvent* event)
     else if (tool == EditorTool::Rotation && event->button() == Qt::LeftButton && selected_control_point_index_)
     {
         std::size_t index = *selected_control_point_index_;
-        auto command = [=]()
-        {
-            scene()->rotate_control_point(index);
-            update_control_point_info(index);
-        };
 
-        command();
-
-        // Heu, we can use the same command for undo as well
-        canvas()->perform_action("Rotate control point", command, command);
+        // Rotating is its own inverse.
+        perform_control_point_edit("Rotate control point", make_control_point_record(ControlPointOp::Rotate, index));
     }
 
     else if ((tool == EditorTool::Movement || tool == EditorTool::Resize) &&
@@ -317,24 +338,10 @@ void ControlPointsMode::place_control_point(core::Vector2i start, core::Vector2i
         }
 
         auto index = selected_control_point_index_;
-        auto command = [=]()
-        {
-            if (!index) scene()->append_control_point(point);
-            else
-            {
-                scene()->insert_control_point(*index, point);
-                select_control_point(*index + 1);
-            }
-        };
-
-        auto undo_command = [=]()
-        {
-            if (!index) scene()->delete_last_control_point();
-            else scene()->delete_control_point(*index);
-        };
+        auto record = index ? make_control_point_record(ControlPointOp::Insert, *index, point) :
+            make_control_point_record(ControlPointOp::Append, 0, point);
 
-        command();
-        canvas()->perform_action("Add control point", command, undo_command);
+        perform_control_point_edit("Add control point", std::move(record));
     }
 }
 
@@ -343,22 +350,11 @@ void ControlPointsMode::delete_last_control_point()
     const auto& control_points = scene()->track().control_points();
     if (!control_points.empty())
     {
-        auto last_point = control_points.back();
-
-        auto command = [=]()
-        {
-            scene()->delete_last_control_point();
-        };
-
-        auto undo_command = [=]()
-        {
-            scene()->append_control_point(last_point);
-        };
+        auto record = make_control_point_record(ControlPointOp::EraseLast, control_points.size() - 1, control_points.back());
 
         control_point_start_ = boost::none;
 
-        command();
-        canvas()->perform_action("Remove control point", command, undo_command);
+        perform_control_point_edit("Remove control point", std::move(record));
     }
 
     deselect_control_point();
@@ -369,20 +365,8 @@ void ControlPointsMode::commit_control_point_movement(std::size_t index, core::V
     const auto& control_points = scene()->track().control_points();
     if (index < control_points.size())
     {
-        auto point = control_points[index], old_point = old_point_state_;
-
-        auto command = [=]()
-        {
-            scene()->update_control_point(index, point);
-        };
-
-        auto undo_command = [=]()
-        {
-            scene()->update_control_point(index, old_point);
-        };
-
-        command();
-        canvas()->perform_action("Move control point", command, undo_command);
+        perform_control_point_edit("Move control point", 
+            make_control_point_record(ControlPointOp::Update, index, old_point_state_, control_points[index]));
     }
 }
 
@@ -420,20 +404,8 @@ void ControlPointsMode::commit_control_point_resize(std::size_t index, core::Vec
     const auto& control_points = scene()->track().control_points();
     if (index < control_points.size())
     {
-        auto point = control_points[index], old_point = old_point_state_;
-        
-        auto command = [=]()
-        {
-            scene()->update_control_point(index, point);
-        };
-
-        auto undo_command = [=]()
-        {
-            scene()->update_control_point(index, old_point);
-        };
-
-        command();
-        canvas()->perform_action("Resize control point", command, undo_command);        
+        perform_control_point_edit("Resize control point",
+            make_control_point_record(ControlPointOp::Update, index, old_point_state_, control_points[index]));
     }
 }
 
@@ -443,23 +415,74 @@ void ControlPointsMode::delete_selected_control_point()
     if (selected_control_point_index_ && *selected_control_point_index_ < control_points.size())
     {
         std::size_t index = *selected_control_point_index_;
-        auto point = control_points[index];
 
-        auto command = [=]()
-        {
-            scene()->delete_control_point(index);
-        };
+        perform_control_point_edit("Remove control point", 
+            make_control_point_record(ControlPointOp::Erase, index, control_points[index]));
+    }
+
+    deselect_control_point();
+}
+
+void ControlPointsMode::execute_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::ControlPointEdit) apply_control_point_edit(reader, false);
+}
+
+void ControlPointsMode::undo_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::ControlPointEdit) apply_control_point_edit(reader, true);
+}
+
+void ControlPointsMode::perform_control_point_edit(const std::string& description, std::vector<std::uint8_t> record)
+{
+    CommandReader reader(record.data(), record.size());
+    apply_control_point_edit(reader, false);
 
-        auto undo_command = [=]()
+    canvas()->perform_action(description, this, CommandType::ControlPointEdit, std::move(record));
+}
+
+void ControlPointsMode::apply_control_point_edit(CommandReader& reader, bool undo)
+{
+    auto op = reader.read<ControlPointOp>();
+    std::size_t index = reader.read<std::uint32_t>();
+
+    if (op == ControlPointOp::Rotate)
+    {
+        scene()->rotate_control_point(index);
+        update_control_point_info(index);
+        return;
+    }
+
+    auto point = reader.read_control_point();
+    switch (op)
+    {
+    case ControlPointOp::Append:
+    case ControlPointOp::EraseLast:
+        if ((op == ControlPointOp::Append) != undo) scene()->append_control_point(point);
+        else scene()->delete_last_control_point();
+        break;
+
+    case ControlPointOp::Insert:
+    case ControlPointOp::Erase:
+        if ((op == ControlPointOp::Insert) != undo)
         {
             scene()->insert_control_point(index, point);
-        };
+            if (op == ControlPointOp::Insert) select_control_point(index + 1);
+        }
 
-        command();
-        canvas()->perform_action("Remove control point", command, undo_command);
-    }
+        else scene()->delete_control_point(index);
+        break;
 
-    deselect_control_point();
+    case ControlPointOp::Update:
+        {
+            auto new_point = reader.read_control_point();
+            scene()->update_control_point(index, undo ? point : new_point);
+        }
+        break;
+
+    default:
+        break;
+    }
 }
 
 void ControlPointsMode::update_control_point_info()
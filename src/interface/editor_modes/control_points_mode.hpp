@@ -28,6 +28,8 @@
 
 #include "mode_base.hpp"
 
+#include "../command.hpp"
+
 #include "components/control_point.hpp"
 
 #include "core/vector2.hpp"
@@ -49,7 +51,7 @@ namespace graphics
 NAMESPACE_INTERFACE_MODES
 
 struct ControlPointsMode
-    : ModeBase
+    : ModeBase, CommandTarget
 {
     ControlPointsMode(EditorCanvas* canvas);
 
@@ -66,6 +68,9 @@ struct ControlPointsMode
 
     virtual void tool_changed(EditorTool tool) override;
 
+    virtual void execute_command(CommandType type, CommandReader& reader) override;
+    virtual void undo_command(CommandType type, CommandReader& reader) override;
+
 private:
     virtual std::uint32_t enabled_tools() const override;
     virtual void on_activate() override;
@@ -76,6 +81,9 @@ private:
     void commit_control_point_movement(std::size_t index, core::Vector2i offset);
     void commit_control_point_resize(std::size_t index, core::Vector2i offset);
 
+    void apply_control_point_edit(CommandReader& reader, bool undo);
+    void perform_control_point_edit(const std::string& description, std::vector<std::uint8_t> record);
+
     void select_control_point(std::size_t index);
     void deselect_control_point();
 
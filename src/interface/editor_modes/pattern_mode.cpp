@@ -30,8 +30,60 @@
 
 #include "scene/scene.hpp"
 
+#include <algorithm>
+#include <thread>
+
 NAMESPACE_INTERFACE_MODES
 
+namespace
+{
+    bool is_page_changed(const components::Pattern& pattern, const components::Pattern& previous, sf::IntRect rect)
+    {
+        for (std::int32_t y = rect.top; y != rect.top + rect.height; ++y)
+        {
+            auto row = pattern.row_begin(y) + rect.left;
+            if (!std::equal(row, row + rect.width, previous.row_begin(y) + rect.left)) return true;
+        }
+
+        return false;
+    }
+
+    // Expands the terrain ids to their colors straight into the page's pixels, in bands of rows.
+    void expand_page(const components::Pattern& pattern, const components::TerrainPalette& palette, 
+        sf::IntRect rect, std::vector<components::TerrainColor>& pixels)
+    {
+        pixels.resize(rect.width * rect.height);
+
+        auto expand_rows = [&](std::int32_t row_begin, std::int32_t row_end)
+        {
+            for (std::int32_t y = row_begin; y < row_end; ++y)
+            {
+                auto row = pattern.row_begin(rect.top + y) + rect.left;
+                auto out = pixels.begin() + y * rect.width;
+
+                for (std::int32_t x = 0; x != rect.width; ++x)
+                {
+                    out[x] = palette[row[x]];
+                }
+            }
+        };
+
+        const std::int32_t min_band_size = 128;
+
+        std::int32_t worker_count = std::max(std::thread::hardware_concurrency(), 1U);
+        std::int32_t rows_per_band = std::max(min_band_size, (rect.height + worker_count - 1) / worker_count);
+
+        std::vector<std::future<void>> bands;
+        for (std::int32_t row = rows_per_band; row < rect.height; row += rows_per_band)
+        {
+            bands.push_back(std::async(std::launch::async, expand_rows, row, std::min(row + rows_per_band, rect.height)));
+        }
+
+        expand_rows(0, std::min(rows_per_band, rect.height));
+        for (auto& band : bands) band.get();
+    }
+}
+
 
 PatternMode::PatternMode(EditorCanvas* canvas)
 : ModeBase(canvas)
@@ -56,68 +108,128 @@ void PatternMode::render(sf::RenderTarget& render_target, sf::RenderStates rende
     }
 }
 
-void PatternMode::on_activate()
+void PatternMode::on_initialize(scene::Scene* scene)
 {
+    // A build that is still running refers to the previous scene, which may not outlive this.
+    loading_job_.cancel_and_wait();
+
     sub_textures_.clear();
+    pattern_.reset();
+    palette_ = {};
+}
 
+void PatternMode::on_activate()
+{
     initiate_pattern_building();
 }
 
+void PatternMode::on_deactivate()
+{
+    loading_job_.cancel();
+}
+
 void PatternMode::poll_loading_result()
 {
-    if (loading_future_.valid() && loading_future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    if (loading_job_.is_ready())
     {
-        sub_textures_ = loading_future_.get();
+        apply_preview(loading_job_.get());
+    }
+}
+
+void PatternMode::apply_preview(PatternPreview preview)
+{
+    if (preview.replaces_all)
+    {
+        sub_textures_ = std::move(preview.sub_textures);
+    }
+
+    else
+    {
+        // Swap the refreshed pages in for the ones they cover.
+        while (!preview.sub_textures.empty())
+        {
+            auto new_page = preview.sub_textures.begin();
+            auto old_page = std::find_if(sub_textures_.begin(), sub_textures_.end(),
+                [&](const SubTexture& sub_texture)
+            {
+                return sub_texture.sub_rect == new_page->sub_rect;
+            });
+
+            sub_textures_.splice(old_page, preview.sub_textures, new_page);
+            if (old_page != sub_textures_.end()) sub_textures_.erase(old_page);
+        }
     }
+
+    pattern_ = std::move(preview.pattern);
+    palette_ = preview.palette;
 }
 
 void PatternMode::initiate_pattern_building()
 {
-    auto loading_func = [=]()
+    // Any build still in progress is out of date by now, and its result never makes it to the screen.
+    // The new one is compared against what is shown.
+    auto previous_pattern = pattern_;
+    auto previous_palette = palette_;
+
+    auto loading_func = [=](const core::CancellationToken& cancellation)
     {
-        components::PatternBuilder pattern_builder(scene()->track(), scene()->pattern_store());
-        auto pattern = pattern_builder();
-        auto pattern_size = pattern.size();
+        auto check_cancellation = [&cancellation]()
+        {
+            cancellation.throw_if_cancelled();
+        };
 
-        const auto& terrain_library = scene()->track().terrain_library();
+        components::PatternBuilder pattern_builder(scene()->track(), scene()->pattern_store());
+        auto pattern = std::make_shared<const components::Pattern>(pattern_builder(check_cancellation));
+        auto pattern_size = pattern->size();
 
-        sf::Image image;
-        image.create(pattern_size.x, pattern_size.y);
+        PatternPreview result;
+        result.pattern = pattern;
+        result.palette = scene()->track().terrain_library().palette();
 
-        for (std::uint32_t y = 0; y != pattern_size.y; ++y)
+        auto same_palette = [](const components::TerrainPalette& a, const components::TerrainPalette& b)
         {
-            for (std::uint32_t x = 0; x != pattern_size.x; ++x)
+            return std::equal(a.begin(), a.end(), b.begin(), 
+                [](const components::TerrainColor& a, const components::TerrainColor& b)
             {
-                const auto& terrain = terrain_library.terrain_by_id(pattern(x, y));
+                return a.red == b.red && a.green == b.green && a.blue == b.blue && a.alpha == b.alpha;
+            });
+        };
 
-                sf::Color color(terrain.red, terrain.green, terrain.blue);
-                image.setPixel(x, y, color);
-            }
-        }
+        result.replaces_all = !previous_pattern || previous_pattern->size() != pattern_size ||
+            !same_palette(previous_palette, result.palette);
 
-        std::list<SubTexture> result;
         const std::uint32_t texture_size = std::min(sf::Texture::getMaximumSize(), 2048U);
 
+        std::vector<components::TerrainColor> pixels;
         for (std::uint32_t y = 0; y < pattern_size.y; y += texture_size)
         {
             for (std::uint32_t x = 0; x < pattern_size.x; x += texture_size)
             {
-                result.emplace_back();
+                sf::IntRect sub_rect;
+                sub_rect.left = x;
+                sub_rect.top = y;
+                sub_rect.width = std::min(x + texture_size, pattern_size.x) - x;
+                sub_rect.height = std::min(y + texture_size, pattern_size.y) - y;
+
+                if (!result.replaces_all && !is_page_changed(*pattern, *previous_pattern, sub_rect)) continue;
+
+                cancellation.throw_if_cancelled();
+
+                expand_page(*pattern, result.palette, sub_rect, pixels);
 
-                auto& sub_texture = result.back();
-                sub_texture.sub_rect.left = x;
-                sub_texture.sub_rect.top = y;
-                sub_texture.sub_rect.width = std::min(x + texture_size, pattern_size.x) - x;
-                sub_texture.sub_rect.height = std::min(y + texture_size, pattern_size.y) - y;
+                result.sub_textures.emplace_back();
+                auto& sub_texture = result.sub_textures.back();
+                sub_texture.sub_rect = sub_rect;
 
-                sub_texture.texture.loadFromImage(image, sub_texture.sub_rect);
+                sub_texture.texture.create(sub_rect.width, sub_rect.height);
+                sub_texture.texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
             }
         }
 
         return result;
     };
 
-    loading_future_ = std::async(std::launch::async, loading_func);
+    loading_job_.start(loading_func);
 }
 
 std::uint32_t PatternMode::enabled_tools() const
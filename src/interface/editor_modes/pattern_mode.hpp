@@ -28,13 +28,18 @@
 
 #include "mode_base.hpp"
 
+#include "components/pattern.hpp"
+#include "components/terrain_library.hpp"
+
+#include "core/latest_job.hpp"
+
 #include <qtimer.h> 
 
 #include <SFML/Graphics.hpp>
 
 #include <cstdint>
-#include <future>
 #include <list>
+#include <memory>
 
 NAMESPACE_INTERFACE_MODES
 
@@ -49,7 +54,9 @@ private:
     void initiate_pattern_building();
     void poll_loading_result();
 
+    virtual void on_initialize(scene::Scene* scene) override;
     virtual void on_activate() override;
+    virtual void on_deactivate() override;
     virtual std::uint32_t enabled_tools() const override;
 
     struct SubTexture
@@ -58,8 +65,24 @@ private:
         sf::IntRect sub_rect;
     };
 
+    // A freshly built pattern, with textures for the pages that differ from what is shown.
+    struct PatternPreview
+    {
+        std::shared_ptr<const components::Pattern> pattern;
+        components::TerrainPalette palette;
+
+        std::list<SubTexture> sub_textures;
+        bool replaces_all = true;
+    };
+
+    void apply_preview(PatternPreview preview);
+
+    // What the textures show, so that the next build only has to redo the pages that changed.
     std::list<SubTexture> sub_textures_;
-    std::future<std::list<SubTexture>> loading_future_;
+    std::shared_ptr<const components::Pattern> pattern_;
+    components::TerrainPalette palette_;
+
+    core::LatestJob<PatternPreview> loading_job_;
 
     QTimer poll_timer_;
 };
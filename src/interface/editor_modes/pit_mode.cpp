@@ -32,6 +32,27 @@
 
 NAMESPACE_INTERFACE_MODES
 
+// A CommandType::PitEdit record is the operation followed by the pit's rectangle.
+enum class PitOp
+    : std::uint8_t
+{
+    Define,
+    Undefine
+};
+
+static std::vector<std::uint8_t> make_pit_record(PitOp op, core::IntRect pit)
+{
+    std::vector<std::uint8_t> record;
+    CommandWriter writer(record);
+    writer.write(op);
+    writer.write(pit.left);
+    writer.write(pit.top);
+    writer.write(pit.width);
+    writer.write(pit.height);
+
+    return record;
+}
+
 PitMode::PitMode(EditorCanvas* canvas)
 : ModeBase(canvas)
 {
@@ -60,45 +81,56 @@ void PitMode::on_activate()
 void PitMode::define_pit(core::Vector2i start, core::Vector2i end)
 {
     core::IntRect pit(start, end, core::rect::from_points);
-    scene()->define_pit(pit);
+    perform_pit_edit("Define pit", make_pit_record(PitOp::Define, pit));
+}
 
-    auto command = [=]()
-    {
-        scene()->define_pit(pit);
-        pit_defined(pit);
-    };
+void PitMode::undefine_pit()
+{
 
-    auto undo_command = [=]()
+    if (auto pit = scene()->track().pit())
     {
-        scene()->undefine_pit();
-        pit_undefined();
-    };
+        perform_pit_edit("Pit undefined", make_pit_record(PitOp::Undefine, *pit));
+    }
+}
 
-    command();
-    canvas()->perform_action("Define pit", command, undo_command);
+void PitMode::execute_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::PitEdit) apply_pit_edit(reader, false);
 }
 
-void PitMode::undefine_pit()
+void PitMode::undo_command(CommandType type, CommandReader& reader)
 {
+    if (type == CommandType::PitEdit) apply_pit_edit(reader, true);
+}
 
-    if (auto pit_ptr = scene()->track().pit())
-    {
-        core::IntRect pit = *pit_ptr;
+void PitMode::perform_pit_edit(const std::string& description, std::vector<std::uint8_t> record)
+{
+    CommandReader reader(record.data(), record.size());
+    apply_pit_edit(reader, false);
 
-        auto command = [=]()
-        {
-            scene()->undefine_pit();
-            pit_undefined();
-        };
+    canvas()->perform_action(description, this, CommandType::PitEdit, std::move(record));
+}
 
-        auto undo_command = [=]()
-        {
-            scene()->define_pit(pit);
-            pit_defined(pit);
-        };
+void PitMode::apply_pit_edit(CommandReader& reader, bool undo)
+{
+    auto op = reader.read<PitOp>();
 
-        command();
-        canvas()->perform_action("Pit undefined", command, undo_command);
+    core::IntRect pit;
+    pit.left = reader.read<std::int32_t>();
+    pit.top = reader.read<std::int32_t>();
+    pit.width = reader.read<std::int32_t>();
+    pit.height = reader.read<std::int32_t>();
+
+    if ((op == PitOp::Define) != undo)
+    {
+        scene()->define_pit(pit);
+        pit_defined(pit);
+    }
+
+    else
+    {
+        scene()->undefine_pit();
+        pit_undefined();
     }
 }
 
@@ -28,6 +28,8 @@
 
 #include "mode_base.hpp"
 
+#include "../command.hpp"
+
 #include "core/vector2.hpp"
 #include "core/rect.hpp"
 
@@ -42,7 +44,7 @@
 NAMESPACE_INTERFACE_MODES
 
 struct PitMode
-    : ModeBase
+    : ModeBase, CommandTarget
 {
 public:
     PitMode(EditorCanvas* canvas);
@@ -53,10 +55,16 @@ public:
     void define_pit(core::Vector2i start, core::Vector2i end);
     void undefine_pit();
 
+    virtual void execute_command(CommandType type, CommandReader& reader) override;
+    virtual void undo_command(CommandType type, CommandReader& reader) override;
+
 private:
     void pit_defined(core::IntRect pit);
     void pit_undefined();
 
+    void apply_pit_edit(CommandReader& reader, bool undo);
+    void perform_pit_edit(const std::string& description, std::vector<std::uint8_t> record);
+
     virtual std::uint32_t enabled_tools() const override;
     virtual void on_activate() override;
 
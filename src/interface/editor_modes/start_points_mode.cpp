@@ -38,6 +38,46 @@
 
 NAMESPACE_INTERFACE_MODES
 
+// A CommandType::StartPointEdit record is a single operation: its kind, the start point index
+// and the affected start point. Replacing stores the old and the new list of start points.
+enum class StartPointOp
+    : std::uint8_t
+{
+    Append,
+    Insert,
+    Erase,
+    EraseLast,
+    Replace
+};
+
+static std::vector<std::uint8_t> make_start_point_record(StartPointOp op, std::size_t index,
+    const components::StartPoint& point = components::StartPoint())
+{
+    std::vector<std::uint8_t> record;
+    CommandWriter writer(record);
+    writer.write(op);
+    writer.write(static_cast<std::uint32_t>(index));
+    writer.write(point);
+
+    return record;
+}
+
+static std::vector<std::uint8_t> make_start_point_record(const std::vector<components::StartPoint>& old_points,
+    const std::vector<components::StartPoint>& new_points)
+{
+    std::vector<std::uint8_t> record;
+    CommandWriter writer(record);
+    writer.write(StartPointOp::Replace);
+
+    for (const auto* points : { &old_points, &new_points })
+    {
+        writer.write(static_cast<std::uint32_t>(points->size()));
+        for (const auto& point : *points) writer.write(point);
+    }
+
+    return record;
+}
+
 StartPointsMode::StartPointsMode(EditorCanvas* canvas)
 : ModeBase(canvas)
 {
@@ -166,20 +206,8 @@ void StartPointsMode::place_start_point(core::Vector2i position, core::Vector2i
         }
 
         auto index = selected_start_point_index_;
-        auto command = [=]()
-        {
-            if (!index) scene()->append_start_point(point);
-            else scene()->insert_start_point(*index, point);
-        };
-
-        auto undo_command = [=]()
-        {
-            if (!index) scene()->delete_last_start_point();
-            else scene()->delete_start_point(*index);
-        };
-
-        command();
-        canvas()->perform_action("Add start point", command, undo_command);
+        if (index) perform_start_point_edit("Add start point", make_start_point_record(StartPointOp::Insert, *index, point));
+        else perform_start_point_edit("Add start point", make_start_point_record(StartPointOp::Append, 0, point));
     }
 }
 
@@ -189,22 +217,8 @@ void StartPointsMode::delete_selected_start_point()
     if (selected_start_point_index_ && *selected_start_point_index_ < start_points.size())
     {
         std::size_t index = *selected_start_point_index_;
-        auto point = start_points[index];
-
-        auto command = [=]()
-        {
-            scene()->delete_start_point(index);
-            reload_start_points();
-        };
-
-        auto undo_command = [=]()
-        {
-            scene()->insert_start_point(index, point);
-            reload_start_points();
-        };
-
-        command();
-        canvas()->perform_action("Remove start point", command, undo_command);
+        perform_start_point_edit("Remove start point", 
+            make_start_point_record(StartPointOp::Erase, index, start_points[index]));
     }
 
     deselect_start_point();
@@ -215,22 +229,8 @@ void StartPointsMode::delete_last_start_point()
     const auto& start_points = scene()->track().start_points();
     if (!start_points.empty())
     {
-        auto point = start_points.back();
-
-        auto command = [=]()
-        {
-            scene()->delete_last_start_point();
-            reload_start_points();
-        };
-
-        auto undo_command = [=]()
-        {
-            scene()->append_start_point(point);
-            reload_start_points();
-        };
-
-        command();
-        canvas()->perform_action("Remove start point", command, undo_command);
+        perform_start_point_edit("Remove start point",
+            make_start_point_record(StartPointOp::EraseLast, start_points.size() - 1, start_points.back()));
     }
 
     deselect_start_point();
@@ -373,22 +373,58 @@ void StartPointsMode::mouse_release_event(QMouseEvent* event)
 
 void StartPointsMode::commit_start_point_changes(const std::string& description)
 {
-    const auto& new_state = start_points_;
-    auto command = [=]()
+    perform_start_point_edit(description, make_start_point_record(scene()->track().start_points(), start_points_));
+}
+
+void StartPointsMode::execute_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::StartPointEdit) apply_start_point_edit(reader, false);
+}
+
+void StartPointsMode::undo_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::StartPointEdit) apply_start_point_edit(reader, true);
+}
+
+void StartPointsMode::perform_start_point_edit(const std::string& description, std::vector<std::uint8_t> record)
+{
+    CommandReader reader(record.data(), record.size());
+    apply_start_point_edit(reader, false);
+
+    canvas()->perform_action(description, this, CommandType::StartPointEdit, std::move(record));
+}
+
+void StartPointsMode::apply_start_point_edit(CommandReader& reader, bool undo)
+{
+    auto op = reader.read<StartPointOp>();
+    if (op == StartPointOp::Replace)
     {
-        scene()->update_start_points(new_state);
-        reload_start_points();
-    };
+        std::vector<components::StartPoint> points;
+        for (bool apply : { undo, !undo })
+        {
+            points.resize(reader.read<std::uint32_t>());
+            for (auto& point : points) point = reader.read_start_point();
+
+            if (apply) scene()->update_start_points(points);
+        }
+    }
 
-    const auto& old_state = scene()->track().start_points();
-    auto undo_command = [=]()
+    else
     {
-        scene()->update_start_points(old_state);
-        reload_start_points();
-    };
+        std::size_t index = reader.read<std::uint32_t>();
+        auto point = reader.read_start_point();
+
+        if (op == StartPointOp::Append || op == StartPointOp::EraseLast)
+        {
+            if ((op == StartPointOp::Append) != undo) scene()->append_start_point(point);
+            else scene()->delete_last_start_point();
+        }
 
-    command();
-    canvas()->perform_action(description, command, undo_command);
+        else if ((op == StartPointOp::Insert) != undo) scene()->insert_start_point(index, point);
+        else scene()->delete_start_point(index);
+    }
+
+    reload_start_points();
 }
 
 void StartPointsMode::select_start_point(std::size_t index)
@@ -28,6 +28,8 @@
 
 #include "mode_base.hpp"
 
+#include "../command.hpp"
+
 #include "components/start_point.hpp"
 
 #include "core/vector2.hpp"
@@ -49,7 +51,7 @@ namespace graphics
 NAMESPACE_INTERFACE_MODES
 
 struct StartPointsMode
-    : ModeBase
+    : ModeBase, CommandTarget
 {
     StartPointsMode(EditorCanvas* canvas);
 
@@ -67,6 +69,9 @@ struct StartPointsMode
 
     virtual void tool_changed(EditorTool tool) override;
 
+    virtual void execute_command(CommandType type, CommandReader& reader) override;
+    virtual void undo_command(CommandType type, CommandReader& reader) override;
+
 private:
     virtual std::uint32_t enabled_tools() const override;
     virtual void on_activate() override;
@@ -77,6 +82,9 @@ private:
     void rotate_start_point_towards(std::size_t index, core::Vector2i target_point, bool fix_rotation);
 
     void commit_start_point_changes(const std::string& action_description);
+
+    void apply_start_point_edit(CommandReader& reader, bool undo);
+    void perform_start_point_edit(const std::string& description, std::vector<std::uint8_t> record);
     void reload_start_points();
 
     void update_start_point_info(std::size_t index);
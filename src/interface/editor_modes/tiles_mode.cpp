@@ -36,6 +36,7 @@
 #include "components/component_algorithms.hpp"
 
 #include "core/vector2.hpp"
+#include "core/polygon.hpp"
 
 #include <qapplication.h>
 
@@ -43,6 +44,8 @@
 #include <boost/iterator/transform_iterator.hpp>
 
 #include <numeric>
+#include <random>
+#include <unordered_map>
 
 NAMESPACE_INTERFACE_MODES
 
@@ -87,13 +90,25 @@ struct TilePlacementTool
 struct TileSelectionTool
 {
     std::unordered_map<components::TileId, core::IntRect> tile_group_bounding_boxes_;
-    std::map<std::size_t, components::Tile> selected_tiles_;
+    core::IndexSet selected_tiles_;
 
     boost::optional<std::size_t> active_index_;
     scene::DisplayLayer display_layer_;
     scene::DisplayLayer hover_layer_;
 
     sf::Shader selection_shader_;
+
+    // While the selection is being moved or rotated, the selected tiles are hidden in the scene
+    // and the selection display is drawn through the transformation instead.
+    boost::optional<std::size_t> preview_layer_id_;
+
+    std::vector<std::size_t> candidate_cache_;
+
+    // While an area is being dragged, the tiles in it are shown in a display layer indexed by
+    // their index in the layer, so that they can be added and removed as the area changes.
+    boost::optional<std::size_t> area_preview_layer_id_;
+    std::vector<std::size_t> area_preview_tiles_;
+    scene::DisplayLayer area_preview_layer_;
 };
 
 struct TileMovementTool
@@ -111,10 +126,261 @@ struct TileRotationTool
     bool enable_strict_rotations_ = true;
 };
 
+// The tiles are shared by every copy of the clipboard, undo records included, and never modified
+// once it's filled.
 struct TileClipboard
 {
+    bool empty() const { return !tiles_ || tiles_->empty(); }
+
     bool clear_ = false;
-    std::vector<components::Tile> tiles_;
+    std::shared_ptr<const std::vector<components::Tile>> tiles_;
+};
+
+// Records refer to the clipboard's tiles by handle, so that undoing cuts and pastes doesn't keep
+// a copy of the tiles around for every step. A handle lives for as long as some record holds it.
+// The session tag keeps records restored from the journal of an earlier run from resolving to
+// unrelated tiles, they get an empty clipboard instead.
+class TileClipboardTable
+{
+public:
+    using TileList = std::shared_ptr<const std::vector<components::Tile>>;
+
+    TileClipboardTable()
+        : session_(std::random_device()())
+    {
+    }
+
+    std::uint32_t session() const
+    {
+        return session_;
+    }
+
+    std::uint32_t acquire(const TileClipboard& clipboard)
+    {
+        if (clipboard.empty()) return 0;
+
+        auto handle_it = handles_.find(clipboard.tiles_.get());
+        if (handle_it != handles_.end())
+        {
+            ++entries_[handle_it->second].ref_count;
+            return handle_it->second;
+        }
+
+        auto handle = next_handle_++;
+        if (next_handle_ == 0) next_handle_ = 1;
+
+        entries_[handle] = { clipboard.tiles_, 1 };
+        handles_[clipboard.tiles_.get()] = handle;
+        return handle;
+    }
+
+    TileList find(std::uint32_t session, std::uint32_t handle) const
+    {
+        if (session != session_) return nullptr;
+
+        auto it = entries_.find(handle);
+        if (it == entries_.end()) return nullptr;
+
+        return it->second.tiles;
+    }
+
+    void release(std::uint32_t session, std::uint32_t handle)
+    {
+        if (session != session_) return;
+
+        auto it = entries_.find(handle);
+        if (it == entries_.end() || --it->second.ref_count != 0) return;
+
+        handles_.erase(it->second.tiles.get());
+        entries_.erase(it);
+    }
+
+private:
+    struct Entry
+    {
+        TileList tiles;
+        std::size_t ref_count;
+    };
+
+    std::uint32_t session_;
+    std::uint32_t next_handle_ = 1;
+    std::unordered_map<std::uint32_t, Entry> entries_;
+    std::unordered_map<const std::vector<components::Tile>*, std::uint32_t> handles_;
+};
+
+// A CommandType::TileEdit record holds the layer id, a list of tile operations, the selection
+// to restore after undoing and after executing, and optionally the clipboard for both cases.
+enum class TileEditOp
+    : std::uint8_t
+{
+    End,
+    Insert,
+    Erase,
+    Update,
+    Append,
+    Truncate
+};
+
+enum class TileEditSelection
+    : std::uint8_t
+{
+    Unchanged,
+    Ranges,
+    Range
+};
+
+// A cut stores the clipboard it produces as a reference to the tiles the record erases.
+enum class TileEditClipboard
+    : std::uint8_t
+{
+    Handle,
+    ErasedTiles
+};
+
+class TileEditWriter
+{
+public:
+    using Selection = core::IndexSet;
+
+    explicit TileEditWriter(std::size_t layer_id)
+    {
+        CommandWriter(ops_).write(static_cast<std::uint32_t>(layer_id));
+    }
+
+    void insert_tile(std::size_t tile_index, const components::Tile& tile)
+    {
+        CommandWriter writer = write_op(TileEditOp::Insert, tile_index);
+        writer.write(tile);
+    }
+
+    void erase_tile(std::size_t tile_index, const components::Tile& tile)
+    {
+        CommandWriter writer = write_op(TileEditOp::Erase, tile_index);
+        writer.write(tile);
+    }
+
+    void update_tile(std::size_t tile_index, const components::Tile& old_tile, const components::Tile& new_tile)
+    {
+        CommandWriter writer = write_op(TileEditOp::Update, tile_index);
+        writer.write(old_tile);
+        writer.write(new_tile);
+    }
+
+    template <typename TileIt>
+    void append_tiles(TileIt it, TileIt end)
+    {
+        write_tile_list(TileEditOp::Append, it, end);
+    }
+
+    // Removes the given tiles from the end of the layer, they're kept for undoing.
+    template <typename TileIt>
+    void truncate_tiles(TileIt it, TileIt end)
+    {
+        write_tile_list(TileEditOp::Truncate, it, end);
+    }
+
+    void set_selection(const Selection& undone, const Selection& executed)
+    {
+        selection_.clear();
+        write_selection(undone);
+        write_selection(executed);
+    }
+
+    void set_selection(const Selection& undone, std::size_t executed_index, std::size_t executed_count)
+    {
+        selection_.clear();
+        write_selection(undone);
+
+        CommandWriter writer(selection_);
+        writer.write(TileEditSelection::Range);
+        writer.write(static_cast<std::uint32_t>(executed_index));
+        writer.write(static_cast<std::uint32_t>(executed_count));
+    }
+
+    void set_clipboard(const TileClipboard& undone, const TileClipboard& executed, TileClipboardTable& table)
+    {
+        clipboard_.clear();
+        write_clipboard(undone, table);
+        write_clipboard(executed, table);
+    }
+
+    // After executing, the clipboard holds the erased tiles in index order, to be cleared once pasted.
+    void set_clipboard_to_erased_tiles(const TileClipboard& undone, TileClipboardTable& table)
+    {
+        clipboard_.clear();
+        write_clipboard(undone, table);
+
+        CommandWriter writer(clipboard_);
+        writer.write(static_cast<std::uint8_t>(true));
+        writer.write(TileEditClipboard::ErasedTiles);
+    }
+
+    std::vector<std::uint8_t> finish() const
+    {
+        std::vector<std::uint8_t> record = ops_;
+
+        CommandWriter writer(record);
+        writer.write(TileEditOp::End);
+
+        if (selection_.empty())
+        {
+            writer.write(TileEditSelection::Unchanged);
+            writer.write(TileEditSelection::Unchanged);
+        }
+
+        else
+        {
+            record.insert(record.end(), selection_.begin(), selection_.end());
+        }
+
+        writer.write(static_cast<std::uint8_t>(!clipboard_.empty()));
+        record.insert(record.end(), clipboard_.begin(), clipboard_.end());
+        return record;
+    }
+
+private:
+    CommandWriter write_op(TileEditOp op, std::size_t value)
+    {
+        CommandWriter writer(ops_);
+        writer.write(op);
+        writer.write(static_cast<std::uint32_t>(value));
+        return writer;
+    }
+
+    template <typename TileIt>
+    void write_tile_list(TileEditOp op, TileIt it, TileIt end)
+    {
+        CommandWriter writer = write_op(op, std::distance(it, end));
+        for (; it != end; ++it)
+        {
+            writer.write(*it);
+        }
+    }
+
+    void write_selection(const Selection& selection)
+    {
+        CommandWriter writer(selection_);
+        writer.write(TileEditSelection::Ranges);
+        writer.write(static_cast<std::uint32_t>(selection.ranges().size()));
+        for (const auto& range : selection.ranges())
+        {
+            writer.write(static_cast<std::uint32_t>(range.begin));
+            writer.write(static_cast<std::uint32_t>(range.end));
+        }
+    }
+
+    void write_clipboard(const TileClipboard& clipboard, TileClipboardTable& table)
+    {
+        CommandWriter writer(clipboard_);
+        writer.write(static_cast<std::uint8_t>(clipboard.clear_));
+        writer.write(TileEditClipboard::Handle);
+        writer.write(table.session());
+        writer.write(table.acquire(clipboard));
+    }
+
+    std::vector<std::uint8_t> ops_;
+    std::vector<std::uint8_t> selection_;
+    std::vector<std::uint8_t> clipboard_;
 };
 
 struct TilesMode::Features
@@ -124,8 +390,39 @@ struct TilesMode::Features
     TileMovementTool movement_;
     TileRotationTool rotation_;
     TileClipboard clipboard_;
+    TileClipboardTable clipboard_table_;
 };
 
+// Skips the layer id, the operations and the selections of a record, up to its clipboard.
+static void skip_to_tile_edit_clipboard(CommandReader& reader)
+{
+    reader.read<std::uint32_t>();
+
+    for (;;)
+    {
+        auto op = reader.read<TileEditOp>();
+        if (op == TileEditOp::End) break;
+
+        auto value = reader.read<std::uint32_t>();
+
+        std::size_t tile_count = op == TileEditOp::Update ? 2 : 1;
+        if (op == TileEditOp::Append || op == TileEditOp::Truncate) tile_count = value;
+
+        for (std::size_t n = 0; n != tile_count; ++n) reader.read_tile();
+    }
+
+    for (int n = 0; n != 2; ++n)
+    {
+        auto kind = reader.read<TileEditSelection>();
+
+        std::size_t value_count = 0;
+        if (kind == TileEditSelection::Range) value_count = 2;
+        else if (kind == TileEditSelection::Ranges) value_count = reader.read<std::uint32_t>() * 2;
+
+        for (std::size_t index = 0; index != value_count; ++index) reader.read<std::uint32_t>();
+    }
+}
+
 TilesMode::TilesMode(EditorCanvas* canvas)
     : ModeBase(canvas),
         features_(std::make_unique<Features>())
@@ -141,9 +438,9 @@ void TilesMode::render(sf::RenderTarget& render_target, sf::RenderStates render_
     auto tool = active_tool();
     auto selection_states = render_states;
 
-    if (tool == EditorTool::Movement)
+    auto offset = features_->movement_.fixed_offset_;
+    if (tool == EditorTool::Movement || offset.x != 0 || offset.y != 0)
     {
-        auto offset = features_->movement_.fixed_offset_;
         selection_states.transform.translate(offset.x, offset.y);
     }
 
@@ -163,10 +460,24 @@ void TilesMode::render(sf::RenderTarget& render_target, sf::RenderStates render_
     auto& tile_placement = features_->tile_placement_;
     auto& tile_selection = features_->tile_selection_;
 
+    if (tile_selection.preview_layer_id_)
+    {
+        scene::draw(tile_selection.display_layer_, render_target, selection_states);
+    }
+
     selection_states.shader = &tile_selection.selection_shader_;
     tile_selection.selection_shader_.setParameter("color", selected_tile_color);
 
-    scene::draw(tile_selection.display_layer_, render_target, selection_states);
+    if (tile_selection.area_preview_layer_id_)
+    {
+        scene::draw(tile_selection.area_preview_layer_, render_target, selection_states);
+    }
+
+    else
+    {
+        scene::draw(tile_selection.display_layer_, render_target, selection_states);
+    }
+
     tile_selection.selection_shader_.setParameter("color", selected_tile_hover_color);
 
     if (tool == EditorTool::TileSelection)
@@ -327,10 +638,19 @@ void TilesMode::mouse_release_event(QMouseEvent* event)
         if (tool == EditorTool::Movement)
         {
             auto& movement = features_->movement_;
-            if (movement.fixed_offset_.x != 0 && movement.fixed_offset_.y != 0)
+            if (movement.fixed_offset_.x != 0 || movement.fixed_offset_.y != 0)
             {
                 commit_tile_movement();
             }
+
+            // Nothing to commit, but the preview may have started already.
+            else
+            {
+                end_selection_preview();
+                tiles_movement_finished();
+
+                movement = {};
+            }
         }
 
         if (tool == EditorTool::Rotation)
@@ -340,6 +660,15 @@ void TilesMode::mouse_release_event(QMouseEvent* event)
             {
                 commit_tile_rotation();
             }
+
+            else
+            {
+                end_selection_preview();
+                tiles_rotation_finished();
+
+                rotation.real_rotation_ = {};
+                rotation.fixed_rotation_ = {};
+            }
         }
     }
 }
@@ -556,20 +885,10 @@ void TilesMode::place_tile()
             layer_id = acquire_level_layer(2);
         }
 
-        auto command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            scene()->append_tile(layer_id, tile);
-        };
-
-        auto undo_command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            scene()->delete_last_tile(layer_id);
-        };
+        TileEditWriter record(layer_id);
+        record.append_tiles(&tile, &tile + 1);
 
-        command();
-        canvas()->perform_action("Place tile", command, undo_command);
+        perform_tile_edit("Place tile", record.finish());
     }
 }
 
@@ -596,7 +915,7 @@ void TilesMode::place_tile_before()
         std::size_t tile_index = 0;
         if (!tile_selection.selected_tiles_.empty())
         {
-            tile_index = tile_selection.selected_tiles_.begin()->first;
+            tile_index = tile_selection.selected_tiles_.front();
         }
 
         else if (!selected_layer->tiles.empty())
@@ -604,20 +923,10 @@ void TilesMode::place_tile_before()
             tile_index = selected_layer->tiles.size() - 1;
         }
 
-        auto command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            scene()->insert_tile(layer_id, tile_index, tile);
-        };
-
-        auto undo_command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            scene()->delete_tile(layer_id, tile_index);
-        };
+        TileEditWriter record(layer_id);
+        record.insert_tile(tile_index, tile);
 
-        command();
-        canvas()->perform_action("Place tile", command, undo_command);
+        perform_tile_edit("Place tile", record.finish());
     }
 }
 
@@ -660,8 +969,16 @@ void TilesMode::update_tile_selection(core::Vector2i track_point)
     auto& tile_selection = features_->tile_selection_;
     const auto& bounding_boxes = tile_selection.tile_group_bounding_boxes_;
 
-    for (auto tile_it = tile_list.begin(); tile_it != tile_list.end(); ++tile_it)
+    // Only test the tiles that the layer's grid says could be at this point.
+    auto& candidates = tile_selection.candidate_cache_;
+    candidates.clear();
+    scene()->tile_grid(selected_layer.id()).find_tiles(track_point, candidates);
+
+    for (auto tile_index : candidates)
     {
+        if (tile_index >= tile_list.size()) continue;
+
+        auto tile_it = tile_list.begin() + tile_index;
         auto tile_group = tile_library.tile_group(tile_it->id);
         if (!tile_group) continue;
 
@@ -716,9 +1033,10 @@ void TilesMode::rebuild_tile_selection_display()
     const auto& tile_library = scene()->tile_library();
     const auto& tile_mapping = scene()->tile_mapping();
 
-    auto transform_func = [&](const std::pair<const std::size_t, components::Tile>& pair) -> const components::Tile&
+    const auto& tiles = selected_layer->tiles;
+    auto transform_func = [&](std::size_t tile_index) -> const components::Tile&
     {
-        return pair.second;
+        return tiles[tile_index];
     };
 
     auto begin = boost::make_transform_iterator(tile_selection.selected_tiles_.begin(), transform_func);
@@ -738,18 +1056,14 @@ void TilesMode::select_active_tile()
         std::size_t index = *tile_selection.active_index_;
         std::size_t layer_id = selected_layer.id();
 
-        const auto& tile = selected_layer->tiles[index];
+        auto old_selection = tile_selection.selected_tiles_;
 
-        const auto& old_selection = tile_selection.selected_tiles_;
-        auto undo_command = [=]()
-        {
-            select_tiles(old_selection);
-        };
+        end_selection_preview();
 
         auto key_modifiers = QApplication::queryKeyboardModifiers();
         if (key_modifiers & Qt::ControlModifier)
         {
-            tile_selection.selected_tiles_.emplace(index, tile);
+            tile_selection.selected_tiles_.insert(index);
         }
 
         else if (key_modifiers & Qt::AltModifier)
@@ -759,23 +1073,18 @@ void TilesMode::select_active_tile()
 
         else
         {
-            tile_selection.selected_tiles_.clear();
-            tile_selection.selected_tiles_.emplace(index, tile);
+            tile_selection.selected_tiles_ = core::IndexSet(index, index + 1);
         }
 
-        const auto& new_selection = tile_selection.selected_tiles_;
-        auto command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            select_tiles(new_selection);
-        };
+        TileEditWriter record(layer_id);
+        record.set_selection(old_selection, tile_selection.selected_tiles_);
 
         rebuild_tile_selection_display();
         compute_rotation_origin();
 
         tile_selection_changed();
 
-        canvas()->perform_action("Select tiles", command, undo_command);
+        perform_tile_edit("Select tiles", record.finish(), false);
     }
 }
 
@@ -791,8 +1100,41 @@ void TilesMode::tile_selection_changed()
     tile_selection_changed(tile_selection.selected_tiles_.size());
 }
 
-void TilesMode::select_tiles(const std::map<std::size_t, components::Tile>& selection)
+void TilesMode::begin_selection_preview()
 {
+    auto& tile_selection = features_->tile_selection_;
+    auto selected_layer = canvas()->selected_layer();
+    if (selected_layer && !tile_selection.preview_layer_id_)
+    {
+        std::size_t layer_id = selected_layer.id();
+        for (auto tile_index : tile_selection.selected_tiles_)
+        {
+            scene()->hide_tile(layer_id, tile_index);
+        }
+
+        tile_selection.preview_layer_id_ = layer_id;
+    }
+}
+
+void TilesMode::end_selection_preview()
+{
+    auto& tile_selection = features_->tile_selection_;
+    if (tile_selection.preview_layer_id_)
+    {
+        std::size_t layer_id = *tile_selection.preview_layer_id_;
+        for (auto tile_index : tile_selection.selected_tiles_)
+        {
+            scene()->show_tile(layer_id, tile_index);
+        }
+
+        tile_selection.preview_layer_id_ = boost::none;
+    }
+}
+
+void TilesMode::select_tiles(const core::IndexSet& selection)
+{
+    end_selection_preview();
+
     features_->tile_selection_.selected_tiles_ = selection;
 
     rebuild_tile_selection_display();
@@ -806,14 +1148,10 @@ void TilesMode::select_tile_range(std::size_t tile_index, std::size_t tile_count
     auto& tile_selection = features_->tile_selection_;
     if (auto selected_layer = canvas()->selected_layer())
     {
-        tile_selection.selected_tiles_.clear();
+        end_selection_preview();
 
-        const auto& tiles = selected_layer->tiles;
-        std::size_t end = std::min(tile_index + tile_count, tiles.size());
-        for (; tile_index != end; ++tile_index)
-        {
-            tile_selection.selected_tiles_.emplace(tile_index, tiles[tile_index]);
-        }
+        std::size_t end = std::min(tile_index + tile_count, selected_layer->tiles.size());
+        tile_selection.selected_tiles_ = core::IndexSet(tile_index, end);
 
         rebuild_tile_selection_display();
         compute_rotation_origin();
@@ -822,24 +1160,120 @@ void TilesMode::select_tile_range(std::size_t tile_index, std::size_t tile_count
     }
 }
 
-void TilesMode::select_tiles_in_area(core::IntRect area)
+void TilesMode::find_tiles_in_area(core::IntRect area, const std::vector<core::Vector2i>& polygon,
+    std::vector<std::size_t>& result)
+{
+    result.clear();
+
+    auto selected_layer = canvas()->selected_layer();
+    if (!selected_layer) return;
+
+    const auto& tiles = selected_layer->tiles;
+    scene()->tile_grid(selected_layer.id()).find_tiles(area, result);
+
+    auto new_end = std::remove_if(result.begin(), result.end(), 
+        [&](std::size_t tile_index)
+    {
+        if (tile_index >= tiles.size()) return true;
+
+        auto position = tiles[tile_index].position;
+        return !core::contains(area, position) || (!polygon.empty() && !core::polygon_contains(polygon, position));
+    });
+
+    result.erase(new_end, result.end());
+}
+
+void TilesMode::preview_tiles_in_area(core::IntRect area, const std::vector<core::Vector2i>& polygon)
+{
+    auto& tile_selection = features_->tile_selection_;
+    auto selected_layer = canvas()->selected_layer();
+    if (!selected_layer) return;
+
+    if (tile_selection.area_preview_layer_id_ != selected_layer.id())
+    {
+        discard_area_selection_preview();
+        tile_selection.area_preview_layer_id_ = selected_layer.id();
+    }
+
+    auto& candidates = tile_selection.candidate_cache_;
+    find_tiles_in_area(area, polygon, candidates);
+
+    auto& preview_tiles = tile_selection.area_preview_tiles_;
+    auto& preview_layer = tile_selection.area_preview_layer_;
+
+    // Both lists are sorted, so the difference can be found in a single pass.
+    const auto& tiles = selected_layer->tiles;
+    const auto& tile_library = scene()->tile_library();
+    const auto& tile_mapping = scene()->tile_mapping();
+
+    auto old_it = preview_tiles.begin(), old_end = preview_tiles.end();
+    auto new_it = candidates.begin(), new_end = candidates.end();
+    while (old_it != old_end || new_it != new_end)
+    {
+        if (new_it == new_end || (old_it != old_end && *old_it < *new_it))
+        {
+            preview_layer.erase_tile_vertices(*old_it++);
+        }
+
+        else if (old_it == old_end || *new_it < *old_it)
+        {
+            std::size_t tile_index = *new_it++;
+            if (tile_index >= preview_layer.tile_count()) preview_layer.insert_tile(tile_index);
+
+            const auto& tile = tiles[tile_index];
+            preview_layer.replace_tile_vertices(tile_index, 
+                scene::create_display_layer(&tile, &tile + 1, tile_library, tile_mapping));
+        }
+
+        else
+        {
+            ++old_it;
+            ++new_it;
+        }
+    }
+
+    preview_tiles.swap(candidates);
+}
+
+void TilesMode::discard_area_selection_preview()
+{
+    auto& tile_selection = features_->tile_selection_;
+    tile_selection.area_preview_layer_id_ = boost::none;
+    tile_selection.area_preview_tiles_.clear();
+    tile_selection.area_preview_layer_.clear();
+}
+
+void TilesMode::select_tiles_in_area(core::IntRect area, const std::vector<core::Vector2i>& polygon)
 {
     auto& tile_selection = features_->tile_selection_;
     if (auto selected_layer = canvas()->selected_layer())
     {
+        end_selection_preview();
+
+        auto& candidates = tile_selection.candidate_cache_;
+        find_tiles_in_area(area, polygon, candidates);
+
         auto& selected_tiles = tile_selection.selected_tiles_;
         selected_tiles.clear();
 
-        for (std::size_t tile_index = 0; tile_index != selected_layer->tiles.size(); ++tile_index)
+        for (auto tile_index : candidates)
         {
-            const auto& tile = selected_layer->tiles[tile_index];
-            if (core::contains(area, tile.position))
-            {
-                selected_tiles.emplace(tile_index, tile);
-            }
+            selected_tiles.push_back(tile_index);
         }
 
-        rebuild_tile_selection_display();
+        // If the area was dragged out, its preview already shows exactly these tiles.
+        if (tile_selection.area_preview_layer_id_ == selected_layer.id() &&
+            tile_selection.area_preview_tiles_ == candidates)
+        {
+            tile_selection.display_layer_ = std::move(tile_selection.area_preview_layer_);
+        }
+
+        else
+        {
+            rebuild_tile_selection_display();
+        }
+
+        discard_area_selection_preview();
         compute_rotation_origin();
 
         tile_selection_changed();
@@ -913,18 +1347,9 @@ void TilesMode::move_selected_tiles(core::Vector2i offset, bool fix_position)
             offset = new_offset - movement.fixed_offset_;
         }
 
-        double offset_x = static_cast<double>(offset.x);
-        double offset_y = static_cast<double>(offset.y);
-
-        auto& tile_selection = features_->tile_selection_;
-
-        for (auto& tile : tile_selection.selected_tiles_)
-        {
-            tile.second.position.x += offset_x;
-            tile.second.position.y += offset_y;
-
-            scene()->update_tile_preview(selected_layer.id(), tile.first, tile.second);
-        }
+        // The scene is only updated once the movement is committed, until then the selection
+        // display is drawn with the offset.
+        begin_selection_preview();
 
         movement.real_offset_ = new_real_offset;
         movement.fixed_offset_ = new_offset;
@@ -939,37 +1364,22 @@ void TilesMode::commit_tile_movement()
     {
         std::size_t layer_id = selected_layer.id();
 
-        const auto& new_state = features_->tile_selection_.selected_tiles_;
-        auto prior_state = new_state;
-
-        for (auto& pair : prior_state)
-        {
-            pair.second = selected_layer->tiles[pair.first];
-        }
-
-        auto command = [=]()
-        {
-            for (auto& pair : new_state)
-            {
-                scene()->update_tile(layer_id, pair.first, pair.second);
-            }
-
-            canvas()->select_layer(layer_id);
-            select_tiles(new_state);
-        };
+        const auto& tiles = selected_layer->tiles;
+        const auto& selection = features_->tile_selection_.selected_tiles_;
+        auto offset = features_->movement_.fixed_offset_;
 
-        auto undo_command = [=]()
+        TileEditWriter record(layer_id);
+        for (auto tile_index : selection)
         {
-            for (const auto& pair : prior_state)
-            {
-                scene()->update_tile(layer_id, pair.first, pair.second);
-            }
+            if (tile_index >= tiles.size()) break;
 
-            select_tiles(prior_state);
-        };
+            auto tile = tiles[tile_index];
+            tile.position += offset;
+            record.update_tile(tile_index, tiles[tile_index], tile);
+        }
 
-        command();
-        canvas()->perform_action("Move tiles", command, undo_command);
+        record.set_selection(selection, selection);
+        perform_tile_edit("Move tiles", record.finish());
         tiles_movement_finished();
 
         features_->movement_ = {};
@@ -981,7 +1391,6 @@ void TilesMode::rotate_selected_tiles(core::Rotation<double> rotation_delta, boo
     if (auto selected_layer = canvas()->selected_layer())
     {
         auto& rotation = features_->rotation_;
-        auto origin = rotation.origin_;
 
         auto new_rotation = rotation.fixed_rotation_ + rotation_delta;
         auto new_real_rotation = rotation.real_rotation_ + rotation_delta;
@@ -994,22 +1403,8 @@ void TilesMode::rotate_selected_tiles(core::Rotation<double> rotation_delta, boo
             rotation_delta = new_rotation - rotation.fixed_rotation_;
         }
 
-        const auto& tiles = selected_layer->tiles;
-
-        auto& tile_selection = features_->tile_selection_;
-        for (auto& tile : tile_selection.selected_tiles_)
-        {
-            if (tile.first >= tiles.size()) continue;
-
-            const auto& layer_tile = tiles[tile.first];            
-            tile.second.rotation = layer_tile.rotation + new_rotation;
-
-            auto position = core::vector2_cast<double>(layer_tile.position);
-            auto offset = core::transform_point(position - origin, new_rotation);
-            tile.second.position = core::vector2_round<std::int32_t>(origin + offset);
-
-            scene()->update_tile_preview(selected_layer.id(), tile.first, tile.second);
-        }
+        // Like a movement, the rotation is only applied to the scene once it's committed.
+        begin_selection_preview();
 
         rotation.real_rotation_ = new_real_rotation;
         rotation.fixed_rotation_ = new_rotation;
@@ -1024,44 +1419,32 @@ void TilesMode::commit_tile_rotation()
     {
         std::size_t layer_id = selected_layer.id();
 
-        auto& tile_selection = features_->tile_selection_;
-        const auto& new_state = tile_selection.selected_tiles_;
-        auto prior_state = tile_selection.selected_tiles_;
-
-        for (auto& pair : prior_state)
-        {
-            pair.second = selected_layer->tiles[pair.first];
-        }
+        const auto& tiles = selected_layer->tiles;
+        const auto& selection = features_->tile_selection_.selected_tiles_;
+        auto origin = features_->rotation_.origin_;
+        auto rotation = features_->rotation_.fixed_rotation_;
 
-        auto command = [=]()
+        TileEditWriter record(layer_id);
+        for (auto tile_index : selection)
         {
-            for (auto& pair : new_state)
-            {
-                scene()->update_tile(layer_id, pair.first, pair.second);
-            }
+            if (tile_index >= tiles.size()) break;
 
-            canvas()->select_layer(layer_id);
-            select_tiles(new_state);
-        };
-
-        auto undo_command = [=]()
-        {
-            for (const auto& pair : prior_state)
-            {
-                scene()->update_tile(layer_id, pair.first, pair.second);
-            }
+            const auto& layer_tile = tiles[tile_index];
+            auto position = core::vector2_cast<double>(layer_tile.position);
+            auto offset = core::transform_point(position - origin, rotation);
 
-            select_tiles(prior_state);
-        };
+            auto tile = layer_tile;
+            tile.rotation = core::Rotation<double>(layer_tile.rotation) + rotation;
+            tile.position = core::vector2_round<std::int32_t>(origin + offset);
+            record.update_tile(tile_index, layer_tile, tile);
+        }
 
-        command();
-        canvas()->perform_action("Rotate tiles", command, undo_command);
+        record.set_selection(selection, selection);
+        perform_tile_edit("Rotate tiles", record.finish());
         tiles_rotation_finished();
 
         features_->rotation_.real_rotation_ = {};
         features_->rotation_.fixed_rotation_ = {};
-
-        rebuild_tile_selection_display();
     }
 }
 
@@ -1103,22 +1486,12 @@ void TilesMode::delete_last_tile()
     if (selected_layer && !selected_layer->tiles.empty())
     {
         std::size_t layer_id = selected_layer.id();
-        auto tile = selected_layer->tiles.back();
-
-        auto command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            scene()->delete_last_tile(layer_id);
-        };
+        const auto& tile = selected_layer->tiles.back();
 
-        auto undo_command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            scene()->append_tile(layer_id, tile);
-        };
+        TileEditWriter record(layer_id);
+        record.truncate_tiles(&tile, &tile + 1);
 
-        command();
-        canvas()->perform_action("Remove tile", command, undo_command);
+        perform_tile_edit("Remove tile", record.finish());
     }
 }
 
@@ -1129,34 +1502,19 @@ void TilesMode::delete_selection()
     {
         auto& tile_selection = features_->tile_selection_;
         const auto& selection = tile_selection.selected_tiles_;
+        const auto& tiles = selected_layer->tiles;
         std::size_t layer_id = selected_layer.id();
 
-        auto command = [=]()
+        // Erasing from the back keeps the other indices valid, and undoing
+        // reinserts the tiles front to back.
+        TileEditWriter record(layer_id);
+        for (auto it = selection.rbegin(); it != selection.rend(); ++it)
         {
-            canvas()->select_layer(layer_id);
-
-            for (auto it = selection.rbegin(); it != selection.rend(); ++it)
-            {
-                scene()->delete_tile(layer_id, it->first);
-            }
-
-            select_tiles({});
-        };
-
-        auto undo_command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-
-            for (auto it = selection.rbegin(); it != selection.rend(); ++it)
-            {
-                scene()->insert_tile(layer_id, it->first, it->second);
-            }
-
-            select_tiles(selection);
-        };
+            if (*it < tiles.size()) record.erase_tile(*it, tiles[*it]);
+        }
 
-        command();
-        canvas()->perform_action("Delete tiles", command, undo_command);
+        record.set_selection(selection, {});
+        perform_tile_edit("Delete tiles", record.finish());
     }
 }
 
@@ -1168,48 +1526,17 @@ void TilesMode::cut_selection()
 
         auto& tile_selection = features_->tile_selection_;
         const auto& selection = tile_selection.selected_tiles_;
-        auto command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-
-            features_->clipboard_.clear_ = true;
-            features_->clipboard_.tiles_.clear();
-
-
-            for (auto it = selection.rbegin(); it != selection.rend(); ++it)
-            {
-                scene()->delete_tile(layer_id, it->first);
-            }
-
-            for (const auto& tile : selection)
-            {
-                features_->clipboard_.tiles_.push_back(tile.second);
-            }
-
-            clipboard_filled();
-
-            select_tiles({});
-        };
+        const auto& tiles = selected_layer->tiles;
 
-        const auto& clipboard = features_->clipboard_;
-        auto undo_command = [=]()
+        TileEditWriter record(layer_id);
+        for (auto it = selection.rbegin(); it != selection.rend(); ++it)
         {
-            canvas()->select_layer(layer_id);
-
-            features_->clipboard_ = clipboard;
-            if (clipboard.tiles_.size() == 0) clipboard_emptied();
-            else clipboard_filled();
-
-            for (auto it = selection.rbegin(); it != selection.rend(); ++it)
-            {
-                scene()->insert_tile(layer_id, it->first, it->second);
-            }
-
-            select_tiles(selection);
-        };
+            if (*it < tiles.size()) record.erase_tile(*it, tiles[*it]);
+        }
 
-        command();
-        canvas()->perform_action("Cut tiles", command, undo_command);
+        record.set_selection(selection, {});
+        record.set_clipboard_to_erased_tiles(features_->clipboard_, features_->clipboard_table_);
+        perform_tile_edit("Cut tiles", record.finish());
     }
 }
 
@@ -1217,16 +1544,21 @@ void TilesMode::copy_selection()
 {
     if (auto selected_layer = canvas()->selected_layer())
     {
-        auto& clipboard = features_->clipboard_;
-        clipboard.clear_ = false;
-        clipboard.tiles_.clear();
+        const auto& tiles = selected_layer->tiles;
+        const auto& selection = features_->tile_selection_.selected_tiles_;
 
-        for (const auto& tile : features_->tile_selection_.selected_tiles_)
+        auto clipboard_tiles = std::make_shared<std::vector<components::Tile>>();
+        clipboard_tiles->reserve(selection.size());
+        for (auto tile_index : selection)
         {
-            clipboard.tiles_.push_back(tile.second);
+            if (tile_index < tiles.size()) clipboard_tiles->push_back(tiles[tile_index]);
         }
 
-        if (!clipboard.tiles_.empty())
+        auto& clipboard = features_->clipboard_;
+        clipboard.clear_ = false;
+        clipboard.tiles_ = std::move(clipboard_tiles);
+
+        if (!clipboard.empty())
         {
             clipboard_filled();
         }
@@ -1241,48 +1573,39 @@ void TilesMode::paste_clipboard(core::Vector2i position)
 
         const auto& clipboard = features_->clipboard_;
         const auto& selection = features_->tile_selection_.selected_tiles_;
+        if (clipboard.empty()) return;
 
-        core::Vector2i average_position = std::accumulate(clipboard.tiles_.begin(), clipboard.tiles_.end(), core::Vector2i(),
+        const auto& clipboard_tiles = *clipboard.tiles_;
+        core::Vector2i average_position = std::accumulate(clipboard_tiles.begin(), clipboard_tiles.end(), core::Vector2i(),
             [](core::Vector2i pos, const components::Tile& tile)
         {
             return pos + tile.position;
         });
         
-        average_position /= clipboard.tiles_.size();
+        average_position /= clipboard_tiles.size();
 
-        auto command = [=]()
+        // The tiles are offset as they're written, the clipboard itself is left untouched.
+        auto transform_func = [=](components::Tile tile)
         {
-            std::size_t tile_index = selected_layer->tiles.size();
-
-            for (auto tile : clipboard.tiles_)
-            {
-                tile.position = position + tile.position - average_position;
-                scene()->append_tile(layer_id, tile);
-            }
-
-            if (clipboard.clear_)
-            {
-                features_->clipboard_.tiles_.clear();
-                clipboard_emptied();
-            }
-
-            canvas()->select_layer(layer_id);
-            select_tile_range(tile_index, clipboard.tiles_.size());
+            tile.position = position + tile.position - average_position;
+            return tile;
         };
 
-        auto undo_command = [=]()
-        {
-            features_->clipboard_ = clipboard;
-            clipboard_filled();
+        auto begin = boost::make_transform_iterator(clipboard_tiles.begin(), transform_func);
+        auto end = boost::make_transform_iterator(clipboard_tiles.end(), transform_func);
 
-            scene()->delete_last_tiles(selected_layer.id(), clipboard.tiles_.size());
+        TileEditWriter record(layer_id);
+        record.append_tiles(begin, end);
+        record.set_selection(selection, selected_layer->tiles.size(), clipboard_tiles.size());
 
-            canvas()->select_layer(layer_id);
-            select_tiles(selection);
-        };
+        if (clipboard.clear_)
+        {
+            TileClipboard new_clipboard;
+            new_clipboard.clear_ = true;
+            record.set_clipboard(clipboard, new_clipboard, features_->clipboard_table_);
+        }
 
-        command();
-        canvas()->perform_action("Paste tiles", command, undo_command);
+        perform_tile_edit("Paste tiles", record.finish());
     }
 }
 
@@ -1293,22 +1616,11 @@ void TilesMode::deselect()
     if (!tile_selection.selected_tiles_.empty())
     {
         std::size_t layer_id = selected_layer.id();
-        const auto& old_selection = tile_selection.selected_tiles_;
 
-        auto command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            select_tiles({});
-        };
+        TileEditWriter record(layer_id);
+        record.set_selection(tile_selection.selected_tiles_, {});
 
-        auto undo_command = [=]()
-        {
-            canvas()->select_layer(layer_id);
-            select_tiles(old_selection);
-        };
-
-        command();
-        canvas()->perform_action("Deselect tiles", command, undo_command);
+        perform_tile_edit("Deselect tiles", record.finish());
     }
 }
 
@@ -1347,21 +1659,249 @@ void TilesMode::fill_area(const FillProperties& properties)
         }
 
         std::vector<components::Tile> added_tiles = scene()->fill_area(layer_id, tile_group, prop);
-        std::size_t added_tile_count = added_tiles.size();
 
-        auto command = [=]()
+        TileEditWriter record(layer_id);
+        record.append_tiles(added_tiles.begin(), added_tiles.end());
+
+        perform_tile_edit("Fill area", record.finish(), false);
+    }
+}
+
+void TilesMode::execute_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::TileEdit) apply_tile_edit(reader, false);
+}
+
+void TilesMode::undo_command(CommandType type, CommandReader& reader)
+{
+    if (type == CommandType::TileEdit) apply_tile_edit(reader, true);
+}
+
+void TilesMode::release_command(CommandType type, CommandReader& reader)
+{
+    if (type != CommandType::TileEdit) return;
+
+    skip_to_tile_edit_clipboard(reader);
+    if (reader.read<std::uint8_t>() == 0) return;
+
+    for (int n = 0; n != 2; ++n)
+    {
+        reader.read<std::uint8_t>();
+        if (reader.read<TileEditClipboard>() == TileEditClipboard::Handle)
         {
-            canvas()->select_layer(layer_id);
-            scene()->append_tiles(layer_id, added_tiles.begin(), added_tiles.end());
-        };
+            auto session = reader.read<std::uint32_t>();
+            features_->clipboard_table_.release(session, reader.read<std::uint32_t>());
+        }
+    }
+}
+
+void TilesMode::perform_tile_edit(const std::string& description, std::vector<std::uint8_t> record, bool execute)
+{
+    if (execute)
+    {
+        CommandReader reader(record.data(), record.size());
+        apply_tile_edit(reader, false);
+    }
+
+    canvas()->perform_action(description, this, CommandType::TileEdit, std::move(record));
+}
 
-        auto undo_command = [=]()
+void TilesMode::apply_tile_edit(CommandReader& reader, bool undo)
+{
+    std::size_t layer_id = reader.read<std::uint32_t>();
+    canvas()->select_layer(layer_id);
+
+    // Consecutive insertions, erasures and updates are collected and handed to the scene in bulk.
+    // Erasures are recorded from back to front and insertions from front to back, which is what
+    // makes a run of them equivalent to a single bulk operation.
+    enum class BulkOp
+    {
+        None,
+        Insert,
+        Erase,
+        Update
+    };
+
+    BulkOp bulk_op = BulkOp::None;
+    std::vector<std::size_t> bulk_indices;
+    std::vector<components::Tile> bulk_tiles;
+
+    // Kept for a cut, whose clipboard refers to the erased tiles.
+    std::vector<components::Tile> erased_tiles;
+
+    auto flush_bulk_op = [&]()
+    {
+        if (bulk_op == BulkOp::Insert) scene()->insert_tiles(layer_id, bulk_indices, bulk_tiles);
+
+        else if (bulk_op == BulkOp::Erase)
         {
-            canvas()->select_layer(layer_id);
-            scene()->delete_last_tiles(layer_id, added_tile_count);
-        };
+            std::reverse(bulk_indices.begin(), bulk_indices.end());
+            scene()->delete_tiles(layer_id, bulk_indices);
+        }
 
-        canvas()->perform_action("Fill area", command, undo_command);
+        else if (bulk_op == BulkOp::Update) scene()->update_tiles(layer_id, bulk_indices, bulk_tiles);
+
+        bulk_op = BulkOp::None;
+        bulk_indices.clear();
+        bulk_tiles.clear();
+    };
+
+    auto add_bulk_op = [&](BulkOp op, std::size_t tile_index, const components::Tile& tile)
+    {
+        bool continues_run = op == bulk_op && (op == BulkOp::Update ||
+            (op == BulkOp::Insert && tile_index > bulk_indices.back()) ||
+            (op == BulkOp::Erase && tile_index < bulk_indices.back()));
+
+        if (!continues_run) flush_bulk_op();
+
+        bulk_op = op;
+        bulk_indices.push_back(tile_index);
+        bulk_tiles.push_back(tile);
+    };
+
+    auto apply_op = [&](TileEditOp op, std::size_t value)
+    {
+        if (op == TileEditOp::Insert || op == TileEditOp::Erase)
+        {
+            auto tile = reader.read_tile();
+            add_bulk_op((op == TileEditOp::Insert) != undo ? BulkOp::Insert : BulkOp::Erase, value, tile);
+
+            if (op == TileEditOp::Erase && !undo) erased_tiles.push_back(tile);
+            return;
+        }
+
+        if (op == TileEditOp::Update)
+        {
+            auto old_tile = reader.read_tile();
+            auto new_tile = reader.read_tile();
+            add_bulk_op(BulkOp::Update, value, undo ? old_tile : new_tile);
+            return;
+        }
+
+        flush_bulk_op();
+
+        if ((op == TileEditOp::Append) != undo)
+        {
+            std::vector<components::Tile> tiles(value);
+            for (auto& tile : tiles) tile = reader.read_tile();
+
+            scene()->append_tiles(layer_id, tiles.begin(), tiles.end());
+        }
+
+        else
+        {
+            scene()->delete_last_tiles(layer_id, value);
+        }
+    };
+
+    // Undoing goes through the operations in reverse, so their positions have to be known first.
+    std::vector<std::size_t> op_positions;
+    for (;;)
+    {
+        std::size_t position = reader.position();
+        auto op = reader.read<TileEditOp>();
+        if (op == TileEditOp::End) break;
+
+        auto value = reader.read<std::uint32_t>();
+        if (!undo)
+        {
+            apply_op(op, value);
+            continue;
+        }
+
+        op_positions.push_back(position);
+
+        std::size_t tile_count = op == TileEditOp::Update ? 2 : 1;
+        if (op == TileEditOp::Append || op == TileEditOp::Truncate) tile_count = value;
+
+        for (std::size_t n = 0; n != tile_count; ++n) reader.read_tile();
+    }
+
+    if (undo)
+    {
+        std::size_t end_position = reader.position();
+        for (auto it = op_positions.rbegin(); it != op_positions.rend(); ++it)
+        {
+            reader.seek(*it);
+            auto op = reader.read<TileEditOp>();
+            apply_op(op, reader.read<std::uint32_t>());
+        }
+
+        reader.seek(end_position);
+    }
+
+    flush_bulk_op();
+
+    auto read_selection = [&](bool apply)
+    {
+        auto kind = reader.read<TileEditSelection>();
+        if (kind == TileEditSelection::Unchanged) return;
+
+        if (kind == TileEditSelection::Range)
+        {
+            std::size_t tile_index = reader.read<std::uint32_t>();
+            std::size_t tile_count = reader.read<std::uint32_t>();
+            if (apply) select_tile_range(tile_index, tile_count);
+            return;
+        }
+
+        core::IndexSet selection;
+        std::size_t range_count = reader.read<std::uint32_t>();
+        for (std::size_t n = 0; n != range_count; ++n)
+        {
+            std::size_t begin = reader.read<std::uint32_t>();
+            std::size_t end = reader.read<std::uint32_t>();
+            selection.insert_range(begin, end);
+        }
+
+        auto layer = scene()->track().layer_by_id(layer_id);
+        if (apply && layer)
+        {
+            auto tile_count = layer->tiles.size();
+            if (!selection.empty() && selection.back() >= tile_count)
+            {
+                auto ranges = selection.ranges();
+                selection.clear();
+                for (const auto& range : ranges)
+                {
+                    selection.insert_range(range.begin, std::min(range.end, tile_count));
+                }
+            }
+
+            select_tiles(selection);
+        }
+    };
+
+    read_selection(undo);
+    read_selection(!undo);
+
+    if (reader.read<std::uint8_t>() != 0)
+    {
+        for (bool apply : { undo, !undo })
+        {
+            TileClipboard clipboard;
+            clipboard.clear_ = reader.read<std::uint8_t>() != 0;
+
+            if (reader.read<TileEditClipboard>() == TileEditClipboard::ErasedTiles)
+            {
+                // Erasures are recorded from back to front.
+                std::reverse(erased_tiles.begin(), erased_tiles.end());
+                clipboard.tiles_ = std::make_shared<std::vector<components::Tile>>(std::move(erased_tiles));
+            }
+
+            else
+            {
+                auto session = reader.read<std::uint32_t>();
+                clipboard.tiles_ = features_->clipboard_table_.find(session, reader.read<std::uint32_t>());
+            }
+
+            if (apply)
+            {
+                features_->clipboard_ = std::move(clipboard);
+                if (features_->clipboard_.empty()) clipboard_emptied();
+                else clipboard_filled();
+            }
+        }
     }
 }
 
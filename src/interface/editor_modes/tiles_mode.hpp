@@ -29,16 +29,18 @@
 #include "mode_base.hpp"
 
 #include "../editor_modes.hpp"
+#include "../command.hpp"
 
 #include "components/tile_definition.hpp"
 
 #include "core/vector2.hpp"
+#include "core/index_set.hpp"
 
 #include <SFML/Graphics.hpp>
 
 #include <qevent.h>
 
-#include <map>
+#include <vector>
 #include <cstdint>
 #include <cstddef>
 #include <memory>
@@ -51,7 +53,7 @@ namespace interface
 NAMESPACE_INTERFACE_MODES
 
 struct TilesMode
-    : public ModeBase
+    : public ModeBase, public CommandTarget
 {
     TilesMode(EditorCanvas* canvas);
     ~TilesMode();
@@ -79,9 +81,13 @@ struct TilesMode
     void fill_area(const FillProperties& fill_properties);
 
     void select_active_tile();
-    void select_tiles(const std::map<std::size_t, components::Tile>& selection);
+    void select_tiles(const core::IndexSet& selection);
     void select_tile_range(std::size_t tile_index, std::size_t count);
-    void select_tiles_in_area(core::IntRect area);
+    void select_tiles_in_area(core::IntRect area, const std::vector<core::Vector2i>& polygon = {});
+
+    // Shows which tiles an area selection would select, while it's being dragged.
+    void preview_tiles_in_area(core::IntRect area, const std::vector<core::Vector2i>& polygon);
+    void discard_area_selection_preview();
 
     void tile_selection_changed();
     void deselect();
@@ -103,6 +109,10 @@ struct TilesMode
 
     virtual void customize_cursor() override;
 
+    virtual void execute_command(CommandType type, CommandReader& reader) override;
+    virtual void undo_command(CommandType type, CommandReader& reader) override;
+    virtual void release_command(CommandType type, CommandReader& reader) override;
+
 private:
     virtual void on_initialize(scene::Scene* scene) override;
     virtual void on_activate() override;
@@ -112,9 +122,15 @@ private:
     void initialize_tile_selection();
 
     void update_tile_selection(core::Vector2i track_point);
+    void find_tiles_in_area(core::IntRect area, const std::vector<core::Vector2i>& polygon,
+        std::vector<std::size_t>& result);
     void update_tile_placement();
 
     void rebuild_tile_selection_display();
+    void apply_tile_edit(CommandReader& reader, bool undo);
+    void perform_tile_edit(const std::string& description, std::vector<std::uint8_t> record, bool execute = true);
+    void begin_selection_preview();
+    void end_selection_preview();
     std::size_t acquire_level_layer(std::size_t level);
 
     void tile_selection_changed(std::size_t selected_tile_count);
@@ -257,6 +257,23 @@ namespace interface
             return QSize(100, 32);
         }
 
+        // The item widgets don't have tooltips of their own, so the view asks for this one.
+        if (role == Qt::ToolTipRole)
+        {
+            const auto& layers = scene_->track().layers();
+            std::size_t row = index.row();
+            if (row >= layers.size()) return QVariant::Invalid;
+
+            const auto& layer = layers[layers.size() - row - 1];
+            auto text = QString("%1 tiles").arg(layer->tiles.size());
+            if (layer->visible && scene_->occlusion_valid())
+            {
+                text += QString(", %1 completely overdrawn").arg(scene_->occluded_tile_count(layer.id()));
+            }
+
+            return text;
+        }
+
         return QVariant::Invalid;
     }
 
@@ -109,6 +109,14 @@ namespace interface
         }
     }
 
+    void LoadingDialog::reject()
+    {
+        scene_loader_.cancel();
+        timer_.stop();
+
+        QDialog::reject();
+    }
+
     void LoadingDialog::load_track(const QString& track_path)
     {
         auto loading_func = [=]()
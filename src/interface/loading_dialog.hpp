@@ -58,6 +58,8 @@ namespace interface
 
         void poll();
 
+        virtual void reject() override;
+
     signals:
         void scene_ready(std::unique_ptr<scene::Scene>&);
 
@@ -30,6 +30,7 @@
 #include "fill_dialog.hpp"
 #include "resize_track_dialog.hpp"
 #include "track_properties_dialog.hpp"
+#include "action_journal.hpp"
 
 #include "components/track_saving.hpp"
 
@@ -37,11 +38,19 @@
 #include <qlayout.h>
 #include <qmessagebox.h>
 #include <qevent.h>
+#include <qfile.h>
 
 #include <memory>
+#include <thread>
+#include <algorithm>
 
 namespace interface
 {
+    namespace
+    {
+        const char* const journal_file_name = "editor.journal";
+    }
+
     MainWindow::MainWindow(QWidget *parent)
         : QMainWindow(parent)
     {
@@ -171,10 +180,11 @@ namespace interface
         connect(ui_.actionStrict_Rotations, SIGNAL(toggled(bool)), 
             ui_.editorCanvas, SLOT(enable_strict_rotations(bool)));
         
-        connect(ui_.editorCanvas, SIGNAL(scene_loaded(const scene::Scene*)), this, SLOT(scene_loaded(const scene::Scene*)));
-
+        // The history has to be cleared before MainWindow::scene_loaded gets the chance to restore it.
         connect(ui_.editorCanvas, SIGNAL(scene_loaded(const scene::Scene*)), ui_.actionHistoryList, SLOT(clear()));
 
+        connect(ui_.editorCanvas, SIGNAL(scene_loaded(const scene::Scene*)), this, SLOT(scene_loaded(const scene::Scene*)));
+
         connect(ui_.actionPlacement, SIGNAL(triggered()), ui_.editorCanvas, SLOT(activate_placement_tool()));
         connect(ui_.actionSingleSelectionTool, SIGNAL(triggered()), ui_.editorCanvas, SLOT(activate_tile_selection_tool()));
         connect(ui_.actionAreaSelectionTool, SIGNAL(triggered()), ui_.editorCanvas, SLOT(activate_area_selection_tool()));
@@ -270,6 +280,14 @@ namespace interface
         connect(ui_.actionHistoryList, SIGNAL(disable_undo()), this, SLOT(disable_undo()));
         connect(ui_.actionHistoryList, SIGNAL(enable_redo()), this, SLOT(enable_redo()));
         connect(ui_.actionHistoryList, SIGNAL(disable_redo()), this, SLOT(disable_redo()));
+
+        connect(ui_.actionHistoryList, SIGNAL(history_jump_started()), ui_.editorCanvas, SLOT(begin_scene_transaction()));
+        connect(ui_.actionHistoryList, SIGNAL(history_jump_finished()), ui_.editorCanvas, SLOT(end_scene_transaction()));
+
+        offer_session_recovery();
+
+        journal_ = std::make_unique<ActionJournal>(journal_file_name);
+        ui_.actionHistoryList->set_journal(journal_.get());
     }
 
     MainWindow::~MainWindow()
@@ -338,7 +356,16 @@ namespace interface
 
         try
         {
-            components::save_track(ui_.editorCanvas->track(), ui_.editorCanvas->pattern_store());
+            components::PatternSaveOptions pattern_options;
+            pattern_options.thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+            components::save_track(ui_.editorCanvas->track(), ui_.editorCanvas->pattern_store(), pattern_options,
+                &ui_.editorCanvas->pattern_hash_cache(), &ui_.editorCanvas->written_pattern());
+
+            journal_->reset(ui_.editorCanvas->track().path());
+            ui_.actionHistoryList->write_to_journal();
+            journal_->mark_saved();
+            journal_failure_reported_ = false;
 
             QMessageBox::information(this, "Saved", "Track saved.", QMessageBox::Ok);
         }
@@ -397,6 +424,67 @@ namespace interface
         ui_.actionHistoryView->setEnabled(true);
         ui_.actionLayerView->setEnabled(true);
         saved_ = true;
+
+        const auto& track_path = ui_.editorCanvas->track().path();
+        auto recovery = std::move(pending_recovery_);
+
+        if (recovery && recovery->track_path == track_path)
+        {
+            recover_session(*recovery);
+        }
+
+        // Tracks that were never saved have nothing to replay the journal against.
+        else if (QFile::exists(QString::fromStdString(track_path)))
+        {
+            journal_->reset(track_path);
+            journal_failure_reported_ = false;
+        }
+
+        else
+        {
+            journal_->discard();
+        }
+    }
+
+    void MainWindow::offer_session_recovery()
+    {
+        auto contents = read_action_journal(journal_file_name);
+
+        bool has_changes = !contents.unwind_entries.empty() || contents.history_index != contents.saved_index;
+        if (!has_changes || !QFile::exists(QString::fromStdString(contents.track_path))) return;
+
+        auto result = QMessageBox::question(this, "Recover Session", 
+            "The editor was not closed properly. Do you want to recover the unsaved changes to " + 
+            QString::fromStdString(contents.track_path) + "?", QMessageBox::Yes | QMessageBox::No);
+
+        if (result == QMessageBox::Yes)
+        {
+            pending_recovery_ = std::make_unique<JournalContents>(std::move(contents));
+            loading_dialog_->load_track(QString::fromStdString(pending_recovery_->track_path));
+        }
+    }
+
+    void MainWindow::recover_session(const JournalContents& contents)
+    {
+        try
+        {
+            auto actions = ui_.editorCanvas->replay_journal(contents);
+            ui_.actionHistoryList->restore(actions, contents.history_index);
+
+            // Keep appending to the same journal, it still describes the way from the saved track
+            // to the current state.
+            journal_->resume(contents);
+            journal_failure_reported_ = false;
+
+            saved_ = false;
+        }
+
+        catch (const std::exception& e)
+        {
+            journal_->discard();
+
+            QMessageBox::critical(this, "Recovery Error", "Error recovering session: " + QString(e.what()));
+        }
     }
 
     void MainWindow::closeEvent(QCloseEvent* event)
@@ -419,6 +507,8 @@ namespace interface
             }
         }
 
+        if (accept) journal_->discard();
+
         if (accept) event->accept();
         else event->accept();
     }
@@ -703,6 +793,14 @@ namespace interface
     void MainWindow::action_performed()
     {
         saved_ = false;
+
+        if (journal_->has_failed() && !journal_failure_reported_)
+        {
+            journal_failure_reported_ = true;
+
+            QMessageBox::warning(this, "Journal Error", "The session journal could not be written to. "
+                "Unsaved changes can not be recovered if the editor is not closed properly.");
+        }
     }
 
     void MainWindow::enable_undo()
@@ -31,6 +31,8 @@
 
 #include "ui_main_window.h"
 
+#include <memory>
+
 namespace scene
 {
     class Scene;
@@ -45,6 +47,8 @@ namespace interface
     class ResizeTrackDialog;
     class TrackPropertiesDialog;
     struct TrackEssentials;
+    struct JournalContents;
+    class ActionJournal;
 
     class MainWindow : public QMainWindow
     {
@@ -108,6 +112,9 @@ namespace interface
         virtual void closeEvent(QCloseEvent*) override;
         void set_tool_enabled(EditorTool tool, bool enabled);
 
+        void offer_session_recovery();
+        void recover_session(const JournalContents& contents);
+
         QAction* tool_action(EditorTool tool) const;
         QAction* mode_action(EditorMode mode) const;
 
@@ -127,6 +134,10 @@ namespace interface
 
         QComboBox* mode_combobox_ = nullptr;
 
+        std::unique_ptr<ActionJournal> journal_;
+        std::unique_ptr<JournalContents> pending_recovery_;
+        bool journal_failure_reported_ = false;
+
         bool saved_ = true;
     };
 }
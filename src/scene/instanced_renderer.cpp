@@ -0,0 +1,947 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "instanced_renderer.hpp"
+#include "tile_mapping.hpp"
+
+#include "components/tile_library.hpp"
+#include "components/tile_group_expansion.hpp"
+
+#include <SFML/OpenGL.hpp>
+
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace scene
+{
+    namespace
+    {
+        namespace gl
+        {
+            const GLenum ARRAY_BUFFER = 0x8892;
+            const GLenum DYNAMIC_DRAW = 0x88E8;
+            const GLenum FRAGMENT_SHADER = 0x8B30;
+            const GLenum VERTEX_SHADER = 0x8B31;
+            const GLenum COMPILE_STATUS = 0x8B81;
+            const GLenum LINK_STATUS = 0x8B82;
+            const GLenum RGBA32F = 0x8814;
+            const GLenum TEXTURE0 = 0x84C0;
+            const GLenum TEXTURE1 = 0x84C1;
+
+            struct Functions
+            {
+                void (APIENTRY* gen_buffers)(GLsizei, GLuint*) = nullptr;
+                void (APIENTRY* delete_buffers)(GLsizei, const GLuint*) = nullptr;
+                void (APIENTRY* bind_buffer)(GLenum, GLuint) = nullptr;
+                void (APIENTRY* buffer_data)(GLenum, std::ptrdiff_t, const void*, GLenum) = nullptr;
+                void (APIENTRY* buffer_sub_data)(GLenum, std::ptrdiff_t, std::ptrdiff_t, const void*) = nullptr;
+
+                void (APIENTRY* gen_vertex_arrays)(GLsizei, GLuint*) = nullptr;
+                void (APIENTRY* delete_vertex_arrays)(GLsizei, const GLuint*) = nullptr;
+                void (APIENTRY* bind_vertex_array)(GLuint) = nullptr;
+                void (APIENTRY* enable_vertex_attrib_array)(GLuint) = nullptr;
+                void (APIENTRY* vertex_attrib_pointer)(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) = nullptr;
+                void (APIENTRY* vertex_attrib_i_pointer)(GLuint, GLint, GLenum, GLsizei, const void*) = nullptr;
+                void (APIENTRY* vertex_attrib_divisor)(GLuint, GLuint) = nullptr;
+                void (APIENTRY* draw_arrays_instanced)(GLenum, GLint, GLsizei, GLsizei) = nullptr;
+
+                GLuint (APIENTRY* create_shader)(GLenum) = nullptr;
+                void (APIENTRY* delete_shader)(GLuint) = nullptr;
+                void (APIENTRY* shader_source)(GLuint, GLsizei, const char* const*, const GLint*) = nullptr;
+                void (APIENTRY* compile_shader)(GLuint) = nullptr;
+                void (APIENTRY* get_shader_iv)(GLuint, GLenum, GLint*) = nullptr;
+                GLuint (APIENTRY* create_program)() = nullptr;
+                void (APIENTRY* delete_program)(GLuint) = nullptr;
+                void (APIENTRY* attach_shader)(GLuint, GLuint) = nullptr;
+                void (APIENTRY* link_program)(GLuint) = nullptr;
+                void (APIENTRY* get_program_iv)(GLuint, GLenum, GLint*) = nullptr;
+                void (APIENTRY* use_program)(GLuint) = nullptr;
+                GLint (APIENTRY* get_uniform_location)(GLuint, const char*) = nullptr;
+                void (APIENTRY* uniform_1i)(GLint, GLint) = nullptr;
+                void (APIENTRY* uniform_2f)(GLint, GLfloat, GLfloat) = nullptr;
+                void (APIENTRY* uniform_matrix_4fv)(GLint, GLsizei, GLboolean, const GLfloat*) = nullptr;
+                void (APIENTRY* active_texture)(GLenum) = nullptr;
+            };
+
+            Functions functions;
+
+            template <typename FunctionPtr>
+            bool load_function(FunctionPtr& function, const char* name)
+            {
+                function = reinterpret_cast<FunctionPtr>(sf::Context::getFunction(name));
+                return function != nullptr;
+            }
+
+            bool load_functions()
+            {
+                Functions& f = functions;
+                return load_function(f.gen_buffers, "glGenBuffers") &&
+                    load_function(f.delete_buffers, "glDeleteBuffers") &&
+                    load_function(f.bind_buffer, "glBindBuffer") &&
+                    load_function(f.buffer_data, "glBufferData") &&
+                    load_function(f.buffer_sub_data, "glBufferSubData") &&
+                    load_function(f.gen_vertex_arrays, "glGenVertexArrays") &&
+                    load_function(f.delete_vertex_arrays, "glDeleteVertexArrays") &&
+                    load_function(f.bind_vertex_array, "glBindVertexArray") &&
+                    load_function(f.enable_vertex_attrib_array, "glEnableVertexAttribArray") &&
+                    load_function(f.vertex_attrib_pointer, "glVertexAttribPointer") &&
+                    load_function(f.vertex_attrib_i_pointer, "glVertexAttribIPointer") &&
+                    load_function(f.vertex_attrib_divisor, "glVertexAttribDivisor") &&
+                    load_function(f.draw_arrays_instanced, "glDrawArraysInstanced") &&
+                    load_function(f.create_shader, "glCreateShader") &&
+                    load_function(f.delete_shader, "glDeleteShader") &&
+                    load_function(f.shader_source, "glShaderSource") &&
+                    load_function(f.compile_shader, "glCompileShader") &&
+                    load_function(f.get_shader_iv, "glGetShaderiv") &&
+                    load_function(f.create_program, "glCreateProgram") &&
+                    load_function(f.delete_program, "glDeleteProgram") &&
+                    load_function(f.attach_shader, "glAttachShader") &&
+                    load_function(f.link_program, "glLinkProgram") &&
+                    load_function(f.get_program_iv, "glGetProgramiv") &&
+                    load_function(f.use_program, "glUseProgram") &&
+                    load_function(f.get_uniform_location, "glGetUniformLocation") &&
+                    load_function(f.uniform_1i, "glUniform1i") &&
+                    load_function(f.uniform_2f, "glUniform2f") &&
+                    load_function(f.uniform_matrix_4fv, "glUniformMatrix4fv") &&
+                    load_function(f.active_texture, "glActiveTexture");
+            }
+
+            bool has_version(int required_major, int required_minor)
+            {
+                auto version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+                int major = 0, minor = 0;
+                if (!version || std::sscanf(version, "%d.%d", &major, &minor) != 2) return false;
+
+                return major > required_major || (major == required_major && minor >= required_minor);
+            }
+
+            GLuint compile_shader(GLenum type, const char* source)
+            {
+                GLuint shader = functions.create_shader(type);
+                functions.shader_source(shader, 1, &source, nullptr);
+                functions.compile_shader(shader);
+
+                GLint status = GL_FALSE;
+                functions.get_shader_iv(shader, COMPILE_STATUS, &status);
+                if (status == GL_FALSE)
+                {
+                    functions.delete_shader(shader);
+                    return 0;
+                }
+
+                return shader;
+            }
+        }
+
+        // Placement tables are 1024 texels wide, two texels per placement.
+        const GLsizei placement_table_width = 1024;
+
+        const char* const instanced_vertex_shader_code =
+            "#version 330\n"
+
+            "layout(location = 0) in vec2 instance_position;\n"
+            "layout(location = 1) in float instance_rotation;\n"
+            "layout(location = 2) in uint placement_index;\n"
+
+            "uniform mat4 view_matrix;\n"
+            "uniform vec2 texture_size;\n"
+            "uniform sampler2D placement_table;\n"
+
+            "out vec2 texture_coords;\n"
+
+            "void main() {\n"
+            "    if ((placement_index & 0xC0000000u) != 0u) {\n"
+            "        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+            "        texture_coords = vec2(0.0);\n"
+            "        return;\n"
+            "    }\n"
+
+            "    vec2 corner = vec2(float(gl_VertexID / 2), float(gl_VertexID % 2));\n"
+            "    int texel = int(placement_index) * 2;\n"
+            "    int width = textureSize(placement_table, 0).x;\n"
+            "    vec4 quad = texelFetch(placement_table, ivec2(texel % width, texel / width), 0);\n"
+            "    vec4 texture_rect = texelFetch(placement_table, ivec2(texel % width + 1, texel / width), 0);\n"
+
+            "    vec2 local = mix(quad.xy, quad.zw, corner);\n"
+            "    float s = sin(instance_rotation);\n"
+            "    float c = cos(instance_rotation);\n"
+            "    vec2 position = vec2(local.x * c - s * local.y, local.y * c + s * local.x) + instance_position;\n"
+
+            "    gl_Position = view_matrix * vec4(position, 0.0, 1.0);\n"
+            "    texture_coords = mix(texture_rect.xy, texture_rect.zw, corner) / texture_size;\n"
+            "}";
+
+        const char* const instanced_fragment_shader_code =
+            "#version 330\n"
+
+            "uniform sampler2D atlas;\n"
+            "in vec2 texture_coords;\n"
+            "out vec4 fragment_color;\n"
+
+            "void main() {\n"
+            "    fragment_color = texture(atlas, texture_coords);\n"
+            "}";
+    }
+
+    struct InstanceBuffer
+    {
+        ~InstanceBuffer()
+        {
+            if (handle != 0 && gl::functions.delete_buffers)
+            {
+                gl::functions.delete_buffers(1, &handle);
+            }
+        }
+
+        GLuint handle = 0;
+        std::size_t capacity = 0;
+    };
+
+    PlacementTable create_placement_table(const TileMapping& tile_mapping, const components::TileLibrary& tile_library)
+    {
+        static std::atomic<std::uint32_t> generation_counter(0);
+
+        PlacementTable result;
+        result.generation = ++generation_counter;
+
+        std::size_t placement_count = tile_mapping.placement_count();
+        result.texels.resize(placement_count * 8);
+
+        auto texel_ptr = result.texels.data();
+        for (std::size_t index = 0; index != placement_count; ++index, texel_ptr += 8)
+        {
+            const auto& placement = tile_mapping.placement(index);
+            const auto* tile_def = tile_library.tile(placement.tile_id);
+            if (!tile_def) continue;
+
+            // Same quad geometry as generate_tile_vertices.
+            const core::IntRect image_rect = tile_def->image_rect;
+            const core::IntRect pattern_rect = tile_def->pattern_rect;
+            const auto& tile_rect = placement.tile_rect;
+            const auto& texture_rect = placement.texture_rect;
+
+            auto scale_x = 0.5;
+            auto scale_y = 0.5;
+
+            if (pattern_rect.width * 2 != image_rect.width) scale_x = static_cast<double>(pattern_rect.width) / image_rect.width;
+            if (pattern_rect.height * 2 != image_rect.height) scale_y = static_cast<double>(pattern_rect.height) / image_rect.height;
+
+            const auto center_x = image_rect.width * scale_x * 0.5;
+            const auto center_y = image_rect.height * scale_y * 0.5;
+
+            texel_ptr[0] = static_cast<float>((tile_rect.left - 1.0) * scale_x - center_x);
+            texel_ptr[1] = static_cast<float>((tile_rect.top - 1.0) * scale_y - center_y);
+            texel_ptr[2] = static_cast<float>(tile_rect.right() * scale_x - center_x);
+            texel_ptr[3] = static_cast<float>(tile_rect.bottom() * scale_y - center_y);
+
+            texel_ptr[4] = static_cast<float>(texture_rect.left);
+            texel_ptr[5] = static_cast<float>(texture_rect.top);
+            texel_ptr[6] = static_cast<float>(texture_rect.right());
+            texel_ptr[7] = static_cast<float>(texture_rect.bottom());
+        }
+
+        return result;
+    }
+
+    InstancedLayer::InstancedLayer()
+    {
+    }
+
+    InstancedLayer::InstancedLayer(InstancedLayer&&) = default;
+    InstancedLayer& InstancedLayer::operator=(InstancedLayer&&) = default;
+
+    InstancedLayer::~InstancedLayer()
+    {
+    }
+
+    void InstancedLayer::hide()
+    {
+        visible_ = false;
+    }
+
+    void InstancedLayer::show()
+    {
+        visible_ = true;
+    }
+
+    bool InstancedLayer::visible() const
+    {
+        return visible_;
+    }
+
+    void InstancedLayer::invalidate()
+    {
+        valid_ = false;
+    }
+
+    bool InstancedLayer::is_valid() const
+    {
+        return valid_;
+    }
+
+    const std::vector<TileInstance>& InstancedLayer::instances() const
+    {
+        return instances_;
+    }
+
+    void InstancedLayer::mark_dirty(std::size_t instance_index, std::size_t instance_count)
+    {
+        if (instance_count == 0) return;
+
+        if (dirty_begin_ == dirty_end_)
+        {
+            dirty_begin_ = instance_index;
+            dirty_end_ = instance_index + instance_count;
+        }
+
+        else
+        {
+            dirty_begin_ = std::min(dirty_begin_, instance_index);
+            dirty_end_ = std::max(dirty_end_, instance_index + instance_count);
+        }
+    }
+
+    void InstancedLayer::generate_instances(const components::Tile& tile, const components::TileLibrary& tile_library,
+        const TileMapping& tile_mapping, std::size_t instance_index)
+    {
+        tile_cache_.clear();
+        components::expand_tile_groups(&tile, &tile + 1, tile_library, std::back_inserter(tile_cache_));
+
+        const sf::Texture* texture_hint = nullptr;
+        if (instance_index != 0)
+        {
+            auto placement_index = instances_[instance_index - 1].placement_index & ~instance_flag_mask;
+            texture_hint = tile_mapping.placement(placement_index).texture;
+        }
+
+        instance_cache_.clear();
+
+        for (const auto& placed_tile : tile_cache_)
+        {
+            auto placement_range = tile_mapping.find_tile(placed_tile.tile_def->id, texture_hint);
+            for (const auto& placement : placement_range)
+            {
+                TileInstance instance;
+                instance.position[0] = static_cast<float>(placed_tile.tile.position.x);
+                instance.position[1] = static_cast<float>(placed_tile.tile.position.y);
+                instance.rotation = static_cast<float>(placed_tile.tile.rotation.radians());
+                instance.placement_index = static_cast<std::uint32_t>(tile_mapping.placement_index(placement));
+                instance_cache_.push_back(instance);
+
+                texture_hint = placement.texture;
+            }
+        }
+    }
+
+    void InstancedLayer::append_instances(const TileMapping& tile_mapping)
+    {
+        Tile tile_info;
+        tile_info.instance_index = instances_.size();
+        tile_info.instance_count = instance_cache_.size();
+        tile_info_.push_back(tile_info);
+
+        for (const auto& instance : instance_cache_)
+        {
+            const sf::Texture* texture = tile_mapping.placement(instance.placement_index).texture;
+            if (!component_info_.empty() && component_info_.back().texture == texture)
+            {
+                ++component_info_.back().instance_count;
+            }
+
+            else
+            {
+                Component component;
+                component.instance_index = instances_.size();
+                component.instance_count = 1;
+                component.texture = texture;
+                component_info_.push_back(component);
+            }
+
+            instances_.push_back(instance);
+        }
+
+        mark_dirty(tile_info.instance_index, tile_info.instance_count);
+    }
+
+    void InstancedLayer::rebuild(const std::vector<components::Tile>& tiles, const components::TileLibrary& tile_library,
+        const TileMapping& tile_mapping)
+    {
+        instances_.clear();
+        tile_info_.clear();
+        component_info_.clear();
+        dirty_begin_ = dirty_end_ = 0;
+
+        for (const auto& tile : tiles)
+        {
+            generate_instances(tile, tile_library, tile_mapping, instances_.size());
+            append_instances(tile_mapping);
+        }
+
+        valid_ = true;
+        apply_culled_tiles();
+    }
+
+    void InstancedLayer::append_tile(const components::Tile& tile, const components::TileLibrary& tile_library,
+        const TileMapping& tile_mapping)
+    {
+        if (!valid_) return;
+
+        generate_instances(tile, tile_library, tile_mapping, instances_.size());
+        append_instances(tile_mapping);
+    }
+
+    void InstancedLayer::update_tile(std::size_t tile_index, const components::Tile& tile,
+        const components::TileLibrary& tile_library, const TileMapping& tile_mapping)
+    {
+        if (!valid_) return;
+
+        if (tile_index >= tile_info_.size())
+        {
+            invalidate();
+            return;
+        }
+
+        generate_instances(tile, tile_library, tile_mapping, instances_.size());
+
+        // The records can only be updated in place if the tile still maps to the same textures,
+        // otherwise the component runs would need to be rearranged.
+        const auto& tile_info = tile_info_[tile_index];
+        auto instance_it = instances_.begin() + tile_info.instance_index;
+
+        bool same_layout = tile_info.instance_count == instance_cache_.size() &&
+            std::equal(instance_cache_.begin(), instance_cache_.end(), instance_it,
+            [&](const TileInstance& new_instance, const TileInstance& old_instance)
+        {
+            auto old_index = old_instance.placement_index & ~instance_flag_mask;
+            return tile_mapping.placement(new_instance.placement_index).texture == 
+                tile_mapping.placement(old_index).texture;
+        });
+
+        if (!same_layout)
+        {
+            invalidate();
+            return;
+        }
+
+        std::copy(instance_cache_.begin(), instance_cache_.end(), instance_it);
+
+        mark_dirty(tile_info.instance_index, tile_info.instance_count);
+    }
+
+    void InstancedLayer::merge_components()
+    {
+        auto write_it = component_info_.begin();
+        for (const auto& component : component_info_)
+        {
+            if (component.instance_count == 0) continue;
+
+            if (write_it != component_info_.begin() && std::prev(write_it)->texture == component.texture)
+            {
+                std::prev(write_it)->instance_count += component.instance_count;
+            }
+
+            else
+            {
+                *write_it++ = component;
+            }
+        }
+
+        component_info_.erase(write_it, component_info_.end());
+    }
+
+    void InstancedLayer::insert_tile(std::size_t tile_index, const components::Tile& tile,
+        const components::TileLibrary& tile_library, const TileMapping& tile_mapping)
+    {
+        if (!valid_) return;
+
+        if (tile_index >= tile_info_.size())
+        {
+            append_tile(tile, tile_library, tile_mapping);
+            return;
+        }
+
+        clear_culled_tiles();
+
+        Tile tile_info;
+        tile_info.instance_index = tile_info_[tile_index].instance_index;
+        generate_instances(tile, tile_library, tile_mapping, tile_info.instance_index);
+
+        tile_info.instance_count = instance_cache_.size();
+
+        auto instance_index = tile_info.instance_index;
+        auto instance_count = tile_info.instance_count;
+
+        instances_.insert(instances_.begin() + instance_index, instance_cache_.begin(), instance_cache_.end());
+        tile_info_.insert(tile_info_.begin() + tile_index, tile_info);
+        for (auto it = tile_info_.begin() + tile_index + 1; it != tile_info_.end(); ++it)
+        {
+            it->instance_index += instance_count;
+        }
+
+        std::vector<Component> new_components;
+        for (std::size_t offset = 0; offset != instance_count; ++offset)
+        {
+            const sf::Texture* texture = tile_mapping.placement(instance_cache_[offset].placement_index).texture;
+            if (!new_components.empty() && new_components.back().texture == texture)
+            {
+                ++new_components.back().instance_count;
+            }
+
+            else
+            {
+                Component component;
+                component.instance_index = instance_index + offset;
+                component.instance_count = 1;
+                component.texture = texture;
+                new_components.push_back(component);
+            }
+        }
+
+        // Split the component the instances end up in, and make room for the new ones.
+        std::size_t component_index = 0;
+        while (component_index != component_info_.size() &&
+            component_info_[component_index].instance_index + component_info_[component_index].instance_count <= instance_index)
+        {
+            ++component_index;
+        }
+
+        if (component_index != component_info_.size() && component_info_[component_index].instance_index < instance_index)
+        {
+            auto& component = component_info_[component_index];
+
+            Component tail = component;
+            tail.instance_index = instance_index;
+            tail.instance_count = component.instance_index + component.instance_count - instance_index;
+            component.instance_count -= tail.instance_count;
+
+            component_info_.insert(component_info_.begin() + ++component_index, tail);
+        }
+
+        for (auto it = component_info_.begin() + component_index; it != component_info_.end(); ++it)
+        {
+            it->instance_index += instance_count;
+        }
+
+        component_info_.insert(component_info_.begin() + component_index, new_components.begin(), new_components.end());
+        merge_components();
+
+        mark_dirty(instance_index, instances_.size() - instance_index);
+    }
+
+    void InstancedLayer::erase_tile(std::size_t tile_index)
+    {
+        erase_tiles(std::vector<std::size_t>(1, tile_index));
+    }
+
+    void InstancedLayer::erase_tiles(const std::vector<std::size_t>& tile_indices)
+    {
+        if (!valid_) return;
+
+        auto erased_it = tile_indices.begin();
+        auto erased_end = std::lower_bound(tile_indices.begin(), tile_indices.end(), tile_info_.size());
+        if (erased_it == erased_end) return;
+
+        clear_culled_tiles();
+
+        // Instances are laid out in tile order, so the erased instances can be compacted away in one pass.
+        // The components lose the instances that fall within them.
+        std::size_t first_instance = tile_info_[*erased_it].instance_index;
+        std::size_t removed_count = 0;
+
+        auto tile_write_it = tile_info_.begin() + *erased_it;
+        auto instance_write_it = instances_.begin() + first_instance;
+        auto component_it = component_info_.begin();
+
+        for (std::size_t tile_index = *erased_it; tile_index != tile_info_.size(); ++tile_index)
+        {
+            auto tile_info = tile_info_[tile_index];
+            auto instance_begin = instances_.begin() + tile_info.instance_index;
+            auto instance_end = instance_begin + tile_info.instance_count;
+
+            if (erased_it != erased_end && *erased_it == tile_index)
+            {
+                while (erased_it != erased_end && *erased_it == tile_index) ++erased_it;
+
+                for (auto index = tile_info.instance_index; index != tile_info.instance_index + tile_info.instance_count; ++index)
+                {
+                    while (std::next(component_it) != component_info_.end() && std::next(component_it)->instance_index <= index)
+                    {
+                        ++component_it;
+                    }
+                    --component_it->instance_count;
+                }
+
+                removed_count += tile_info.instance_count;
+                continue;
+            }
+
+            instance_write_it = std::copy(instance_begin, instance_end, instance_write_it);
+
+            tile_info.instance_index -= removed_count;
+            *tile_write_it++ = tile_info;
+        }
+
+        instances_.erase(instance_write_it, instances_.end());
+        tile_info_.erase(tile_write_it, tile_info_.end());
+
+        // The counts were reduced in place, the indices follow from them.
+        std::size_t instance_index = 0;
+        for (auto& component : component_info_)
+        {
+            component.instance_index = instance_index;
+            instance_index += component.instance_count;
+        }
+
+        merge_components();
+
+        mark_dirty(first_instance, instances_.size() - first_instance);
+    }
+
+    void InstancedLayer::erase_last_tiles(std::size_t tile_count)
+    {
+        if (!valid_) return;
+
+        tile_count = std::min(tile_count, tile_info_.size());
+        if (tile_count == 0) return;
+
+        clear_culled_tiles();
+
+        auto new_tile_count = tile_info_.size() - tile_count;
+        std::size_t instance_count = tile_info_[new_tile_count].instance_index;
+
+        tile_info_.resize(new_tile_count);
+        instances_.resize(instance_count);
+
+        while (!component_info_.empty() && component_info_.back().instance_index >= instance_count)
+        {
+            component_info_.pop_back();
+        }
+
+        if (!component_info_.empty())
+        {
+            auto& component = component_info_.back();
+            component.instance_count = instance_count - component.instance_index;
+        }
+    }
+
+    void InstancedLayer::translate(core::Vector2i offset)
+    {
+        if (!valid_) return;
+
+        for (auto& instance : instances_)
+        {
+            instance.position[0] += static_cast<float>(offset.x);
+            instance.position[1] += static_cast<float>(offset.y);
+        }
+
+        mark_dirty(0, instances_.size());
+    }
+
+    void InstancedLayer::set_tile_hidden(std::size_t tile_index, bool hidden)
+    {
+        if (!valid_ || tile_index >= tile_info_.size()) return;
+
+        const auto& tile_info = tile_info_[tile_index];
+        auto instance_it = instances_.begin() + tile_info.instance_index;
+        auto instance_end = instance_it + tile_info.instance_count;
+
+        for (; instance_it != instance_end; ++instance_it)
+        {
+            if (hidden) instance_it->placement_index |= hidden_instance_bit;
+            else instance_it->placement_index &= ~hidden_instance_bit;
+        }
+
+        mark_dirty(tile_info.instance_index, tile_info.instance_count);
+    }
+
+    void InstancedLayer::set_culled_tiles(const std::vector<bool>& culled_tiles)
+    {
+        culled_tiles_ = culled_tiles;
+        apply_culled_tiles();
+    }
+
+    void InstancedLayer::clear_culled_tiles()
+    {
+        // No instance carries the culled bit while there are no culled tiles.
+        if (culled_tiles_.empty()) return;
+
+        culled_tiles_.clear();
+        apply_culled_tiles();
+    }
+
+    void InstancedLayer::apply_culled_tiles()
+    {
+        if (!valid_) return;
+
+        if (!culled_tiles_.empty() && culled_tiles_.size() != tile_info_.size()) culled_tiles_.clear();
+
+        bool changed = false;
+        for (std::size_t tile_index = 0; tile_index != tile_info_.size(); ++tile_index)
+        {
+            bool culled = !culled_tiles_.empty() && culled_tiles_[tile_index];
+
+            const auto& tile_info = tile_info_[tile_index];
+            auto instance_it = instances_.begin() + tile_info.instance_index;
+            auto instance_end = instance_it + tile_info.instance_count;
+
+            for (; instance_it != instance_end; ++instance_it)
+            {
+                auto placement_index = culled ? instance_it->placement_index | culled_instance_bit :
+                    instance_it->placement_index & ~culled_instance_bit;
+
+                changed |= placement_index != instance_it->placement_index;
+                instance_it->placement_index = placement_index;
+            }
+        }
+
+        if (changed) mark_dirty(0, instances_.size());
+    }
+
+    struct InstancedRenderer::Impl
+    {
+        bool available = false;
+
+        GLuint program = 0;
+        GLuint vertex_array = 0;
+        GLuint placement_texture = 0;
+        std::uint32_t placement_generation = 0;
+
+        GLint view_matrix_location = -1;
+        GLint texture_size_location = -1;
+        GLint atlas_location = -1;
+        GLint placement_table_location = -1;
+    };
+
+    InstancedRenderer::InstancedRenderer()
+        : impl_(std::make_unique<Impl>())
+    {
+    }
+
+    InstancedRenderer::~InstancedRenderer()
+    {
+        if (impl_->available)
+        {
+            gl::functions.delete_program(impl_->program);
+            gl::functions.delete_vertex_arrays(1, &impl_->vertex_array);
+            glDeleteTextures(1, &impl_->placement_texture);
+        }
+    }
+
+    bool InstancedRenderer::available() const
+    {
+        return impl_->available;
+    }
+
+    bool InstancedRenderer::initialize()
+    {
+        if (impl_->available) return true;
+
+        if (!gl::has_version(3, 3) || !gl::load_functions()) return false;
+
+        const auto& f = gl::functions;
+        GLuint vertex_shader = gl::compile_shader(gl::VERTEX_SHADER, instanced_vertex_shader_code);
+        GLuint fragment_shader = gl::compile_shader(gl::FRAGMENT_SHADER, instanced_fragment_shader_code);
+
+        if (vertex_shader == 0 || fragment_shader == 0)
+        {
+            if (vertex_shader != 0) f.delete_shader(vertex_shader);
+            if (fragment_shader != 0) f.delete_shader(fragment_shader);
+            return false;
+        }
+
+        GLuint program = f.create_program();
+        f.attach_shader(program, vertex_shader);
+        f.attach_shader(program, fragment_shader);
+        f.link_program(program);
+
+        f.delete_shader(vertex_shader);
+        f.delete_shader(fragment_shader);
+
+        GLint status = GL_FALSE;
+        f.get_program_iv(program, gl::LINK_STATUS, &status);
+        if (status == GL_FALSE)
+        {
+            f.delete_program(program);
+            return false;
+        }
+
+        impl_->program = program;
+        impl_->view_matrix_location = f.get_uniform_location(program, "view_matrix");
+        impl_->texture_size_location = f.get_uniform_location(program, "texture_size");
+        impl_->atlas_location = f.get_uniform_location(program, "atlas");
+        impl_->placement_table_location = f.get_uniform_location(program, "placement_table");
+
+        // The instance attributes advance once per instance. The attribute pointers themselves
+        // are specified per draw call, since every component starts at a different offset.
+        f.gen_vertex_arrays(1, &impl_->vertex_array);
+        f.bind_vertex_array(impl_->vertex_array);
+        for (GLuint attribute = 0; attribute != 3; ++attribute)
+        {
+            f.enable_vertex_attrib_array(attribute);
+            f.vertex_attrib_divisor(attribute, 1);
+        }
+
+        f.bind_vertex_array(0);
+
+        glGenTextures(1, &impl_->placement_texture);
+        glBindTexture(GL_TEXTURE_2D, impl_->placement_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        impl_->available = true;
+        return true;
+    }
+
+    void InstancedRenderer::upload_placement_table(const PlacementTable& placement_table)
+    {
+        if (impl_->placement_generation == placement_table.generation) return;
+
+        std::size_t texel_count = std::max<std::size_t>(placement_table.texels.size() / 4, 1);
+        GLsizei height = static_cast<GLsizei>((texel_count + placement_table_width - 1) / placement_table_width);
+
+        std::vector<float> texels(placement_table.texels);
+        texels.resize(placement_table_width * height * 4);
+
+        glBindTexture(GL_TEXTURE_2D, impl_->placement_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, gl::RGBA32F, placement_table_width, height, 0, GL_RGBA, GL_FLOAT, texels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        impl_->placement_generation = placement_table.generation;
+    }
+
+    void InstancedRenderer::upload_instances(InstancedLayer& layer)
+    {
+        const auto& f = gl::functions;
+        if (!layer.buffer_)
+        {
+            layer.buffer_ = std::make_unique<InstanceBuffer>();
+            f.gen_buffers(1, &layer.buffer_->handle);
+        }
+
+        auto& buffer = *layer.buffer_;
+        f.bind_buffer(gl::ARRAY_BUFFER, buffer.handle);
+
+        const auto& instances = layer.instances_;
+        if (buffer.capacity < instances.size())
+        {
+            // Leave some room, so that appending tiles does not require a full upload every time.
+            buffer.capacity = instances.size() + instances.size() / 2;
+            f.buffer_data(gl::ARRAY_BUFFER, buffer.capacity * sizeof(TileInstance), nullptr, gl::DYNAMIC_DRAW);
+
+            layer.dirty_begin_ = 0;
+            layer.dirty_end_ = instances.size();
+        }
+
+        if (layer.dirty_begin_ != layer.dirty_end_)
+        {
+            std::size_t dirty_end = std::min(layer.dirty_end_, instances.size());
+            if (layer.dirty_begin_ < dirty_end)
+            {
+                f.buffer_sub_data(gl::ARRAY_BUFFER, layer.dirty_begin_ * sizeof(TileInstance),
+                    (dirty_end - layer.dirty_begin_) * sizeof(TileInstance), instances.data() + layer.dirty_begin_);
+            }
+
+            layer.dirty_begin_ = layer.dirty_end_ = 0;
+        }
+    }
+
+    void InstancedRenderer::draw(InstancedLayer& layer, const PlacementTable& placement_table, const TileMapping& tile_mapping,
+        sf::RenderTarget& render_target, sf::RenderStates render_states, DetailLevel detail_level)
+    {
+        if (!impl_->available || !layer.visible() || !layer.is_valid() || layer.instances_.empty()) return;
+
+        const auto& f = gl::functions;
+
+        upload_placement_table(placement_table);
+
+        f.bind_vertex_array(impl_->vertex_array);
+        upload_instances(layer);
+
+        const auto& view = render_target.getView();
+        auto viewport = render_target.getViewport(view);
+        auto target_size = render_target.getSize();
+        glViewport(viewport.left, static_cast<GLint>(target_size.y) - (viewport.top + viewport.height), 
+            viewport.width, viewport.height);
+
+        sf::Transform transform = view.getTransform() * render_states.transform;
+
+        f.use_program(impl_->program);
+        f.uniform_matrix_4fv(impl_->view_matrix_location, 1, GL_FALSE, transform.getMatrix());
+        f.uniform_1i(impl_->atlas_location, 0);
+        f.uniform_1i(impl_->placement_table_location, 1);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        f.active_texture(gl::TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, impl_->placement_texture);
+        f.active_texture(gl::TEXTURE0);
+
+        for (const auto& component : layer.component_info_)
+        {
+            const sf::Texture* texture = component.texture;
+            if (!texture) continue;
+
+            // Texture coordinates are in full-resolution atlas pixels.
+            auto texture_size = texture->getSize();
+            if (detail_level == DetailLevel::Reduced)
+            {
+                texture = tile_mapping.reduced_texture(texture);
+            }
+
+            glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+            f.uniform_2f(impl_->texture_size_location, static_cast<GLfloat>(texture_size.x), 
+                static_cast<GLfloat>(texture_size.y));
+
+            const auto stride = static_cast<GLsizei>(sizeof(TileInstance));
+            const auto offset = component.instance_index * sizeof(TileInstance);
+            auto attribute_offset = [offset](std::size_t member_offset)
+            {
+                return reinterpret_cast<const void*>(offset + member_offset);
+            };
+
+            f.vertex_attrib_pointer(0, 2, GL_FLOAT, GL_FALSE, stride, attribute_offset(offsetof(TileInstance, position)));
+            f.vertex_attrib_pointer(1, 1, GL_FLOAT, GL_FALSE, stride, attribute_offset(offsetof(TileInstance, rotation)));
+            f.vertex_attrib_i_pointer(2, 1, GL_UNSIGNED_INT, stride, attribute_offset(offsetof(TileInstance, placement_index)));
+
+            f.draw_arrays_instanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(component.instance_count));
+        }
+
+        f.bind_buffer(gl::ARRAY_BUFFER, 0);
+        f.bind_vertex_array(0);
+        f.use_program(0);
+
+        // SFML caches the GL states it has set, and we have just changed them under its feet.
+        render_target.resetGLStates();
+    }
+}
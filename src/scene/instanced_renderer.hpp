@@ -0,0 +1,191 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef INSTANCED_RENDERER_HPP
+#define INSTANCED_RENDERER_HPP
+
+#include "track_display.hpp"
+
+#include "components/tile_definition.hpp"
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace components
+{
+    class TileLibrary;
+}
+
+namespace scene
+{
+    class TileMapping;
+
+    // Compact per-tile record for the instanced renderer. The quad itself is
+    // expanded in the vertex shader, using the placement table.
+    struct TileInstance
+    {
+        float position[2];
+        float rotation;
+        std::uint32_t placement_index;
+    };
+
+    static_assert(sizeof(TileInstance) == 16, "TileInstance is expected to be 16 bytes");
+
+    // Set in the placement index of instances that should not be displayed, either because they
+    // were hidden explicitly or because occlusion culling found them to be covered.
+    const std::uint32_t hidden_instance_bit = 0x80000000;
+    const std::uint32_t culled_instance_bit = 0x40000000;
+    const std::uint32_t instance_flag_mask = hidden_instance_bit | culled_instance_bit;
+
+    // Two RGBA texels per placement of the tile mapping: the quad's corners relative to the
+    // tile position, and the texture rect.
+    struct PlacementTable
+    {
+        std::vector<float> texels;
+        std::uint32_t generation = 0;
+    };
+
+    PlacementTable create_placement_table(const TileMapping& tile_mapping, const components::TileLibrary& tile_library);
+
+    struct InstanceBuffer;
+
+    // class InstancedLayer. Instanced counterpart of DisplayLayer. Tiles are inserted and erased
+    // in place, only the instances from the first affected one onwards are uploaded again.
+    // An invalidated layer needs to be rebuilt before it can be drawn.
+    class InstancedLayer
+    {
+    public:
+        InstancedLayer();
+        InstancedLayer(InstancedLayer&&);
+        InstancedLayer& operator=(InstancedLayer&&);
+        ~InstancedLayer();
+
+        void hide();
+        void show();
+        bool visible() const;
+
+        void invalidate();
+        bool is_valid() const;
+
+        void rebuild(const std::vector<components::Tile>& tiles, const components::TileLibrary& tile_library,
+            const TileMapping& tile_mapping);
+
+        void append_tile(const components::Tile& tile, const components::TileLibrary& tile_library,
+            const TileMapping& tile_mapping);
+
+        void update_tile(std::size_t tile_index, const components::Tile& tile, 
+            const components::TileLibrary& tile_library, const TileMapping& tile_mapping);
+
+        void insert_tile(std::size_t tile_index, const components::Tile& tile,
+            const components::TileLibrary& tile_library, const TileMapping& tile_mapping);
+
+        // The indices must be sorted, but may contain duplicates.
+        void erase_tile(std::size_t tile_index);
+        void erase_tiles(const std::vector<std::size_t>& tile_indices);
+        void erase_last_tiles(std::size_t tile_count);
+
+        void translate(core::Vector2i offset);
+
+        void set_tile_hidden(std::size_t tile_index, bool hidden);
+
+        // Culled tiles stay in the buffer, but produce no fragments. The culling is kept across
+        // rebuilds as long as the number of tiles matches.
+        void set_culled_tiles(const std::vector<bool>& culled_tiles);
+        void clear_culled_tiles();
+
+        const std::vector<TileInstance>& instances() const;
+
+    private:
+        friend class InstancedRenderer;
+
+        // The placements are chosen to continue the texture of the instance before instance_index.
+        void generate_instances(const components::Tile& tile, const components::TileLibrary& tile_library,
+            const TileMapping& tile_mapping, std::size_t instance_index);
+
+        void append_instances(const TileMapping& tile_mapping);
+        void mark_dirty(std::size_t instance_index, std::size_t instance_count);
+        void merge_components();
+        void apply_culled_tiles();
+
+        struct Tile
+        {
+            std::size_t instance_index = 0;
+            std::size_t instance_count = 0;
+        };
+
+        struct Component
+        {
+            std::size_t instance_index = 0;
+            std::size_t instance_count = 0;
+            const sf::Texture* texture = nullptr;
+        };
+
+        std::vector<TileInstance> instances_;
+        std::vector<Tile> tile_info_;
+        std::vector<Component> component_info_;
+        std::vector<bool> culled_tiles_;
+
+        bool valid_ = false;
+        bool visible_ = true;
+
+        // Range of instances that has not been uploaded yet.
+        std::size_t dirty_begin_ = 0;
+        std::size_t dirty_end_ = 0;
+        std::unique_ptr<InstanceBuffer> buffer_;
+
+        std::vector<components::PlacedTile> tile_cache_;
+        std::vector<TileInstance> instance_cache_;
+    };
+
+    // class InstancedRenderer. Draws instanced layers with OpenGL 3.3 instancing.
+    // It must only be used if initialize() succeeded, otherwise the regular 
+    // DisplayLayer path has to be used.
+    class InstancedRenderer
+    {
+    public:
+        InstancedRenderer();
+        ~InstancedRenderer();
+
+        // Must be called with the render target's context active.
+        bool initialize();
+        bool available() const;
+
+        void draw(InstancedLayer& layer, const PlacementTable& placement_table, const TileMapping& tile_mapping,
+            sf::RenderTarget& render_target, sf::RenderStates render_states, DetailLevel detail_level = DetailLevel::Full);
+
+    private:
+        void upload_placement_table(const PlacementTable& placement_table);
+        void upload_instances(InstancedLayer& layer);
+
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+}
+
+#endif
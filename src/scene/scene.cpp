@@ -31,6 +31,8 @@
 
 #include <random>
 #include <chrono>
+#include <future>
+#include <thread>
 
 namespace scene
 {
@@ -43,11 +45,12 @@ namespace scene
     }
 
     Scene::Scene(components::Track&& track, components::PatternStore&& pattern_store,
-        TileMapping&& tile_mapping, DisplayLayerMap&& track_display)
+        TileMapping&& tile_mapping, DisplayLayerMap&& track_display, std::vector<bool>&& opaque_tiles)
         : track_(std::move(track)),
           pattern_store_(std::move(pattern_store)),
           tile_mapping_(std::move(tile_mapping)),
-          track_display_(std::move(track_display))
+          track_display_(std::move(track_display)),
+          opaque_tiles_(std::move(opaque_tiles))
     {
     }
 
@@ -66,6 +69,16 @@ namespace scene
         return pattern_store_;
     }
 
+    components::PatternHashCache& Scene::pattern_hash_cache()
+    {
+        return pattern_hash_cache_;
+    }
+
+    components::WrittenPattern& Scene::written_pattern()
+    {
+        return written_pattern_;
+    }
+
     const components::TileLibrary& Scene::tile_library() const
     {
         return track_.tile_library();
@@ -84,25 +97,137 @@ namespace scene
     void Scene::resize_track(core::Vector2u new_size)
     {
         track_.set_size(new_size);
+        invalidate_occlusion();
     }
 
     void Scene::update_tile(std::size_t layer_id, std::size_t tile_index, const components::Tile& tile)
     {
         if (auto layer = track_.layer_by_id(layer_id))
         {
+            bool deferred = defer_layer_update(layer_id);
             if (tile_index < layer->tiles.size())
             {
                 layer->tiles[tile_index] = tile;
+
+                auto grid = find_tile_grid(layer_id);
+                if (grid && !deferred)
+                {
+                    grid->update_tile(tile_index, tile, track_.tile_library());
+                }
             }
 
             update_tile_preview(layer_id, tile_index, tile);
         }
     }
 
+    void Scene::update_tiles(std::size_t layer_id, const std::vector<std::size_t>& tile_indices,
+        const std::vector<components::Tile>& tiles)
+    {
+        if (auto layer = track_.layer_by_id(layer_id))
+        {
+            for (std::size_t n = 0; n != tile_indices.size(); ++n)
+            {
+                if (tile_indices[n] < layer->tiles.size()) layer->tiles[tile_indices[n]] = tiles[n];
+            }
+
+            if (defer_layer_update(layer_id)) return;
+
+            auto grid = find_tile_grid(layer_id);
+            auto instanced_layer = instanced_rendering_ ? &instanced_layers_[layer_id] : nullptr;
+            auto display_layer = instanced_layer ? nullptr : &track_display_[layer_id];
+
+            for (std::size_t n = 0; n != tile_indices.size(); ++n)
+            {
+                auto tile_index = tile_indices[n];
+                if (tile_index >= layer->tiles.size()) continue;
+
+                const auto& tile = layer->tiles[tile_index];
+                if (grid) grid->update_tile(tile_index, tile, track_.tile_library());
+
+                if (instanced_layer) instanced_layer->update_tile(tile_index, tile, track_.tile_library(), tile_mapping_);
+                else rebuild_tile_vertices(*display_layer, tile_index, tile);
+            }
+        }
+    }
+
     void Scene::update_tile_preview(std::size_t layer_id, std::size_t tile_index, const components::Tile& tile)
     {
+        if (defer_layer_update(layer_id)) return;
+
+        if (instanced_rendering_)
+        {
+            instanced_layers_[layer_id].update_tile(tile_index, tile, track_.tile_library(), tile_mapping_);
+            return;
+        }
+
         rebuild_tile_vertices(track_display_[layer_id], tile_index, tile);
     }
+
+    void Scene::hide_tile(std::size_t layer_id, std::size_t tile_id)
+    {
+        hidden_tiles_.emplace(layer_id, tile_id);
+        if (defer_layer_update(layer_id)) return;
+
+        if (instanced_rendering_)
+        {
+            instanced_layers_[layer_id].set_tile_hidden(tile_id, true);
+            return;
+        }
+
+        auto map_it = track_display_.find(layer_id);
+        if (map_it != track_display_.end())
+        {
+            map_it->second.set_tile_color(tile_id, sf::Color::Transparent);
+        }
+    }
+
+    template <typename Remap>
+    void Scene::remap_hidden_tiles(std::size_t layer_id, Remap remap)
+    {
+        auto begin = hidden_tiles_.lower_bound(std::make_pair(layer_id, std::size_t(0)));
+        auto end = hidden_tiles_.lower_bound(std::make_pair(layer_id + 1, std::size_t(0)));
+        if (begin == end) return;
+
+        std::vector<std::size_t> tile_indices;
+        for (auto it = begin; it != end; ++it) tile_indices.push_back(it->second);
+
+        hidden_tiles_.erase(begin, end);
+        for (auto tile_index : tile_indices)
+        {
+            std::size_t new_index;
+            if (remap(tile_index, new_index)) hidden_tiles_.emplace(layer_id, new_index);
+        }
+    }
+
+    void Scene::apply_hidden_tiles(std::size_t layer_id)
+    {
+        auto begin = hidden_tiles_.lower_bound(std::make_pair(layer_id, std::size_t(0)));
+        auto end = hidden_tiles_.lower_bound(std::make_pair(layer_id + 1, std::size_t(0)));
+
+        for (auto it = begin; it != end; ++it)
+        {
+            if (instanced_rendering_) instanced_layers_[layer_id].set_tile_hidden(it->second, true);
+            else track_display_[layer_id].set_tile_color(it->second, sf::Color::Transparent);
+        }
+    }
+
+    void Scene::show_tile(std::size_t layer_id, std::size_t tile_id)
+    {
+        hidden_tiles_.erase(std::make_pair(layer_id, tile_id));
+        if (defer_layer_update(layer_id)) return;
+
+        if (instanced_rendering_)
+        {
+            instanced_layers_[layer_id].set_tile_hidden(tile_id, false);
+            return;
+        }
+
+        auto map_it = track_display_.find(layer_id);
+        if (map_it != track_display_.end())
+        {
+            map_it->second.set_tile_color(tile_id, sf::Color::White);
+        }
+    }
    
     void Scene::append_tile(std::size_t layer_id, const components::Tile& tile)
     {
@@ -111,6 +236,19 @@ namespace scene
             std::size_t tile_index = layer->tiles.size();
             layer->tiles.push_back(tile);
 
+            if (defer_layer_update(layer_id)) return;
+
+            if (auto grid = find_tile_grid(layer_id))
+            {
+                grid->append_tile(tile, track_.tile_library());
+            }
+
+            if (instanced_rendering_)
+            {
+                instanced_layers_[layer_id].append_tile(tile, track_.tile_library(), tile_mapping_);
+                return;
+            }
+
             tile_cache_.clear();
             components::expand_tile_groups(&tile, &tile + 1, track_.tile_library(), std::back_inserter(tile_cache_));
 
@@ -142,6 +280,23 @@ namespace scene
             tile_index = std::min(tile_index, layer->tiles.size());
 
             layer->tiles.insert(layer->tiles.begin() + tile_index, tile);
+
+            remap_hidden_tiles(layer_id, [=](std::size_t index, std::size_t& new_index)
+            {
+                new_index = index >= tile_index ? index + 1 : index;
+                return true;
+            });
+
+            if (defer_layer_update(layer_id)) return;
+
+            if (tile_index + 1 != layer->tiles.size()) tile_grids_.erase(layer_id);
+            else if (auto grid = find_tile_grid(layer_id)) grid->append_tile(tile, track_.tile_library());
+
+            if (instanced_rendering_)
+            {
+                instanced_layers_[layer_id].insert_tile(tile_index, tile, track_.tile_library(), tile_mapping_);
+                return;
+            }
             
             auto& display_layer = track_display_[layer_id];
             display_layer.insert_tile(tile_index);
@@ -149,6 +304,60 @@ namespace scene
         }
     }
 
+    void Scene::insert_tiles(std::size_t layer_id, const std::vector<std::size_t>& tile_indices,
+        const std::vector<components::Tile>& tiles)
+    {
+        if (tile_indices.size() == 1)
+        {
+            insert_tile(layer_id, tile_indices.front(), tiles.front());
+            return;
+        }
+
+        if (auto layer = track_.layer_by_id(layer_id))
+        {
+            if (tile_indices.empty()) return;
+
+            auto& layer_tiles = layer->tiles;
+
+            std::vector<components::Tile> merged_tiles;
+            merged_tiles.reserve(layer_tiles.size() + tiles.size());
+
+            auto old_it = layer_tiles.begin();
+            for (std::size_t n = 0; n != tile_indices.size(); ++n)
+            {
+                while (merged_tiles.size() < tile_indices[n] && old_it != layer_tiles.end())
+                {
+                    merged_tiles.push_back(*old_it++);
+                }
+
+                merged_tiles.push_back(tiles[n]);
+            }
+
+            merged_tiles.insert(merged_tiles.end(), old_it, layer_tiles.end());
+            layer_tiles = std::move(merged_tiles);
+
+            // The indices are the inserted tiles' final positions.
+            auto inserted_it = tile_indices.begin();
+            std::size_t inserted_count = 0;
+            remap_hidden_tiles(layer_id, [&](std::size_t index, std::size_t& new_index)
+            {
+                for (; inserted_it != tile_indices.end() && *inserted_it <= index + inserted_count; ++inserted_it)
+                {
+                    ++inserted_count;
+                }
+
+                new_index = index + inserted_count;
+                return true;
+            });
+
+            if (defer_layer_update(layer_id)) return;
+
+            // Shifting everything once per inserted tile would be quadratic, rebuilding is linear.
+            tile_grids_.erase(layer_id);
+            rebuild_layer_display(layer_id);
+        }
+    }
+
     void Scene::rebuild_tile_vertices(DisplayLayer& display_layer, std::size_t tile_index, const components::Tile& tile)
     {
         tile_cache_.clear();
@@ -178,19 +387,27 @@ namespace scene
     void Scene::move_all_tiles(core::Vector2<double> offset)
     {
         auto integral_offset = core::vector2_round<std::int32_t>(offset);
+        tile_grids_.clear();
+        invalidate_occlusion();
 
         for (std::size_t layer_id = 0; layer_id != track_.layer_count(); ++layer_id)
         {
             if (auto layer = track_.layer_by_id(layer_id))
             {
-                auto& display_layer = track_display_[layer_id];
-
                 for (auto& tile : layer->tiles)
                 {
                     tile.position += integral_offset;
                 }
 
-                display_layer.translate_vertices(offset);
+                if (instanced_rendering_)
+                {
+                    instanced_layers_[layer_id].translate(integral_offset);
+                }
+
+                else
+                {
+                    track_display_[layer_id].translate_vertices(offset);
+                }
             }
         }
     }
@@ -203,7 +420,14 @@ namespace scene
             auto& tile = layer->tiles[tile_id];
             tile.position += integral_offset;
 
-            rebuild_tile_vertices(track_display_[layer_id], tile_id, tile);
+            if (defer_layer_update(layer_id)) return;
+
+            if (auto grid = find_tile_grid(layer_id))
+            {
+                grid->update_tile(tile_id, tile, track_.tile_library());
+            }
+
+            update_tile_preview(layer_id, tile_id, tile);
         }
     }
 
@@ -214,14 +438,20 @@ namespace scene
         {
             auto& tile = layer->tiles[tile_id];
             
-            auto rotation = tile.rotation + rotation_delta;
-            tile.rotation = core::Rotation<double>::degrees(std::round(rotation.degrees()));
+            tile.rotation = core::Rotation<double>(tile.rotation) + rotation_delta;
 
             auto position = core::vector2_cast<double>(tile.position);
             auto offset = core::transform_point(position - origin, rotation_delta);
             tile.position = core::vector2_round<std::int32_t>(origin + offset);
 
-            rebuild_tile_vertices(track_display_[layer_id], tile_id, tile);
+            if (defer_layer_update(layer_id)) return;
+
+            if (auto grid = find_tile_grid(layer_id))
+            {
+                grid->update_tile(tile_id, tile, track_.tile_library());
+            }
+
+            update_tile_preview(layer_id, tile_id, tile);
         }
     }
 
@@ -233,19 +463,84 @@ namespace scene
             {
                 layer->tiles.erase(layer->tiles.begin() + tile_index);
 
-                track_display_[layer_id].erase_tile(tile_index);
+                remap_hidden_tiles(layer_id, [=](std::size_t index, std::size_t& new_index)
+                {
+                    new_index = index > tile_index ? index - 1 : index;
+                    return index != tile_index;
+                });
+
+                if (defer_layer_update(layer_id)) return;
+
+                if (tile_index != layer->tiles.size()) tile_grids_.erase(layer_id);
+                else if (auto grid = find_tile_grid(layer_id)) grid->erase_last_tiles(1);
+
+                if (instanced_rendering_) instanced_layers_[layer_id].erase_tile(tile_index);
+                else track_display_[layer_id].erase_tile(tile_index);
             }
         }
     }
 
+    void Scene::delete_tiles(std::size_t layer_id, const std::vector<std::size_t>& tile_indices)
+    {
+        if (auto layer = track_.layer_by_id(layer_id))
+        {
+            auto& tiles = layer->tiles;
+
+            auto erased_it = tile_indices.begin();
+            auto erased_end = std::lower_bound(tile_indices.begin(), tile_indices.end(), tiles.size());
+            if (erased_it == erased_end) return;
+
+            auto write_it = tiles.begin() + *erased_it;
+            for (std::size_t tile_index = *erased_it; tile_index != tiles.size(); ++tile_index)
+            {
+                if (erased_it != erased_end && *erased_it == tile_index)
+                {
+                    while (erased_it != erased_end && *erased_it == tile_index) ++erased_it;
+                    continue;
+                }
+
+                *write_it++ = tiles[tile_index];
+            }
+
+            tiles.erase(write_it, tiles.end());
+
+            // The erased indices may contain duplicates.
+            erased_it = tile_indices.begin();
+            std::size_t erased_count = 0;
+            remap_hidden_tiles(layer_id, [&](std::size_t index, std::size_t& new_index)
+            {
+                for (; erased_it != erased_end && *erased_it < index; ++erased_it)
+                {
+                    if (erased_it == tile_indices.begin() || *erased_it != erased_it[-1]) ++erased_count;
+                }
+
+                new_index = index - erased_count;
+                return erased_it == erased_end || *erased_it != index;
+            });
+
+            if (defer_layer_update(layer_id)) return;
+
+            tile_grids_.erase(layer_id);
+
+            if (instanced_rendering_) instanced_layers_[layer_id].erase_tiles(tile_indices);
+            else track_display_[layer_id].erase_tiles(tile_indices);
+        }
+    }
+
     void Scene::delete_last_tile(std::size_t layer_id)
     {
         if (auto layer = track_.layer_by_id(layer_id))
         {
             layer->tiles.pop_back();
+            hidden_tiles_.erase(std::make_pair(layer_id, layer->tiles.size()));
+
+            if (defer_layer_update(layer_id)) return;
+
+            if (auto grid = find_tile_grid(layer_id)) grid->erase_last_tiles(1);
 
             std::size_t tile_index = layer->tiles.size();
-            track_display_[layer_id].erase_tile_vertices(tile_index);
+            if (instanced_rendering_) instanced_layers_[layer_id].erase_last_tiles(1);
+            else track_display_[layer_id].erase_tile_vertices(tile_index);
         }
     }
 
@@ -253,6 +548,28 @@ namespace scene
     {
         if (auto layer = track_.layer_by_id(layer_id))
         {
+            auto new_size = layer->tiles.size() - tile_count;
+            remap_hidden_tiles(layer_id, [=](std::size_t index, std::size_t& new_index)
+            {
+                new_index = index;
+                return index < new_size;
+            });
+
+            if (defer_layer_update(layer_id))
+            {
+                layer->tiles.resize(layer->tiles.size() - tile_count);
+                return;
+            }
+
+            if (auto grid = find_tile_grid(layer_id)) grid->erase_last_tiles(tile_count);
+
+            if (instanced_rendering_)
+            {
+                layer->tiles.resize(layer->tiles.size() - tile_count);
+                instanced_layers_[layer_id].erase_last_tiles(tile_count);
+                return;
+            }
+
             std::size_t tile_index = layer->tiles.size();
             auto& display_layer = track_display_[layer_id];
             
@@ -316,26 +633,35 @@ namespace scene
 
     components::ConstLayerHandle Scene::create_layer(const std::string& name, std::size_t level)
     {
+        invalidate_occlusion();
         return track_.create_layer(name, level);
     }
 
     void Scene::delete_layer(std::size_t layer_id)
     {
+        invalidate_occlusion();
         track_.disable_layer(layer_id);
     }
 
     void Scene::restore_layer(std::size_t layer_id, std::size_t index)
     {
+        invalidate_occlusion();
         track_.restore_layer(layer_id, index);
     }
 
     void Scene::hide_layer(std::size_t layer_id)
     {
+        invalidate_occlusion();
         if (auto layer = track_.layer_by_id(layer_id))
         {
             layer->visible = false;
         }
 
+        if (instanced_rendering_)
+        {
+            instanced_layers_[layer_id].hide();
+        }
+
         auto map_it = track_display_.find(layer_id);
         if (map_it != track_display_.end())
         {
@@ -345,11 +671,17 @@ namespace scene
 
     void Scene::show_layer(std::size_t layer_id)
     {
+        invalidate_occlusion();
         if (auto layer = track_.layer_by_id(layer_id))
         {
             layer->visible = true;
         }
 
+        if (instanced_rendering_)
+        {
+            instanced_layers_[layer_id].show();
+        }
+
         auto map_it = track_display_.find(layer_id);
         if (map_it != track_display_.end())
         {
@@ -359,6 +691,7 @@ namespace scene
 
     void Scene::move_layer(std::size_t layer_id, std::size_t new_index)
     {
+        invalidate_occlusion();
         track_.move_layer(layer_id, new_index);
     }
 
@@ -372,6 +705,7 @@ namespace scene
 
     void Scene::set_layer_level(std::size_t layer_id, std::size_t new_level)
     {
+        invalidate_occlusion();
         track_.set_layer_level(layer_id, new_level);
     }
 
@@ -396,14 +730,15 @@ namespace scene
         return std::distance(layers().begin(), it);
     }
 
-    void Scene::draw(sf::RenderTarget& render_target, sf::RenderStates render_states) const
+    void Scene::draw(sf::RenderTarget& render_target, sf::RenderStates render_states,
+        DetailLevel detail_level) const
     {
         for (const auto& layer_handle : track_.layers())
         {
             auto map_it = track_display_.find(layer_handle.id());
             if (map_it != track_display_.end())
             {
-                scene::draw(map_it->second, render_target, render_states);
+                scene::draw(map_it->second, render_target, render_states, tile_mapping_, detail_level);
             }
         }
     }
@@ -457,9 +792,252 @@ namespace scene
         }
     }
 
-    void draw(const Scene& scene, sf::RenderTarget& render_target, sf::RenderStates render_states)
+    void Scene::enable_instanced_rendering(bool enable)
+    {
+        if (enable == instanced_rendering_) return;
+
+        invalidate_occlusion();
+        instanced_rendering_ = enable;
+        if (enable)
+        {
+            placement_table_ = create_placement_table(tile_mapping_, track_.tile_library());
+
+            for (const auto& layer_handle : track_.layers())
+            {
+                auto map_it = track_display_.find(layer_handle.id());
+                if (map_it != track_display_.end() && !map_it->second.visible())
+                {
+                    instanced_layers_[layer_handle.id()].hide();
+                }
+            }
+
+            // The instanced layers are built when they are first drawn.
+            track_display_.clear();
+        }
+
+        else
+        {
+            track_display_ = create_track_layer_map(track_, tile_mapping_);
+            for (const auto& instanced_layer : instanced_layers_)
+            {
+                if (!instanced_layer.second.visible())
+                {
+                    track_display_[instanced_layer.first].hide();
+                }
+            }
+
+            for (const auto& layer_handle : track_.layers())
+            {
+                apply_hidden_tiles(layer_handle.id());
+            }
+
+            instanced_layers_.clear();
+            placement_table_ = PlacementTable();
+        }
+    }
+
+    bool Scene::instanced_rendering() const
     {
-        scene.draw(render_target, render_states);
+        return instanced_rendering_;
+    }
+
+    void Scene::draw(InstancedRenderer& renderer, sf::RenderTarget& render_target, sf::RenderStates render_states,
+        DetailLevel detail_level)
+    {
+        for (const auto& layer_handle : track_.layers())
+        {
+            auto& instanced_layer = instanced_layers_[layer_handle.id()];
+            if (!instanced_layer.is_valid())
+            {
+                instanced_layer.rebuild(layer_handle->tiles, track_.tile_library(), tile_mapping_);
+                apply_hidden_tiles(layer_handle.id());
+            }
+
+            renderer.draw(instanced_layer, placement_table_, tile_mapping_, render_target, render_states, detail_level);
+        }
+    }
+
+    void draw(const Scene& scene, sf::RenderTarget& render_target, sf::RenderStates render_states,
+        DetailLevel detail_level)
+    {
+        scene.draw(render_target, render_states, detail_level);
+    }
+
+    void Scene::enable_occlusion_culling(bool enable)
+    {
+        if (enable == occlusion_culling_) return;
+
+        occlusion_culling_ = enable;
+        invalidate_occlusion();
+    }
+
+    bool Scene::occlusion_culling() const
+    {
+        return occlusion_culling_;
+    }
+
+    void Scene::invalidate_occlusion()
+    {
+        // Whatever is being computed no longer matches the tiles.
+        occlusion_job_.cancel();
+
+        if (!occlusion_valid_) return;
+
+        occlusion_valid_ = false;
+        occlusion_.clear();
+        for (auto& display_layer : track_display_)
+        {
+            display_layer.second.clear_culled_tiles();
+        }
+
+        for (auto& instanced_layer : instanced_layers_)
+        {
+            instanced_layer.second.clear_culled_tiles();
+        }
+    }
+
+    void Scene::update_occlusion()
+    {
+        // Hidden tiles are about to be redrawn elsewhere, they can't be relied on to cover anything.
+        if (!occlusion_culling_ || occlusion_valid_ || transaction_depth_ != 0 || !hidden_tiles_.empty())
+        {
+            return;
+        }
+
+        if (occlusion_job_.is_ready())
+        {
+            occlusion_ = occlusion_job_.get();
+            apply_occlusion();
+            return;
+        }
+
+        if (occlusion_job_.is_running()) return;
+
+        auto layers = std::make_shared<std::vector<components::OcclusionLayer>>();
+        for (const auto& layer_handle : track_.layers())
+        {
+            layers->push_back({ layer_handle.id(), layer_handle->level, layer_handle->visible, layer_handle->tiles });
+        }
+
+        auto track_size = track_.size();
+        const auto* tile_library = &track_.tile_library();
+        const auto* opaque_tiles = &opaque_tiles_;
+
+        occlusion_job_.start([=](const core::CancellationToken&)
+        {
+            return components::compute_tile_occlusion(*layers, track_size, *tile_library, *opaque_tiles,
+                components::OcclusionScope::Level, false);
+        });
+    }
+
+    void Scene::apply_occlusion()
+    {
+        for (const auto& layer_handle : track_.layers())
+        {
+            auto occlusion_it = occlusion_.find(layer_handle.id());
+            if (occlusion_it == occlusion_.end()) continue;
+
+            const auto& occluded = occlusion_it->second.occluded;
+            if (instanced_rendering_)
+            {
+                instanced_layers_[layer_handle.id()].set_culled_tiles(occluded);
+            }
+
+            else
+            {
+                auto map_it = track_display_.find(layer_handle.id());
+                if (map_it != track_display_.end()) map_it->second.set_culled_tiles(occluded);
+            }
+        }
+
+        occlusion_valid_ = true;
+    }
+
+    bool Scene::occlusion_valid() const
+    {
+        return occlusion_valid_;
+    }
+
+    std::size_t Scene::occluded_tile_count(std::size_t layer_id) const
+    {
+        auto occlusion_it = occlusion_.find(layer_id);
+        if (occlusion_it == occlusion_.end()) return 0;
+
+        return occlusion_it->second.occluded_count;
+    }
+
+    void Scene::begin_transaction()
+    {
+        ++transaction_depth_;
+    }
+
+    void Scene::end_transaction()
+    {
+        if (transaction_depth_ == 0 || --transaction_depth_ != 0) return;
+
+        for (auto layer_id : transaction_layers_)
+        {
+            rebuild_layer_display(layer_id);
+        }
+
+        transaction_layers_.clear();
+    }
+
+    void Scene::rebuild_layer_display(std::size_t layer_id)
+    {
+        auto layer = track_.layer_by_id(layer_id);
+        if (!layer) return;
+
+        if (instanced_rendering_)
+        {
+            instanced_layers_[layer_id].invalidate();
+            return;
+        }
+
+        auto& display_layer = track_display_[layer_id];
+        bool visible = display_layer.visible();
+
+        display_layer = create_display_layer(layer->tiles.begin(), layer->tiles.end(), 
+            track_.tile_library(), tile_mapping_);
+
+        if (!visible) display_layer.hide();
+
+        apply_hidden_tiles(layer_id);
+    }
+
+    bool Scene::defer_layer_update(std::size_t layer_id)
+    {
+        invalidate_occlusion();
+        if (transaction_depth_ == 0) return false;
+
+        // The layer's grid is rebuilt on demand from the updated tiles.
+        transaction_layers_.insert(layer_id);
+        tile_grids_.erase(layer_id);
+
+        return true;
+    }
+
+    TileGrid* Scene::find_tile_grid(std::size_t layer_id)
+    {
+        auto grid_it = tile_grids_.find(layer_id);
+        if (grid_it == tile_grids_.end()) return nullptr;
+
+        return &grid_it->second;
+    }
+
+    const TileGrid& Scene::tile_grid(std::size_t layer_id)
+    {
+        auto grid_it = tile_grids_.find(layer_id);
+        if (grid_it == tile_grids_.end())
+        {
+            grid_it = tile_grids_.emplace(layer_id, TileGrid()).first;
+            if (auto layer = track_.layer_by_id(layer_id))
+            {
+                grid_it->second.rebuild(layer->tiles, track_.tile_library());
+            }
+        }
+
+        return grid_it->second;
     }
 
     std::vector<components::Tile> Scene::fill_area(std::size_t layer_id, const components::TileGroupDefinition& tile_group,
@@ -468,15 +1046,46 @@ namespace scene
         auto time = std::chrono::high_resolution_clock::now().time_since_epoch();        
         std::mt19937_64 rng(std::chrono::duration_cast<std::chrono::milliseconds>(time).count());
 
-        std::vector<components::Tile> tiles;
-        components::fill_area(tile_group, track_.tile_library(), properties,
-            rng, std::back_inserter(tiles));
+        // Large fills are generated in bands of rows on several threads, each with its own generator.
+        const std::size_t min_band_size = 16384;
+
+        auto layout = components::make_fill_layout(tile_group, track_.tile_library(), properties);
+        std::size_t candidate_count = layout.row_count * layout.column_count;
+
+        std::size_t worker_count = std::max(std::thread::hardware_concurrency(), 1U);
+        std::size_t band_count = std::min(worker_count, candidate_count / min_band_size + 1);
+        band_count = std::max<std::size_t>(std::min(band_count, layout.row_count), 1);
+
+        std::size_t rows_per_band = (layout.row_count + band_count - 1) / band_count;
+
+        auto generate_band = [&](std::size_t band_index, std::uint64_t seed)
+        {
+            std::mt19937_64 band_rng(seed);
+            std::vector<components::Tile> band_tiles;
+
+            auto row_begin = std::min(band_index * rows_per_band, layout.row_count);
+            auto row_end = std::min(row_begin + rows_per_band, layout.row_count);
+
+            components::fill_rows(layout, tile_group, properties, row_begin, row_end, 
+                band_rng, std::back_inserter(band_tiles));
+
+            return band_tiles;
+        };
+
+        std::vector<std::future<std::vector<components::Tile>>> bands;
+        for (std::size_t band_index = 1; band_index < band_count; ++band_index)
+        {
+            bands.push_back(std::async(std::launch::async, generate_band, band_index, rng()));
+        }
 
-        for (const auto& tile : tiles)
+        std::vector<components::Tile> tiles = generate_band(0, rng());
+        for (auto& band : bands)
         {
-            append_tile(layer_id, tile);
+            auto band_tiles = band.get();
+            tiles.insert(tiles.end(), band_tiles.begin(), band_tiles.end());
         }
 
+        append_tiles(layer_id, tiles.begin(), tiles.end());
         return tiles;
     }
 }
\ No newline at end of file
@@ -28,9 +28,18 @@
 
 #include "track_display.hpp"
 #include "tile_mapping.hpp"
+#include "instanced_renderer.hpp"
+#include "tile_grid.hpp"
 
 #include "components/track.hpp"
 #include "components/pattern_store.hpp"
+#include "components/tile_occlusion.hpp"
+#include "components/track_hash.hpp"
+#include "components/track_saving.hpp"
+
+#include "core/latest_job.hpp"
+
+#include <set>
 
 namespace components
 {
@@ -59,9 +68,20 @@ namespace scene
 
         void insert_tile(std::size_t layer_id, std::size_t tile_index, const components::Tile& tile);
 
+        // Inserts the tiles so that they end up at the given indices, which must be sorted.
+        void insert_tiles(std::size_t layer_id, const std::vector<std::size_t>& tile_indices,
+            const std::vector<components::Tile>& tiles);
+
         void update_tile(std::size_t layer_id, std::size_t tile_id, const components::Tile& tile);
+        void update_tiles(std::size_t layer_id, const std::vector<std::size_t>& tile_indices,
+            const std::vector<components::Tile>& tiles);
         void update_tile_preview(std::size_t layer_id, std::size_t tile_id, const components::Tile& tile);
 
+        // Hidden tiles keep their vertices, they are just not visible until shown again
+        // or until their vertices are rebuilt.
+        void hide_tile(std::size_t layer_id, std::size_t tile_id);
+        void show_tile(std::size_t layer_id, std::size_t tile_id);
+
         void move_all_tiles(core::Vector2<double> offset);
 
         void move_tile(std::size_t layer_id, std::size_t tile_id, core::Vector2<double> offset);
@@ -71,9 +91,17 @@ namespace scene
 
         void delete_tile(std::size_t layer_id, std::size_t tile_index);
 
+        // Tile indices must be sorted.
+        void delete_tiles(std::size_t layer_id, const std::vector<std::size_t>& tile_indices);
+
         void delete_last_tile(std::size_t layer_id);
         void delete_last_tiles(std::size_t layer_id, std::size_t tile_count);
 
+        // Between these calls, tile operations only change the track data. The display of
+        // every layer that was touched is rebuilt once when the outermost transaction ends.
+        void begin_transaction();
+        void end_transaction();
+
         void append_control_point(const components::ControlPoint& point);
         void insert_control_point(std::size_t index, const components::ControlPoint& point);
         void update_control_point(std::size_t index, const components::ControlPoint& point);
@@ -97,6 +125,8 @@ namespace scene
 
         const components::TileLibrary& tile_library() const;
         const components::PatternStore& pattern_store() const;
+        components::PatternHashCache& pattern_hash_cache();
+        components::WrittenPattern& written_pattern();
 
         const TileMapping& tile_mapping() const;
         const DisplayLayerMap& display_layers() const;
@@ -118,23 +148,82 @@ namespace scene
         // Returns layer_count() if not found.
         std::size_t find_layer_index(std::size_t layer_id) const;
 
+        // The tile grid of a layer is built when it's first requested, and kept up to date
+        // by the tile operations from then on.
+        const TileGrid& tile_grid(std::size_t layer_id);
+
         std::vector<components::Tile> fill_area(std::size_t layer_id, const components::TileGroupDefinition& tile_group,
             const components::FillProperties& fill_properties);
 
-        void draw(sf::RenderTarget& render_target, sf::RenderStates render_states) const;
+        void draw(sf::RenderTarget& render_target, sf::RenderStates render_states,
+            DetailLevel detail_level = DetailLevel::Full) const;
+
+        // With instanced rendering, the scene keeps compact instance records instead of
+        // vertices, and has to be drawn with an InstancedRenderer.
+        void enable_instanced_rendering(bool enable);
+        bool instanced_rendering() const;
+
+        void draw(InstancedRenderer& renderer, sf::RenderTarget& render_target, sf::RenderStates render_states,
+            DetailLevel detail_level = DetailLevel::Full);
+
+        // With occlusion culling, tiles that are completely covered by opaque tiles on the same level
+        // are left out when drawing. Any change to the tiles or layers suspends it. update_occlusion()
+        // computes it in the background from a copy of the tiles, and applies the result once a later 
+        // call finds it done, unless something has changed in the meantime.
+        void enable_occlusion_culling(bool enable);
+        bool occlusion_culling() const;
+        void update_occlusion();
+
+        // Whether the occlusion matches the current tiles.
+        bool occlusion_valid() const;
+
+        // Number of overdrawn tiles in the layer as of the last update, zero if not known.
+        std::size_t occluded_tile_count(std::size_t layer_id) const;
 
     private:
         friend class SceneLoader;
         Scene(components::Track&& track, components::PatternStore&& pattern_loader,
-            TileMapping&& tile_mapping, DisplayLayerMap&& display_layer_map);
+            TileMapping&& tile_mapping, DisplayLayerMap&& display_layer_map, std::vector<bool>&& opaque_tiles);
 
         void rebuild_tile_vertices(DisplayLayer& layer, std::size_t tile_id, const components::Tile& tile);
+        void rebuild_layer_display(std::size_t layer_id);
+        TileGrid* find_tile_grid(std::size_t layer_id);
+        bool defer_layer_update(std::size_t layer_id);
+
+        // Hidden tiles are tracked by index, so they have to follow the tiles around.
+        // remap(index, new_index) is called in index order and returns false for erased tiles.
+        template <typename Remap>
+        void remap_hidden_tiles(std::size_t layer_id, Remap remap);
+        void apply_hidden_tiles(std::size_t layer_id);
+
+        void invalidate_occlusion();
+        void apply_occlusion();
 
         components::Track track_;
         components::PatternStore pattern_store_;
+        components::PatternHashCache pattern_hash_cache_;
+        components::WrittenPattern written_pattern_;
         TileMapping tile_mapping_;
         DisplayLayerMap track_display_;        
 
+        bool instanced_rendering_ = false;
+        PlacementTable placement_table_;
+        std::unordered_map<std::size_t, InstancedLayer> instanced_layers_;
+
+        std::unordered_map<std::size_t, TileGrid> tile_grids_;
+
+        std::vector<bool> opaque_tiles_;
+        components::OcclusionMap occlusion_;
+        bool occlusion_culling_ = false;
+        bool occlusion_valid_ = false;
+
+        // Refers to the tile library and the opaque tiles, so it has to come after them.
+        core::LatestJob<components::OcclusionMap> occlusion_job_;
+        std::set<std::pair<std::size_t, std::size_t>> hidden_tiles_;
+
+        std::size_t transaction_depth_ = 0;
+        std::set<std::size_t> transaction_layers_;
+
         std::vector<components::PlacedTile> tile_cache_;
         std::vector<sf::Vertex> vertex_cache_;
         DisplayLayer layer_cache_;
@@ -143,13 +232,48 @@ namespace scene
     template <typename TileIt>
     void Scene::append_tiles(std::size_t layer_id, TileIt it, TileIt end)
     {
-        for (; it != end; ++it)
+        if (auto layer = track_.layer_by_id(layer_id))
         {
-            append_tile(layer_id, *it);
+            std::size_t tile_index = layer->tiles.size();
+            layer->tiles.insert(layer->tiles.end(), it, end);
+
+            if (tile_index == layer->tiles.size() || defer_layer_update(layer_id)) return;
+
+            auto tile_begin = layer->tiles.begin() + tile_index, tile_end = layer->tiles.end();
+            if (auto grid = find_tile_grid(layer_id))
+            {
+                for (auto tile_it = tile_begin; tile_it != tile_end; ++tile_it)
+                {
+                    grid->append_tile(*tile_it, track_.tile_library());
+                }
+            }
+
+            if (instanced_rendering_)
+            {
+                auto& instanced_layer = instanced_layers_[layer_id];
+                for (auto tile_it = tile_begin; tile_it != tile_end; ++tile_it)
+                {
+                    instanced_layer.append_tile(*tile_it, track_.tile_library(), tile_mapping_);
+                }
+
+                return;
+            }
+
+            // Build the new tiles' vertices separately and append them all at once. The existing
+            // layer has to account for every tile for the indices to line up.
+            auto& display_layer = track_display_[layer_id];
+            if (display_layer.tile_count() < tile_index)
+            {
+                display_layer.insert_tile(tile_index - 1);
+            }
+
+            display_layer.append_layer(create_display_layer_concurrently(layer->tiles, tile_index, layer->tiles.size(),
+                track_.tile_library(), tile_mapping_));
         }
     }
 
-    void draw(const Scene& scene, sf::RenderTarget& render_target, sf::RenderStates render_states);
+    void draw(const Scene& scene, sf::RenderTarget& render_target, sf::RenderStates render_states,
+        DetailLevel detail_level = DetailLevel::Full);
 }
 
 
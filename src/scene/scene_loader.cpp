@@ -34,103 +34,188 @@
 #include "components/track.hpp"
 #include "components/tile_definition.hpp"
 #include "components/pattern.hpp"
+#include "components/tile_occlusion.hpp"
+#include "components/track_saving.hpp"
+
+#include <SFML/Window/Context.hpp>
 
 #include <unordered_set>
+#include <unordered_map>
 
 namespace scene
 {
+    namespace
+    {
+        // A tile hides whatever is below it when both its image and its pattern area are fully opaque.
+        std::vector<bool> find_opaque_tiles(const components::TileLibrary& tile_library,
+            graphics::ImageLoader& image_loader, components::PatternStore& pattern_store)
+        {
+            std::vector<bool> result;
+            for (auto tile = tile_library.first_tile(); tile; tile = tile_library.next_tile(tile->id))
+            {
+                core::Vector2i area_size(tile->pattern_rect.width, tile->pattern_rect.height);
+                if (!components::is_solid_pattern_block(pattern_store.tile_block(*tile), area_size)) continue;
+
+                const auto* image = image_loader.load_from_file(tile->image_file, std::nothrow);
+                if (!image) continue;
+
+                auto rect = tile->image_rect;
+                auto image_size = image->getSize();
+                if (rect.left < 0 || rect.top < 0 || rect.width <= 0 || rect.height <= 0 ||
+                    static_cast<std::uint32_t>(rect.right()) > image_size.x || 
+                    static_cast<std::uint32_t>(rect.bottom()) > image_size.y)
+                {
+                    continue;
+                }
+
+                const auto* pixels = image->getPixelsPtr();
+                bool opaque = true;
+                for (std::int32_t y = rect.top; y != rect.bottom() && opaque; ++y)
+                {
+                    const auto* row = pixels + (y * image_size.x + rect.left) * 4;
+                    for (std::int32_t x = 0; x != rect.width; ++x)
+                    {
+                        if (row[x * 4 + 3] != 255)
+                        {
+                            opaque = false;
+                            break;
+                        }
+                    }
+                }
+
+                if (!opaque) continue;
+
+                if (tile->id >= result.size()) result.resize(tile->id + 1, false);
+                result[tile->id] = true;
+            }
+
+            return result;
+        }
+    }
+
     void SceneLoader::async_load_scene(std::function<components::Track()> load_track)
     {
-        auto loading_function = [=]()
+        auto status = std::make_shared<LoadingStatus>();
+        status_ = status;
+
+        auto loading_function = [=](const core::CancellationToken& cancellation)
         {
-            return load_scene(load_track);
+            return load_scene(load_track, *status, cancellation);
         };
 
-        future_ = std::async(std::launch::async, loading_function);
+        loading_job_.start(loading_function);
+    }
+
+    void SceneLoader::cancel()
+    {
+        loading_job_.cancel();
     }
 
-    std::unique_ptr<Scene> SceneLoader::load_scene(std::function<components::Track()> load_track)
+    std::unique_ptr<Scene> SceneLoader::load_scene(std::function<components::Track()> load_track,
+        LoadingStatus& status, const core::CancellationToken& cancellation)
     {
-        loading_progress_ = 0.0;
-        max_progress_ = 1.0;
-        loading_state_ = LoadingState::Preprocessing;
+        status.progress = 0.0;
+        status.max_progress = 1.0;
+        status.state = LoadingState::Preprocessing;
         components::Track track = load_track();
         const auto& tile_library = track.tile_library();
 
-        loading_state_ = LoadingState::LoadingImages;
+        cancellation.throw_if_cancelled();
+
+        status.state = LoadingState::LoadingImages;
         std::unordered_set<std::string> distinct_images;
-        std::unordered_set<std::string> distinct_patterns;
+        std::unordered_map<std::string, std::vector<const components::TileDefinition*>> tiles_by_pattern;
         for (auto tile = tile_library.first_tile(); tile; tile = tile_library.next_tile(tile->id))
         {
             distinct_images.insert(tile->image_file);
-            distinct_patterns.insert(tile->pattern_file);
+            tiles_by_pattern[tile->pattern_file].push_back(tile);
         }
 
-        loading_progress_ = 0.0;
+        status.progress = 0.0;
         graphics::ImageLoader image_loader;
         std::size_t num_images = distinct_images.size(), images_loaded = 0;
         for (const auto& image : distinct_images)
         {
+            cancellation.throw_if_cancelled();
+
             image_loader.load_from_file(image);
             ++images_loaded;
-            loading_progress_ = images_loaded / static_cast<double>(num_images);
+            status.progress = images_loaded / static_cast<double>(num_images);
         }
 
-        loading_progress_ = 0.0;
-        loading_state_ = LoadingState::LoadingPatterns;
-        std::size_t num_patterns = distinct_patterns.size(), patterns_loaded = 0;
+        status.progress = 0.0;
+        status.state = LoadingState::LoadingPatterns;
+        std::size_t num_patterns = tiles_by_pattern.size(), patterns_loaded = 0;
         components::PatternStore pattern_store;
-        for (const auto& pattern : distinct_patterns)
+        for (const auto& pattern : tiles_by_pattern)
         {
-            pattern_store.load_from_file(pattern);
+            cancellation.throw_if_cancelled();
+
+            pattern_store.load_tile_blocks(pattern.second);
             ++patterns_loaded;
-            loading_progress_ = patterns_loaded / static_cast<double>(num_patterns);
+            status.progress = patterns_loaded / static_cast<double>(num_patterns);
         }
 
-        std::function<void(double)> update_progress = [=](double progress)
+        // Lets the first save skip the pattern if it comes out the same as the file it was loaded from.
+        auto written_pattern = components::read_written_pattern(track);
+
+        auto opaque_tiles = find_opaque_tiles(tile_library, image_loader, pattern_store);
+
+        // Doubles as the cancellation point for the stages that report their progress.
+        std::function<void(double)> update_progress = [&status, &cancellation](double progress)
         {
-            loading_progress_ = progress;
+            cancellation.throw_if_cancelled();
+
+            status.progress = progress;
         };
         
-        loading_progress_ = 0.0;
-        loading_state_ = LoadingState::MappingTiles;
+        // The atlas pages are created on this thread, which needs a context of its own.
+        sf::Context context;
+
+        status.progress = 0.0;
+        status.state = LoadingState::MappingTiles;
         auto tile_mapping = create_tile_mapping(track.tile_library(), std::move(image_loader), update_progress);        
 
-        loading_progress_ = 0.0;
-        loading_state_ = LoadingState::BuildingScene;
-        auto track_display = create_track_layer_map(track, tile_mapping, update_progress);        
+        status.progress = 0.0;
+        status.state = LoadingState::BuildingScene;
+        auto track_display = create_track_layer_map(track, tile_mapping, update_progress, cancellation);        
+
+        cancellation.throw_if_cancelled();
+
+        std::unique_ptr<Scene> scene(new Scene(std::move(track), std::move(pattern_store), 
+            std::move(tile_mapping), std::move(track_display), std::move(opaque_tiles)));
 
-        return std::unique_ptr<Scene>(new Scene(std::move(track), std::move(pattern_store), 
-            std::move(tile_mapping), std::move(track_display)));
+        scene->written_pattern_ = std::move(written_pattern);
+        return scene;
     }
 
     bool SceneLoader::is_finished() const
     {
-        return future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        return loading_job_.is_ready();
     }
 
     bool SceneLoader::is_loading() const
     {
-        return future_.valid();
+        return loading_job_.is_running();
     }
 
     double SceneLoader::loading_progress() const
     {
-        return loading_progress_;
+        return status_->progress;
     }
 
     double SceneLoader::max_progress() const
     {
-        return max_progress_;
+        return status_->max_progress;
     }
 
     LoadingState SceneLoader::loading_state() const
     {
-        return loading_state_;
+        return status_->state;
     }
 
     std::unique_ptr<Scene> SceneLoader::get_result()
     {
-        return future_.get();
+        return loading_job_.get();
     }
 }
\ No newline at end of file
@@ -26,9 +26,10 @@
 #ifndef SCENE_LOADER_HPP
 #define SCENE_LOADER_HPP
 
+#include "core/latest_job.hpp"
+
 #include <memory>
 #include <atomic>
-#include <future>
 #include <functional>
 
 namespace components
@@ -52,7 +53,9 @@ namespace scene
     class SceneLoader
     {
     public:
+        // Starting a new load cancels the one in progress, if any.
         void async_load_scene(std::function<components::Track()> load_track);
+        void cancel();
 
         bool is_loading() const;
         bool is_finished() const;
@@ -64,13 +67,20 @@ namespace scene
         std::unique_ptr<Scene> get_result();
 
     private:
-        std::unique_ptr<Scene> load_scene(std::function<components::Track()> load_track);
+        // Every load reports to its own status, so that a cancelled load that is still winding down
+        // can't overwrite the progress of the one that replaced it.
+        struct LoadingStatus
+        {
+            std::atomic<LoadingState> state{ LoadingState::Preprocessing };
+            std::atomic<double> progress{ 0.0 };
+            std::atomic<double> max_progress{ 1.0 };
+        };
 
-        std::future<std::unique_ptr<Scene>> future_;
+        static std::unique_ptr<Scene> load_scene(std::function<components::Track()> load_track,
+            LoadingStatus& status, const core::CancellationToken& cancellation);
 
-        std::atomic<LoadingState> loading_state_;
-        std::atomic<double> loading_progress_;
-        std::atomic<double> max_progress_;
+        core::LatestJob<std::unique_ptr<Scene>> loading_job_;
+        std::shared_ptr<LoadingStatus> status_ = std::make_shared<LoadingStatus>();
     };
 }
 
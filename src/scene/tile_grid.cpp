@@ -0,0 +1,252 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "tile_grid.hpp"
+
+#include "components/tile_library.hpp"
+#include "components/tile_group_expansion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace scene
+{
+    namespace
+    {
+        std::int32_t floor_divide(std::int32_t value, std::int32_t divisor)
+        {
+            std::int32_t result = value / divisor;
+            if (value % divisor != 0 && value < 0) --result;
+
+            return result;
+        }
+    }
+
+    TileGrid::TileGrid(std::int32_t cell_size)
+        : cell_size_(cell_size)
+    {
+    }
+
+    void TileGrid::clear()
+    {
+        tile_bounds_.clear();
+        cells_.clear();
+    }
+
+    void TileGrid::rebuild(const std::vector<components::Tile>& tiles, const components::TileLibrary& tile_library)
+    {
+        clear();
+
+        tile_bounds_.reserve(tiles.size());
+        for (const auto& tile : tiles)
+        {
+            append_tile(tile, tile_library);
+        }
+    }
+
+    std::size_t TileGrid::tile_count() const
+    {
+        return tile_bounds_.size();
+    }
+
+    core::IntRect TileGrid::tile_bounds(std::size_t tile_index) const
+    {
+        return tile_bounds_[tile_index];
+    }
+
+    TileGrid::CellKey TileGrid::cell_key(std::int32_t cell_x, std::int32_t cell_y) const
+    {
+        return (static_cast<CellKey>(static_cast<std::uint32_t>(cell_x)) << 32) | static_cast<std::uint32_t>(cell_y);
+    }
+
+    core::IntRect TileGrid::cell_range(core::IntRect bounds) const
+    {
+        std::int32_t left = floor_divide(bounds.left, cell_size_);
+        std::int32_t top = floor_divide(bounds.top, cell_size_);
+        std::int32_t right = floor_divide(bounds.right() - 1, cell_size_) + 1;
+        std::int32_t bottom = floor_divide(bounds.bottom() - 1, cell_size_) + 1;
+
+        return core::IntRect(left, top, right - left, bottom - top);
+    }
+
+    std::int32_t TileGrid::tile_group_radius(components::TileId tile_id, const components::TileLibrary& tile_library)
+    {
+        auto cache_it = radius_cache_.find(tile_id);
+        if (cache_it != radius_cache_.end()) return cache_it->second;
+
+        components::Tile dummy_tile;
+        dummy_tile.id = tile_id;
+
+        tile_cache_.clear();
+        components::expand_tile_groups(&dummy_tile, &dummy_tile + 1, tile_library, std::back_inserter(tile_cache_));
+
+        // The distance from the group's origin to the farthest corner any of its parts
+        // can reach, whatever the rotation.
+        double radius = -1.0;
+        for (const auto& placed_tile : tile_cache_)
+        {
+            const auto& pattern_rect = placed_tile.tile_def->pattern_rect;
+            const auto& position = placed_tile.tile.position;
+
+            double distance = std::hypot(position.x, position.y) + 
+                std::hypot(pattern_rect.width * 0.5, pattern_rect.height * 0.5);
+
+            radius = std::max(radius, distance);
+        }
+
+        auto result = radius < 0.0 ? -1 : static_cast<std::int32_t>(std::ceil(radius)) + 1;
+        radius_cache_.emplace(tile_id, result);
+        return result;
+    }
+
+    core::IntRect TileGrid::compute_bounds(const components::Tile& tile, const components::TileLibrary& tile_library)
+    {
+        auto radius = tile_group_radius(tile.id, tile_library);
+        if (radius < 0) return core::IntRect();
+
+        return core::IntRect(tile.position.x - radius, tile.position.y - radius, radius * 2 + 1, radius * 2 + 1);
+    }
+
+    void TileGrid::add_to_cells(std::size_t tile_index)
+    {
+        auto bounds = tile_bounds_[tile_index];
+        if (bounds.width <= 0 || bounds.height <= 0) return;
+
+        auto range = cell_range(bounds);
+        for (std::int32_t y = range.top; y != range.bottom(); ++y)
+        {
+            for (std::int32_t x = range.left; x != range.right(); ++x)
+            {
+                cells_[cell_key(x, y)].push_back(static_cast<std::uint32_t>(tile_index));
+            }
+        }
+    }
+
+    void TileGrid::remove_from_cells(std::size_t tile_index)
+    {
+        auto bounds = tile_bounds_[tile_index];
+        if (bounds.width <= 0 || bounds.height <= 0) return;
+
+        auto range = cell_range(bounds);
+        for (std::int32_t y = range.top; y != range.bottom(); ++y)
+        {
+            for (std::int32_t x = range.left; x != range.right(); ++x)
+            {
+                auto cell_it = cells_.find(cell_key(x, y));
+                if (cell_it == cells_.end()) continue;
+
+                auto& cell = cell_it->second;
+                auto it = std::find(cell.begin(), cell.end(), static_cast<std::uint32_t>(tile_index));
+                if (it != cell.end())
+                {
+                    *it = cell.back();
+                    cell.pop_back();
+                }
+
+                if (cell.empty()) cells_.erase(cell_it);
+            }
+        }
+    }
+
+    void TileGrid::append_tile(const components::Tile& tile, const components::TileLibrary& tile_library)
+    {
+        tile_bounds_.push_back(compute_bounds(tile, tile_library));
+        add_to_cells(tile_bounds_.size() - 1);
+    }
+
+    void TileGrid::update_tile(std::size_t tile_index, const components::Tile& tile, 
+        const components::TileLibrary& tile_library)
+    {
+        if (tile_index >= tile_bounds_.size()) return;
+
+        auto bounds = compute_bounds(tile, tile_library);
+        auto& old_bounds = tile_bounds_[tile_index];
+        if (bounds.left == old_bounds.left && bounds.top == old_bounds.top &&
+            bounds.width == old_bounds.width && bounds.height == old_bounds.height)
+        {
+            return;
+        }
+
+        remove_from_cells(tile_index);
+        old_bounds = bounds;
+        add_to_cells(tile_index);
+    }
+
+    void TileGrid::erase_last_tiles(std::size_t tile_count)
+    {
+        tile_count = std::min(tile_count, tile_bounds_.size());
+        for (; tile_count != 0; --tile_count)
+        {
+            remove_from_cells(tile_bounds_.size() - 1);
+            tile_bounds_.pop_back();
+        }
+    }
+
+    void TileGrid::find_tiles(core::Vector2i point, std::vector<std::size_t>& result) const
+    {
+        auto cell_it = cells_.find(cell_key(floor_divide(point.x, cell_size_), floor_divide(point.y, cell_size_)));
+        if (cell_it == cells_.end()) return;
+
+        auto result_size = result.size();
+        for (auto tile_index : cell_it->second)
+        {
+            if (core::contains(tile_bounds_[tile_index], point))
+            {
+                result.push_back(tile_index);
+            }
+        }
+
+        std::sort(result.begin() + result_size, result.end());
+    }
+
+    void TileGrid::find_tiles(core::IntRect area, std::vector<std::size_t>& result) const
+    {
+        if (area.width <= 0 || area.height <= 0) return;
+
+        auto result_size = result.size();
+        auto range = cell_range(area);
+        for (std::int32_t y = range.top; y != range.bottom(); ++y)
+        {
+            for (std::int32_t x = range.left; x != range.right(); ++x)
+            {
+                auto cell_it = cells_.find(cell_key(x, y));
+                if (cell_it == cells_.end()) continue;
+
+                for (auto tile_index : cell_it->second)
+                {
+                    if (core::intersects(tile_bounds_[tile_index], area))
+                    {
+                        result.push_back(tile_index);
+                    }
+                }
+            }
+        }
+
+        // Tiles that span several cells are found more than once.
+        std::sort(result.begin() + result_size, result.end());
+        result.erase(std::unique(result.begin() + result_size, result.end()), result.end());
+    }
+}
@@ -0,0 +1,89 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef TILE_GRID_HPP
+#define TILE_GRID_HPP
+
+#include "components/tile_definition.hpp"
+
+#include "core/rect.hpp"
+#include "core/vector2.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace components
+{
+    class TileLibrary;
+}
+
+namespace scene
+{
+    // class TileGrid. Uniform grid over the tiles of a layer, used to find the tiles at a given 
+    // point or in a given area without having to test every tile. The tile bounds are conservative:
+    // they contain the tile group at any rotation, so candidates still need an exact test.
+    // Inserting or erasing a tile before the end would renumber the cells, the grid is rebuilt instead.
+    class TileGrid
+    {
+    public:
+        explicit TileGrid(std::int32_t cell_size = 128);
+
+        void clear();
+        void rebuild(const std::vector<components::Tile>& tiles, const components::TileLibrary& tile_library);
+
+        void append_tile(const components::Tile& tile, const components::TileLibrary& tile_library);
+        void update_tile(std::size_t tile_index, const components::Tile& tile, const components::TileLibrary& tile_library);
+        void erase_last_tiles(std::size_t tile_count);
+
+        std::size_t tile_count() const;
+        core::IntRect tile_bounds(std::size_t tile_index) const;
+
+        // Both append the matching tile indices to the result, in ascending order.
+        void find_tiles(core::Vector2i point, std::vector<std::size_t>& result) const;
+        void find_tiles(core::IntRect area, std::vector<std::size_t>& result) const;
+
+    private:
+        using CellKey = std::uint64_t;
+        CellKey cell_key(std::int32_t cell_x, std::int32_t cell_y) const;
+        core::IntRect cell_range(core::IntRect bounds) const;
+
+        core::IntRect compute_bounds(const components::Tile& tile, const components::TileLibrary& tile_library);
+        std::int32_t tile_group_radius(components::TileId tile_id, const components::TileLibrary& tile_library);
+
+        void add_to_cells(std::size_t tile_index);
+        void remove_from_cells(std::size_t tile_index);
+
+        std::int32_t cell_size_;
+        std::vector<core::IntRect> tile_bounds_;
+        std::unordered_map<CellKey, std::vector<std::uint32_t>> cells_;
+
+        std::unordered_map<components::TileId, std::int32_t> radius_cache_;
+        std::vector<components::PlacedTile> tile_cache_;
+    };
+}
+
+#endif
@@ -25,10 +25,94 @@
 
 #include "tile_mapping.hpp"
 
+#include <SFML/OpenGL.hpp>
+
 #include <functional>
+#include <algorithm>
+#include <cstdint>
 
 namespace scene
 {
+    namespace
+    {
+        struct MipLevel
+        {
+            std::uint32_t width = 0;
+            std::uint32_t height = 0;
+            std::vector<sf::Uint8> pixels;
+            std::vector<core::IntRect> tile_rects;
+        };
+
+        // Box-filter a level down to half its size. Every tile rect is reduced on its own, with the samples
+        // clamped to the rect, so that neighbouring tiles in the atlas don't bleed into each other.
+        // A reduced pixel belongs to the rect that contains its top-left sample.
+        MipLevel reduce_level(const sf::Uint8* source, std::uint32_t source_width, std::uint32_t source_height,
+            const std::vector<core::IntRect>& tile_rects)
+        {
+            MipLevel result;
+            result.width = std::max<std::uint32_t>(source_width / 2, 1);
+            result.height = std::max<std::uint32_t>(source_height / 2, 1);
+            result.pixels.resize(result.width * result.height * 4);
+
+            for (const auto& rect : tile_rects)
+            {
+                std::uint32_t left = (rect.left + 1) / 2, top = (rect.top + 1) / 2;
+                std::uint32_t right = std::min<std::uint32_t>((rect.right() + 1) / 2, result.width);
+                std::uint32_t bottom = std::min<std::uint32_t>((rect.bottom() + 1) / 2, result.height);
+                if (left >= right || top >= bottom) continue;
+
+                result.tile_rects.emplace_back(left, top, right - left, bottom - top);
+
+                for (std::uint32_t y = top; y != bottom; ++y)
+                {
+                    std::uint32_t y0 = y * 2;
+                    std::uint32_t y1 = std::min<std::uint32_t>(y0 + 1, rect.bottom() - 1);
+
+                    auto pixel_ptr = result.pixels.data() + (y * result.width + left) * 4;
+                    for (std::uint32_t x = left; x != right; ++x, pixel_ptr += 4)
+                    {
+                        std::uint32_t x0 = x * 2;
+                        std::uint32_t x1 = std::min<std::uint32_t>(x0 + 1, rect.right() - 1);
+
+                        const sf::Uint8* samples[4] =
+                        {
+                            source + (y0 * source_width + x0) * 4,
+                            source + (y0 * source_width + x1) * 4,
+                            source + (y1 * source_width + x0) * 4,
+                            source + (y1 * source_width + x1) * 4
+                        };
+
+                        for (int channel = 0; channel != 4; ++channel)
+                        {
+                            pixel_ptr[channel] = static_cast<sf::Uint8>((samples[0][channel] + samples[1][channel] +
+                                samples[2][channel] + samples[3][channel] + 2) / 4);
+                        }
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // Upload the given levels as the mipmaps of a texture, starting at level 1. The chain has to
+        // go all the way down to a single pixel for the texture to be complete.
+        void upload_mipmaps(const sf::Texture& texture, const MipLevel* begin, const MipLevel* end)
+        {
+            sf::Texture::bind(&texture);
+
+            GLint level = 1;
+            for (auto mip_level = begin; mip_level != end; ++mip_level, ++level)
+            {
+                glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, mip_level->width, mip_level->height, 0,
+                    GL_RGBA, GL_UNSIGNED_BYTE, mip_level->pixels.data());
+            }
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+            sf::Texture::bind(nullptr);
+        }
+    }
+
     TextureCreationError::TextureCreationError()
         : std::runtime_error("could not create texture")
     {
@@ -37,7 +121,8 @@ namespace scene
     TileMapping::TileMapping(TileMapping&& other)
         : tile_placement_(std::move(other.tile_placement_)),
           tile_fragments_(std::move(other.tile_fragments_)),
-          textures_(std::move(other.textures_))        
+          textures_(std::move(other.textures_)),
+          reduced_textures_(std::move(other.reduced_textures_))
     {
     }
 
@@ -46,6 +131,7 @@ namespace scene
         tile_placement_ = std::move(rhs.tile_placement_);
         tile_fragments_ = std::move(rhs.tile_fragments_);
         textures_ = std::move(rhs.textures_);
+        reduced_textures_ = std::move(rhs.reduced_textures_);
 
         return *this;
     }
@@ -84,18 +170,87 @@ namespace scene
         return boost::make_iterator_range(&*range.first, &*range.second);
     }
 
-    const sf::Texture* TileMapping::create_texture_from_image(const sf::Image& image, sf::IntRect rect)
+    const sf::Texture* TileMapping::create_texture_from_image(const sf::Image& image,
+        std::vector<core::IntRect> tile_rects)
     {
         auto texture = std::make_unique<sf::Texture>();
-        if (!texture->loadFromImage(image, rect))
+        if (!texture->loadFromImage(image))
         {
             throw TextureCreationError();
         }
 
+        auto image_size = image.getSize();
+        if (tile_rects.empty())
+        {
+            tile_rects.emplace_back(0, 0, image_size.x, image_size.y);
+        }
+
+        // The mipmaps are built by hand rather than by the driver, because a plain box filter
+        // over the whole page would mix up neighbouring tiles.
+        std::vector<MipLevel> mip_levels;
+        mip_levels.push_back(reduce_level(image.getPixelsPtr(), image_size.x, image_size.y, tile_rects));
+        while (mip_levels.back().width != 1 || mip_levels.back().height != 1)
+        {
+            const auto& source = mip_levels.back();
+            mip_levels.push_back(reduce_level(source.pixels.data(), source.width, source.height, source.tile_rects));
+        }
+
+        // The reduced page is created here, on the loader's thread, so that the rendering
+        // code only has to pick one or the other.
+        const auto& reduced_level = mip_levels.front();
+
+        sf::Image reduced_image;
+        reduced_image.create(reduced_level.width, reduced_level.height, reduced_level.pixels.data());
+
+        auto reduced_texture = std::make_unique<sf::Texture>();
+        if (!reduced_texture->loadFromImage(reduced_image))
+        {
+            throw TextureCreationError();
+        }
+
+        auto levels_begin = mip_levels.data(), levels_end = mip_levels.data() + mip_levels.size();
+        upload_mipmaps(*texture, levels_begin, levels_end);
+        upload_mipmaps(*reduced_texture, levels_begin + 1, levels_end);
+
+        // Make sure the mipmaps are visible to the rendering context.
+        glFlush();
+
+        reduced_textures_[texture.get()] = std::move(reduced_texture);
         textures_.push_back(std::move(texture));
         return textures_.back().get();
     }
 
+    const sf::Texture* TileMapping::reduced_texture(const sf::Texture* texture) const
+    {
+        auto it = reduced_textures_.find(texture);
+        if (it == reduced_textures_.end()) return texture;
+
+        return it->second.get();
+    }
+
+    std::size_t TileMapping::placement_count() const
+    {
+        return tile_placement_.size() + tile_fragments_.size();
+    }
+
+    const TilePlacement& TileMapping::placement(std::size_t index) const
+    {
+        if (index < tile_placement_.size()) return tile_placement_[index];
+
+        return tile_fragments_[index - tile_placement_.size()];
+    }
+
+    std::size_t TileMapping::placement_index(const TilePlacement& placement) const
+    {
+        std::less<const TilePlacement*> less;
+        if (!less(&placement, tile_placement_.data()) && less(&placement, tile_placement_.data() + tile_placement_.size()))
+        {
+            return &placement - tile_placement_.data();
+        }
+
+        return tile_placement_.size() + (&placement - tile_fragments_.data());
+    }
+
     void TileMapping::define_tile_placement(components::TileId tile_id, const sf::Texture* texture, 
         core::IntRect tile_rect, core::IntRect texture_rect)
     {
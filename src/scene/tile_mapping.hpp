@@ -37,6 +37,7 @@
 
 #include <memory>
 #include <list>
+#include <vector>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -52,6 +53,10 @@ namespace scene
         core::IntRect tile_rect;
     };
 
+    // Every atlas page is also kept at this fraction of its resolution,
+    // to be used when the scene is viewed from far away.
+    const float reduced_texture_scale = 0.5f;
+
     struct TextureCreationError
         : std::runtime_error
     {
@@ -73,7 +78,21 @@ namespace scene
         PlacementRange find_tile(components::TileId tile_id, 
                                  const sf::Texture* texture_hint = nullptr) const;
 
-        const sf::Texture* create_texture_from_image(const sf::Image& image, sf::IntRect rect = sf::IntRect());
+        // The tile rects are the areas of the image that are filtered separately when the image is
+        // reduced. If none are given, the image is taken as a whole.
+        const sf::Texture* create_texture_from_image(const sf::Image& image,
+            std::vector<core::IntRect> tile_rects = {});
+
+        // Get the reduced-resolution counterpart of a texture that was created by this mapping,
+        // or the texture itself if there is none.
+        const sf::Texture* reduced_texture(const sf::Texture* texture) const;
+
+        // Placements and fragments can also be addressed by index, in which case the
+        // fragments come after the regular placements. Indices are invalidated when
+        // new placements are defined.
+        std::size_t placement_count() const;
+        const TilePlacement& placement(std::size_t index) const;
+        std::size_t placement_index(const TilePlacement& placement) const;
 
         void define_tile_placement(components::TileId, const sf::Texture* texture, 
             core::IntRect source_rect, core::IntRect texture_rect);
@@ -85,6 +104,7 @@ namespace scene
         std::vector<TilePlacement> tile_placement_;
         std::vector<TilePlacement> tile_fragments_;
         std::vector<std::unique_ptr<sf::Texture>> textures_;
+        std::unordered_map<const sf::Texture*, std::unique_ptr<sf::Texture>> reduced_textures_;
     };
 }
 
@@ -444,6 +444,7 @@ scene::TileMapping scene::create_tile_mapping(const TileLibrary& tile_library,
         sf::Image dest_image;
         dest_image.create(partition.texture_size, partition.texture_size, sf::Color::Transparent);
 
+        std::vector<IntRect> target_rects;
         for (const auto& image_info : partition.tile_placement)
         {
             const auto& source_image = image_loader.load_from_file(image_info.first);
@@ -453,10 +454,12 @@ scene::TileMapping scene::create_tile_mapping(const TileLibrary& tile_library,
                 auto dest_rect = placement.target_rect;
                 dest_image.copy(source_image, dest_rect.left, dest_rect.top,
                     sf::IntRect(source_rect.left, source_rect.top, source_rect.width, source_rect.height));
+
+                target_rects.push_back(dest_rect);
             }
         }
 
-        auto texture = tile_mapping.create_texture_from_image(dest_image);
+        auto texture = tile_mapping.create_texture_from_image(dest_image, std::move(target_rects));
         // Need to get the tile ids that are contained in the tile_placement.
 
         for (const auto& image_info : partition.tile_placement)
@@ -33,13 +33,34 @@
 #include "core/transform.hpp"
 
 #include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <chrono>
 
 namespace scene
 {
+    namespace
+    {
+        // Ranges of tiles larger than this are split up, built independently and 
+        // concatenated afterwards.
+        const std::size_t min_range_size = 4096;
+    }
+
     DisplayLayerMap create_track_layer_map(const components::Track& track, const TileMapping& tile_mapping,
-        std::function<void(double)> update_progress)
+        std::function<void(double)> update_progress, const core::CancellationToken& cancellation)
     {
-        DisplayLayerMap layer_map;
+        struct BuildJob
+        {
+            std::size_t layer_id;
+            const std::vector<components::Tile>* tiles;
+            std::size_t tile_index;
+            std::size_t tile_end;
+        };
+
+        std::size_t worker_count = std::max(std::thread::hardware_concurrency(), 1U);
 
         std::size_t num_tiles = 0;
         for (const auto& layer_handle : track.layers())
@@ -47,28 +68,136 @@ namespace scene
             num_tiles += layer_handle->tiles.size();
         }
 
-        double progress = 0.0;
-        auto tile_callback = [&]()
+        std::vector<BuildJob> jobs;
+        for (const auto& layer_handle : track.layers())
         {
-            progress += num_tiles != 0 ? 1.0 / num_tiles : 0.0;
+            std::size_t tile_count = layer_handle->tiles.size();
+            std::size_t range_size = std::max(min_range_size, (tile_count + worker_count - 1) / worker_count);
+
+            BuildJob job;
+            job.layer_id = layer_handle.id();
+            job.tiles = &layer_handle->tiles;
+            job.tile_index = 0;
 
-            if (update_progress)
+            do
             {
-                update_progress(progress);
+                job.tile_end = std::min(job.tile_index + range_size, tile_count);
+                jobs.push_back(job);
+
+                job.tile_index = job.tile_end;
+            } while (job.tile_index != tile_count);
+        }
+
+        const auto& tile_library = track.tile_library();
+
+        std::vector<DisplayLayer> job_results(jobs.size());
+        std::atomic<std::size_t> next_job(0);
+        std::atomic<std::size_t> tiles_built(0);
+
+        auto worker = [&]()
+        {
+            const std::size_t progress_granularity = 256;
+            std::size_t pending_tiles = 0;
+
+            auto tile_callback = [&]()
+            {
+                if (++pending_tiles == progress_granularity)
+                {
+                    tiles_built += pending_tiles;
+                    pending_tiles = 0;
+
+                    cancellation.throw_if_cancelled();
+                }
+            };
+
+            for (std::size_t job_index = next_job++; job_index < jobs.size() && !cancellation.is_cancelled(); 
+                job_index = next_job++)
+            {
+                const auto& job = jobs[job_index];
+                const auto& tiles = *job.tiles;
+
+                job_results[job_index] = create_display_layer(tiles.begin() + job.tile_index, tiles.begin() + job.tile_end,
+                    tile_library, tile_mapping, tile_callback);
             }
+
+            tiles_built += pending_tiles;
         };
 
-        const auto& tile_library = track.tile_library();
-        for (const auto& layer_handle : track.layers())
+        std::vector<std::future<void>> workers;
+        for (std::size_t i = 0, count = std::min(worker_count, jobs.size()); i != count; ++i)
+        {
+            workers.push_back(std::async(std::launch::async, worker));
+        }
+
+        for (auto& future : workers)
+        {
+            while (future.wait_for(std::chrono::milliseconds(20)) != std::future_status::ready)
+            {
+                if (update_progress && num_tiles != 0)
+                {
+                    update_progress(tiles_built / static_cast<double>(num_tiles));
+                }
+            }
+
+            future.get();
+        }
+
+        cancellation.throw_if_cancelled();
+
+        DisplayLayerMap layer_map;
+        for (std::size_t job_index = 0; job_index != jobs.size(); ++job_index)
         {
-            const auto& tiles = layer_handle->tiles;
+            const auto& job = jobs[job_index];
+            if (job.tile_index == 0)
+            {
+                layer_map.emplace(job.layer_id, std::move(job_results[job_index]));
+            }
 
-            layer_map.emplace(layer_handle.id(), create_display_layer(tiles.begin(), tiles.end(), tile_library, tile_mapping, tile_callback));
+            else
+            {
+                layer_map[job.layer_id].append_layer(job_results[job_index]);
+            }
+        }
+
+        if (update_progress)
+        {
+            update_progress(1.0);
         }
 
         return layer_map;
     }
 
+    DisplayLayer create_display_layer_concurrently(const std::vector<components::Tile>& tiles,
+        std::size_t tile_index, std::size_t tile_end,
+        const components::TileLibrary& tile_library, const TileMapping& tile_mapping)
+    {
+        std::size_t worker_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+        std::size_t tile_count = tile_end - tile_index;
+        std::size_t range_size = std::max(min_range_size, (tile_count + worker_count - 1) / worker_count);
+
+        auto build_range = [&](std::size_t range_begin)
+        {
+            auto range_end = std::min(range_begin + range_size, tile_end);
+            return create_display_layer(tiles.begin() + range_begin, tiles.begin() + range_end,
+                tile_library, tile_mapping);
+        };
+
+        std::vector<std::future<DisplayLayer>> ranges;
+        for (auto range_begin = tile_index + range_size; range_begin < tile_end; range_begin += range_size)
+        {
+            ranges.push_back(std::async(std::launch::async, build_range, range_begin));
+        }
+
+        auto result = build_range(tile_index);
+        for (auto& range : ranges)
+        {
+            result.append_layer(range.get());
+        }
+
+        return result;
+    }
+
     void DisplayLayer::hide()
     {
         visible_ = false;
@@ -87,6 +216,8 @@ namespace scene
 
     void DisplayLayer::clear()
     {
+        clear_culled_tiles();
+
         component_info_.clear();
         tile_info_.clear();
         vertices_.clear();
@@ -97,18 +228,115 @@ namespace scene
         return vertices_;
     }
 
+    std::size_t DisplayLayer::tile_count() const
+    {
+        return tile_info_.size();
+    }
+
+    void DisplayLayer::append_layer(const DisplayLayer& layer)
+    {
+        clear_culled_tiles();
+
+        std::size_t vertex_offset = vertices_.size();
+        vertices_.insert(vertices_.end(), layer.vertices_.begin(), layer.vertices_.end());
+
+        std::transform(layer.tile_info_.begin(), layer.tile_info_.end(), std::back_inserter(tile_info_),
+            [vertex_offset](Tile tile)
+        {
+            tile.vertex_index += vertex_offset;
+            return tile;
+        });
+
+        auto component_it = layer.component_info_.begin();
+        if (component_it != layer.component_info_.end() && !component_info_.empty() && 
+            component_info_.back().texture == component_it->texture)
+        {
+            // Merge the runs at the seam.
+            component_info_.back().vertex_count += component_it->vertex_count;
+            ++component_it;
+        }
+
+        std::transform(component_it, layer.component_info_.end(), std::back_inserter(component_info_),
+            [vertex_offset](Component component)
+        {
+            component.vertex_index += vertex_offset;
+            return component;
+        });
+    }
+
+    void DisplayLayer::set_culled_tiles(const std::vector<bool>& culled_tiles)
+    {
+        clear_culled_tiles();
+        if (culled_tiles.size() != tile_info_.size()) return;
+
+        // Vertex ranges of the tiles that remain, adjacent ones merged.
+        std::vector<Tile> drawn_ranges;
+        for (std::size_t tile_index = 0; tile_index != tile_info_.size(); ++tile_index)
+        {
+            const auto& tile_info = tile_info_[tile_index];
+            if (culled_tiles[tile_index] || tile_info.vertex_count == 0) continue;
+
+            if (!drawn_ranges.empty() && 
+                drawn_ranges.back().vertex_index + drawn_ranges.back().vertex_count == tile_info.vertex_index)
+            {
+                drawn_ranges.back().vertex_count += tile_info.vertex_count;
+            }
+
+            else
+            {
+                drawn_ranges.push_back(tile_info);
+            }
+        }
+
+        // Intersect them with the texture runs.
+        auto range_it = drawn_ranges.begin();
+        for (const auto& component : component_info_)
+        {
+            std::size_t component_end = component.vertex_index + component.vertex_count;
+            while (range_it != drawn_ranges.end() && range_it->vertex_index + range_it->vertex_count <= component.vertex_index)
+            {
+                ++range_it;
+            }
+
+            for (auto it = range_it; it != drawn_ranges.end() && it->vertex_index < component_end; ++it)
+            {
+                Component culled_component;
+                culled_component.vertex_index = std::max(it->vertex_index, component.vertex_index);
+                culled_component.vertex_count = std::min(it->vertex_index + it->vertex_count, component_end) - 
+                    culled_component.vertex_index;
+                culled_component.texture = component.texture;
+                culled_component_info_.push_back(culled_component);
+            }
+        }
+
+        culled_ = true;
+    }
+
+    void DisplayLayer::clear_culled_tiles()
+    {
+        culled_component_info_.clear();
+        culled_ = false;
+    }
+
     void draw(const DisplayLayer& layer, sf::RenderTarget& render_target, sf::RenderStates render_states)
     {
         layer.draw(render_target, render_states);
     }
 
+    void draw(const DisplayLayer& layer, sf::RenderTarget& render_target, sf::RenderStates render_states,
+        const TileMapping& tile_mapping, DetailLevel detail_level)
+    {
+        layer.draw(render_target, render_states, tile_mapping, detail_level);
+    }
+
     void DisplayLayer::draw(sf::RenderTarget& render_target, sf::RenderStates render_states) const
     {
         if (!visible()) return;
 
         const sf::Vertex* vertices = vertices_.data();
+        const auto& component_info = culled_ ? culled_component_info_ : component_info_;
 
-        for (const Component& component : component_info_)
+        for (const Component& component : component_info)
         {
             render_states.texture = component.texture;
             render_target.draw(vertices + component.vertex_index, static_cast<unsigned int>(component.vertex_count),
@@ -116,8 +344,32 @@ namespace scene
         }
     }
 
+    void DisplayLayer::draw(sf::RenderTarget& render_target, sf::RenderStates render_states,
+        const TileMapping& tile_mapping, DetailLevel detail_level) const
+    {
+        if (detail_level == DetailLevel::Full)
+        {
+            draw(render_target, render_states);
+            return;
+        }
+
+        if (!visible()) return;
+
+        const sf::Vertex* vertices = vertices_.data();
+        const auto& component_info = culled_ ? culled_component_info_ : component_info_;
+
+        for (const Component& component : component_info)
+        {
+            render_states.texture = tile_mapping.reduced_texture(component.texture);
+            render_target.draw(vertices + component.vertex_index, static_cast<unsigned int>(component.vertex_count),
+                sf::Quads, render_states);
+        }
+    }
+
     void DisplayLayer::insert_tile(std::size_t tile_index)
     {
+        clear_culled_tiles();
+
         if (tile_index >= tile_info_.size())
         {
             Tile tile_initializer;
@@ -138,6 +390,8 @@ namespace scene
     void DisplayLayer::insert_component_vertices(std::size_t vertex_index, std::size_t vertex_count, 
         const sf::Texture* texture)
     {
+        clear_culled_tiles();
+
         auto component_it = std::lower_bound(component_info_.begin(), component_info_.end(), vertex_index,
             [](const Component& component, std::size_t vertex_index)
         {
@@ -200,6 +454,8 @@ namespace scene
 
     void DisplayLayer::erase_tile(std::size_t tile_index)
     {
+        clear_culled_tiles();
+
         if (tile_index < tile_info_.size())
         {
             erase_tile_vertices(tile_index);
@@ -208,13 +464,117 @@ namespace scene
         }
     }
 
+    void DisplayLayer::erase_tiles(const std::vector<std::size_t>& tile_indices)
+    {
+        clear_culled_tiles();
+
+        auto index_end = std::lower_bound(tile_indices.begin(), tile_indices.end(), tile_info_.size());
+        if (index_end == tile_indices.begin()) return;
+
+        // Tiles' vertices are laid out in tile order, so the erased vertex ranges are sorted too.
+        std::vector<Tile> erased_ranges;
+        erased_ranges.reserve(index_end - tile_indices.begin());
+
+        // The indices may contain duplicates, each tile's vertices are erased once.
+        for (auto it = tile_indices.begin(); it != index_end; ++it)
+        {
+            if (it != tile_indices.begin() && *it == it[-1]) continue;
+
+            const auto& tile_info = tile_info_[*it];
+            if (tile_info.vertex_count != 0) erased_ranges.push_back(tile_info);
+        }
+
+        if (!erased_ranges.empty())
+        {
+            auto write_it = vertices_.begin() + erased_ranges.front().vertex_index;
+            for (auto range = erased_ranges.begin(); range != erased_ranges.end(); ++range)
+            {
+                auto next = std::next(range);
+
+                auto read_it = vertices_.begin() + range->vertex_index + range->vertex_count;
+                auto read_end = next == erased_ranges.end() ? vertices_.end() : vertices_.begin() + next->vertex_index;
+                write_it = std::copy(read_it, read_end, write_it);
+            }
+
+            vertices_.erase(write_it, vertices_.end());
+        }
+
+        {
+            std::size_t removed_vertices = 0;
+            auto erased_it = tile_indices.begin();
+            auto write_it = tile_info_.begin();
+
+            for (std::size_t tile_index = 0; tile_index != tile_info_.size(); ++tile_index)
+            {
+                auto tile_info = tile_info_[tile_index];
+                if (erased_it != index_end && *erased_it == tile_index)
+                {
+                    removed_vertices += tile_info.vertex_count;
+                    while (erased_it != index_end && *erased_it == tile_index) ++erased_it;
+                    continue;
+                }
+
+                tile_info.vertex_index -= removed_vertices;
+                *write_it++ = tile_info;
+            }
+
+            tile_info_.erase(write_it, tile_info_.end());
+        }
+
+        // Component boundaries are visited in increasing order, so the number of vertices removed
+        // before them can be tracked with a single cursor.
+        auto range_it = erased_ranges.begin();
+        std::size_t removed_before_range = 0;
+        auto removed_before = [&](std::size_t vertex_index)
+        {
+            while (range_it != erased_ranges.end() && range_it->vertex_index + range_it->vertex_count <= vertex_index)
+            {
+                removed_before_range += range_it->vertex_count;
+                ++range_it;
+            }
+
+            std::size_t result = removed_before_range;
+            if (range_it != erased_ranges.end() && range_it->vertex_index < vertex_index)
+            {
+                result += vertex_index - range_it->vertex_index;
+            }
+
+            return result;
+        };
+
+        auto write_it = component_info_.begin();
+        for (auto component : component_info_)
+        {
+            std::size_t begin = component.vertex_index - removed_before(component.vertex_index);
+            std::size_t end = component.vertex_index + component.vertex_count;
+            end -= removed_before(end);
+
+            if (begin == end) continue;
+
+            if (write_it != component_info_.begin() && std::prev(write_it)->texture == component.texture)
+            {
+                std::prev(write_it)->vertex_count += end - begin;
+                continue;
+            }
+
+            component.vertex_index = begin;
+            component.vertex_count = end - begin;
+            *write_it++ = component;
+        }
+
+        component_info_.erase(write_it, component_info_.end());
+    }
+
     void DisplayLayer::erase_tile_vertices(std::size_t tile_index)
     {
+        clear_culled_tiles();
+
         if (tile_index < tile_info_.size())
         {
             auto& tile_info = tile_info_[tile_index];
             std::size_t vertex_index = tile_info.vertex_index;
             std::size_t vertex_count = tile_info.vertex_count;
+            if (vertex_count == 0) return;
 
             vertices_.erase(vertices_.begin() + vertex_index, vertices_.begin() + vertex_index + vertex_count);
 
@@ -291,4 +651,19 @@ namespace scene
             vertex.position.y += y;
         }
     }
-}
\ No newline at end of file
+
+    void DisplayLayer::set_tile_color(std::size_t tile_index, sf::Color color)
+    {
+        if (tile_index < tile_info_.size())
+        {
+            const auto& tile_info = tile_info_[tile_index];
+            auto vertex_it = vertices_.begin() + tile_info.vertex_index;
+
+            std::for_each(vertex_it, vertex_it + tile_info.vertex_count, 
+                [color](sf::Vertex& vertex)
+            {
+                vertex.color = color;
+            });
+        }
+    }
+}
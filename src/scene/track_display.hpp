@@ -27,6 +27,7 @@
 #define TRACK_DISPLAY_HPP
 
 #include "core/vector2.hpp"
+#include "core/cancellation.hpp"
 
 #include <vector>
 #include <unordered_map>
@@ -40,6 +41,7 @@ namespace components
     class TileLibrary;
 
     struct PlacedTile;    
+    struct Tile;
 }
 
 namespace scene
@@ -47,6 +49,14 @@ namespace scene
     class TileMapping;
     struct TilePlacement;
 
+    // Reduced detail substitutes the reduced-resolution atlas pages, which requires
+    // the render states to contain a shader that compensates for the smaller texture size.
+    enum class DetailLevel
+    {
+        Full,
+        Reduced
+    };
+
     class DisplayLayer
     {
     public:
@@ -56,6 +66,7 @@ namespace scene
         bool visible() const;
 
         const std::vector<sf::Vertex>& vertices() const;
+        std::size_t tile_count() const;
         
         void insert_tile(std::size_t index);
 
@@ -64,6 +75,9 @@ namespace scene
 
         void erase_tile(std::size_t index);
 
+        // Erases the tiles at the given indices, which must be sorted, in a single pass.
+        void erase_tiles(const std::vector<std::size_t>& tile_indices);
+
         void append_layer(const DisplayLayer& layer);
 
         template <typename VertexIt>
@@ -83,7 +97,15 @@ namespace scene
 
         void translate_vertices(core::Vector2<double> offset);
 
+        void set_tile_color(std::size_t tile_index, sf::Color color);
+
+        // Leaves out the flagged tiles when drawing, until the structure of the layer changes.
+        void set_culled_tiles(const std::vector<bool>& culled_tiles);
+        void clear_culled_tiles();
+
         void draw(sf::RenderTarget& render_target, sf::RenderStates render_states) const;
+        void draw(sf::RenderTarget& render_target, sf::RenderStates render_states,
+            const TileMapping& tile_mapping, DetailLevel detail_level) const;
 
     private:
         void insert_component_vertices(std::size_t vertex_index, std::size_t vertex_count, const sf::Texture* texture);
@@ -103,25 +125,35 @@ namespace scene
 
         std::vector<Component> component_info_;
         std::vector<Tile> tile_info_;
+        std::vector<Component> culled_component_info_;
         std::vector<sf::Vertex> vertices_;
         bool visible_ = true;
+        bool culled_ = false;
     };
 
     using DisplayLayerMap = std::unordered_map<std::size_t, DisplayLayer>;
 
     void draw(const DisplayLayer& layer, sf::RenderTarget& render_target, sf::RenderStates render_states);
+    void draw(const DisplayLayer& layer, sf::RenderTarget& render_target, sf::RenderStates render_states,
+        const TileMapping& tile_mapping, DetailLevel detail_level);
 
     template <typename OutIt>
     void generate_tile_vertices(const components::PlacedTile& placed_tile, const TilePlacement& placement, OutIt out);
 
     DisplayLayerMap create_track_layer_map(const components::Track& track, const TileMapping& tile_mapping,
-        std::function<void(double)> update_progress = {});
+        std::function<void(double)> update_progress = {},
+        const core::CancellationToken& cancellation = core::CancellationToken());
 
 
     template <typename TileIt>
     DisplayLayer create_display_layer(TileIt tile_it, TileIt tile_end, 
         const components::TileLibrary& tile_library, const TileMapping& tile_mapping);
 
+    // Large ranges are split up and built on several threads.
+    DisplayLayer create_display_layer_concurrently(const std::vector<components::Tile>& tiles, 
+        std::size_t tile_index, std::size_t tile_end, 
+        const components::TileLibrary& tile_library, const TileMapping& tile_mapping);
+
     template <typename TileIt, typename TileCallback>
     DisplayLayer create_display_layer(TileIt tile_it, TileIt tile_end, const components::TileLibrary& tile_library, 
         const TileMapping& tile_mapping, TileCallback callback);
@@ -28,6 +28,7 @@
 #define TRACK_DISPLAY_INL
 
 #include "track_display.hpp"
+#include "vertex_batch.hpp"
 
 #include "components/tile_definition.hpp"
 #include "components/tile_group_expansion.hpp"
@@ -112,6 +113,8 @@ namespace scene
     DisplayLayer create_display_layer(TileIt tile_it, TileIt tile_end, const components::TileLibrary& tile_library, 
         const TileMapping& tile_mapping, TileCallback tile_callback)
     {
+        const std::size_t max_batch_size = 1024;
+
         const sf::Texture* texture_hint = nullptr;
         std::vector<sf::Vertex> vertex_cache;
 
@@ -119,7 +122,38 @@ namespace scene
 
         std::vector<components::PlacedTile> tile_cache;
 
-        for (std::size_t tile_index = 0; tile_it != tile_end; ++tile_it, ++tile_index)
+        TileQuadBatch quad_batch;
+        quad_batch.reserve(max_batch_size);
+
+        auto flush_batch = [&]()
+        {
+            vertex_cache.resize(quad_batch.size() * 4);
+            quad_batch.generate_vertices(vertex_cache.data());
+
+            // Quads belonging to the same tile and texture can be appended in one go.
+            for (std::size_t quad_index = 0, quad_end = quad_batch.size(); quad_index != quad_end; )
+            {
+                std::size_t tile_index = quad_batch.tile_index(quad_index);
+                const sf::Texture* texture = quad_batch.texture(quad_index);
+
+                std::size_t run_end = quad_index + 1;
+                while (run_end != quad_end && quad_batch.tile_index(run_end) == tile_index &&
+                    quad_batch.texture(run_end) == texture)
+                {
+                    ++run_end;
+                }
+
+                auto vertex_it = vertex_cache.begin();
+                result.append_tile_vertices(tile_index, vertex_it + quad_index * 4, vertex_it + run_end * 4, texture);
+
+                quad_index = run_end;
+            }
+
+            quad_batch.clear();
+        };
+
+        std::size_t tile_index = 0;
+        for (; tile_it != tile_end; ++tile_it, ++tile_index)
         {
             const components::Tile& tile = *tile_it;
 
@@ -133,16 +167,27 @@ namespace scene
                 {
                     texture_hint = placement.texture;
 
-                    vertex_cache.clear();
-                    generate_tile_vertices(placed_tile, placement, std::back_inserter(vertex_cache));
-
-                    result.append_tile_vertices(tile_index, vertex_cache.begin(), vertex_cache.end(), placement.texture);
+                    quad_batch.append(placed_tile, placement, tile_index);
                 }
             }
 
+            if (quad_batch.size() >= max_batch_size)
+            {
+                flush_batch();
+            }
+
             tile_callback();
         }
 
+        flush_batch();
+
+        // Make sure trailing tiles without vertices are accounted for, so that layers
+        // built from consecutive tile ranges can be concatenated.
+        if (tile_index > result.tile_count())
+        {
+            result.insert_tile(tile_index - 1);
+        }
+
         return result;
     }
 
@@ -0,0 +1,319 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "vertex_batch.hpp"
+#include "track_display.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define VERTEX_BATCH_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace scene
+{
+    namespace
+    {
+        struct RotationTable
+        {
+            RotationTable()
+            {
+                for (std::int32_t degrees = 0; degrees != 360; ++degrees)
+                {
+                    auto radians = components::convert_rotation(degrees).radians();
+                    sin[degrees] = static_cast<float>(std::sin(radians));
+                    cos[degrees] = static_cast<float>(std::cos(radians));
+                }
+            }
+
+            float sin[360];
+            float cos[360];
+        };
+
+        const RotationTable& rotation_table()
+        {
+            static const RotationTable table;
+            return table;
+        }
+
+        // Placed tiles always have whole-degree rotations, see components::expand_tile_groups.
+        std::uint16_t rotation_index(core::Rotation<double> rotation)
+        {
+            auto degrees = static_cast<std::int32_t>(std::round(rotation.degrees())) % 360;
+            if (degrees < 0) degrees += 360;
+
+            return static_cast<std::uint16_t>(degrees);
+        }
+    }
+
+    void TileQuadBatch::clear()
+    {
+        position_x_.clear();
+        position_y_.clear();
+        rotation_index_.clear();
+
+        local_left_.clear();
+        local_top_.clear();
+        local_right_.clear();
+        local_bottom_.clear();
+
+        texture_left_.clear();
+        texture_top_.clear();
+        texture_right_.clear();
+        texture_bottom_.clear();
+
+        textures_.clear();
+        tile_indices_.clear();
+
+#ifndef NDEBUG
+        reference_tiles_.clear();
+        reference_placements_.clear();
+#endif
+    }
+
+    void TileQuadBatch::reserve(std::size_t quad_count)
+    {
+        position_x_.reserve(quad_count);
+        position_y_.reserve(quad_count);
+        rotation_index_.reserve(quad_count);
+
+        local_left_.reserve(quad_count);
+        local_top_.reserve(quad_count);
+        local_right_.reserve(quad_count);
+        local_bottom_.reserve(quad_count);
+
+        texture_left_.reserve(quad_count);
+        texture_top_.reserve(quad_count);
+        texture_right_.reserve(quad_count);
+        texture_bottom_.reserve(quad_count);
+
+        textures_.reserve(quad_count);
+        tile_indices_.reserve(quad_count);
+    }
+
+    std::size_t TileQuadBatch::size() const
+    {
+        return textures_.size();
+    }
+
+    bool TileQuadBatch::empty() const
+    {
+        return textures_.empty();
+    }
+
+    std::size_t TileQuadBatch::tile_index(std::size_t quad_index) const
+    {
+        return tile_indices_[quad_index];
+    }
+
+    const sf::Texture* TileQuadBatch::texture(std::size_t quad_index) const
+    {
+        return textures_[quad_index];
+    }
+
+    void TileQuadBatch::append(const components::PlacedTile& placed_tile, const TilePlacement& placement, 
+        std::size_t tile_index)
+    {
+        // Same quad geometry as generate_tile_vertices, relative to the tile's position.
+        const auto& tile_def = placed_tile.tile_def;
+
+        const core::IntRect image_rect = tile_def->image_rect;
+        const core::IntRect pattern_rect = tile_def->pattern_rect;
+
+        const auto& texture_rect = placement.texture_rect;
+        const auto& tile_rect = placement.tile_rect;
+
+        auto scale_x = 0.5;
+        auto scale_y = 0.5;
+
+        if (pattern_rect.width * 2 != image_rect.width) scale_x = static_cast<double>(pattern_rect.width) / image_rect.width;
+        if (pattern_rect.height * 2 != image_rect.height) scale_y = static_cast<double>(pattern_rect.height) / image_rect.height;
+
+        const auto center_x = image_rect.width * scale_x * 0.5;
+        const auto center_y = image_rect.height * scale_y * 0.5;
+
+        auto source_left = tile_rect.left - 1.0;
+        auto source_top = tile_rect.top - 1.0;
+
+        auto source_right = static_cast<double>(tile_rect.right());
+        auto source_bottom = static_cast<double>(tile_rect.bottom());
+
+        position_x_.push_back(static_cast<float>(placed_tile.tile.position.x));
+        position_y_.push_back(static_cast<float>(placed_tile.tile.position.y));
+        rotation_index_.push_back(rotation_index(placed_tile.tile.rotation));
+
+        local_left_.push_back(static_cast<float>(source_left * scale_x - center_x));
+        local_top_.push_back(static_cast<float>(source_top * scale_y - center_y));
+        local_right_.push_back(static_cast<float>(source_right * scale_x - center_x));
+        local_bottom_.push_back(static_cast<float>(source_bottom * scale_y - center_y));
+
+        texture_left_.push_back(static_cast<float>(texture_rect.left));
+        texture_top_.push_back(static_cast<float>(texture_rect.top));
+        texture_right_.push_back(static_cast<float>(texture_rect.right()));
+        texture_bottom_.push_back(static_cast<float>(texture_rect.bottom()));
+
+        textures_.push_back(placement.texture);
+        tile_indices_.push_back(tile_index);
+
+#ifndef NDEBUG
+        reference_tiles_.push_back(placed_tile);
+        reference_placements_.push_back(placement);
+#endif
+    }
+
+    void TileQuadBatch::generate_vertices(sf::Vertex* out) const
+    {
+        std::size_t quad_count = size();
+        std::size_t quad_index = 0;
+
+#ifdef VERTEX_BATCH_USE_SSE
+        const auto& table = rotation_table();
+
+        for (; quad_index + 4 <= quad_count; quad_index += 4)
+        {
+            float sin_values[4], cos_values[4];
+            for (std::size_t lane = 0; lane != 4; ++lane)
+            {
+                auto rotation = rotation_index_[quad_index + lane];
+                sin_values[lane] = table.sin[rotation];
+                cos_values[lane] = table.cos[rotation];
+            }
+
+            const __m128 sin = _mm_loadu_ps(sin_values);
+            const __m128 cos = _mm_loadu_ps(cos_values);
+
+            const __m128 position_x = _mm_loadu_ps(&position_x_[quad_index]);
+            const __m128 position_y = _mm_loadu_ps(&position_y_[quad_index]);
+
+            const __m128 left = _mm_loadu_ps(&local_left_[quad_index]);
+            const __m128 top = _mm_loadu_ps(&local_top_[quad_index]);
+            const __m128 right = _mm_loadu_ps(&local_right_[quad_index]);
+            const __m128 bottom = _mm_loadu_ps(&local_bottom_[quad_index]);
+
+            // [corner][lane], corners in the order top-left, bottom-left, bottom-right, top-right.
+            float corner_x[4][4], corner_y[4][4];
+            auto transform_corner = [&](__m128 x, __m128 y, std::size_t corner)
+            {
+                __m128 result_x = _mm_sub_ps(_mm_mul_ps(x, cos), _mm_mul_ps(sin, y));
+                __m128 result_y = _mm_add_ps(_mm_mul_ps(y, cos), _mm_mul_ps(sin, x));
+
+                _mm_storeu_ps(corner_x[corner], _mm_add_ps(result_x, position_x));
+                _mm_storeu_ps(corner_y[corner], _mm_add_ps(result_y, position_y));
+            };
+
+            transform_corner(left, top, 0);
+            transform_corner(left, bottom, 1);
+            transform_corner(right, bottom, 2);
+            transform_corner(right, top, 3);
+
+            for (std::size_t lane = 0; lane != 4; ++lane, out += 4)
+            {
+                std::size_t index = quad_index + lane;
+                out[0].texCoords = sf::Vector2f(texture_left_[index], texture_top_[index]);
+                out[1].texCoords = sf::Vector2f(texture_left_[index], texture_bottom_[index]);
+                out[2].texCoords = sf::Vector2f(texture_right_[index], texture_bottom_[index]);
+                out[3].texCoords = sf::Vector2f(texture_right_[index], texture_top_[index]);
+
+                for (std::size_t corner = 0; corner != 4; ++corner)
+                {
+                    out[corner].position = sf::Vector2f(corner_x[corner][lane], corner_y[corner][lane]);
+                    out[corner].color = sf::Color::White;
+                }
+            }
+        }
+#endif
+
+        generate_vertices(quad_index, quad_count, out);
+
+#ifndef NDEBUG
+        verify_vertices(out - quad_index * 4);
+#endif
+    }
+
+    void TileQuadBatch::generate_vertices(std::size_t quad_index, std::size_t quad_end, sf::Vertex* out) const
+    {
+        const auto& table = rotation_table();
+
+        for (; quad_index != quad_end; ++quad_index, out += 4)
+        {
+            auto rotation = rotation_index_[quad_index];
+            const float sin = table.sin[rotation];
+            const float cos = table.cos[rotation];
+
+            const float position_x = position_x_[quad_index];
+            const float position_y = position_y_[quad_index];
+
+            const float left = local_left_[quad_index];
+            const float top = local_top_[quad_index];
+            const float right = local_right_[quad_index];
+            const float bottom = local_bottom_[quad_index];
+
+            auto transform_corner = [=](float x, float y)
+            {
+                return sf::Vector2f(x * cos - sin * y + position_x, y * cos + sin * x + position_y);
+            };
+
+            out[0].position = transform_corner(left, top);
+            out[1].position = transform_corner(left, bottom);
+            out[2].position = transform_corner(right, bottom);
+            out[3].position = transform_corner(right, top);
+
+            out[0].texCoords = sf::Vector2f(texture_left_[quad_index], texture_top_[quad_index]);
+            out[1].texCoords = sf::Vector2f(texture_left_[quad_index], texture_bottom_[quad_index]);
+            out[2].texCoords = sf::Vector2f(texture_right_[quad_index], texture_bottom_[quad_index]);
+            out[3].texCoords = sf::Vector2f(texture_right_[quad_index], texture_top_[quad_index]);
+
+            for (std::size_t corner = 0; corner != 4; ++corner)
+            {
+                out[corner].color = sf::Color::White;
+            }
+        }
+    }
+
+#ifndef NDEBUG
+    void TileQuadBatch::verify_vertices(const sf::Vertex* vertices) const
+    {
+        // Single precision against double precision, at track coordinates.
+        const float tolerance = 0.01f;
+
+        sf::Vertex reference[4];
+        for (std::size_t quad_index = 0; quad_index != size(); ++quad_index, vertices += 4)
+        {
+            generate_tile_vertices(reference_tiles_[quad_index], reference_placements_[quad_index], reference);
+
+            for (std::size_t corner = 0; corner != 4; ++corner)
+            {
+                assert(std::abs(vertices[corner].position.x - reference[corner].position.x) <= tolerance);
+                assert(std::abs(vertices[corner].position.y - reference[corner].position.y) <= tolerance);
+                assert(vertices[corner].texCoords.x == reference[corner].texCoords.x);
+                assert(vertices[corner].texCoords.y == reference[corner].texCoords.y);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,90 @@
+/*
+* The MIT License (MIT)
+*
+* IziEditor
+* Copyright (c) 2015 Martin Newhouse
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef VERTEX_BATCH_HPP
+#define VERTEX_BATCH_HPP
+
+#include "tile_mapping.hpp"
+
+#include "components/tile_definition.hpp"
+
+#include <SFML/Graphics.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace scene
+{
+    // class TileQuadBatch. Collects tile quads in structure-of-arrays form, so that the
+    // vertices of many quads can be generated at once. The output is equivalent to
+    // calling generate_tile_vertices for every quad, up to float precision.
+    class TileQuadBatch
+    {
+    public:
+        void clear();
+        void reserve(std::size_t quad_count);
+
+        std::size_t size() const;
+        bool empty() const;
+
+        void append(const components::PlacedTile& placed_tile, const TilePlacement& placement, std::size_t tile_index);
+
+        std::size_t tile_index(std::size_t quad_index) const;
+        const sf::Texture* texture(std::size_t quad_index) const;
+
+        // Writes four vertices per quad to the output buffer, which must be large enough.
+        void generate_vertices(sf::Vertex* out) const;
+
+    private:
+        void generate_vertices(std::size_t quad_index, std::size_t quad_end, sf::Vertex* out) const;
+
+        std::vector<float> position_x_;
+        std::vector<float> position_y_;
+        std::vector<std::uint16_t> rotation_index_;
+
+        std::vector<float> local_left_;
+        std::vector<float> local_top_;
+        std::vector<float> local_right_;
+        std::vector<float> local_bottom_;
+
+        std::vector<float> texture_left_;
+        std::vector<float> texture_top_;
+        std::vector<float> texture_right_;
+        std::vector<float> texture_bottom_;
+
+        std::vector<const sf::Texture*> textures_;
+        std::vector<std::size_t> tile_indices_;
+
+#ifndef NDEBUG
+        void verify_vertices(const sf::Vertex* vertices) const;
+
+        std::vector<components::PlacedTile> reference_tiles_;
+        std::vector<TilePlacement> reference_placements_;
+#endif
+    };
+}
+
+#endif